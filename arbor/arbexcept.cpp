@@ -26,12 +26,23 @@ bad_probe_id::bad_probe_id(cell_member_type probe_id):
     probe_id(probe_id)
 {}
 
+bad_connection_target::bad_connection_target(cell_member_type target, cell_gid_type first, cell_gid_type last):
+    arbor_exception(pprintf("connection target {} is not on a cell with gid in [{}, {})", target, first, last)),
+    target(target),
+    first(first),
+    last(last)
+{}
+
 bad_event_time::bad_event_time(time_type event_time, time_type sim_time):
     arbor_exception(pprintf("event time {} precedes current simulation time {}", event_time, sim_time)),
     event_time(event_time),
     sim_time(sim_time)
 {}
 
+bad_checkpoint::bad_checkpoint(const std::string& what):
+    arbor_exception(pprintf("bad checkpoint: {}", what))
+{}
+
 no_such_mechanism::no_such_mechanism(const std::string& mech_name):
     arbor_exception(pprintf("no mechanism {} in catalogue", mech_name)),
     mech_name(mech_name)
@@ -0,0 +1,95 @@
+#pragma once
+
+// Step size control for per-cell adaptive time stepping, common across
+// CPU and GPU backends.
+//
+// The voltage is integrated with the backward Euler method, with a local
+// error in a step of size dt of about -dt²/2·V''. The error is estimated
+// from the difference between the solution and the linear extrapolation
+// of the voltage over the previous step of size dt_prev:
+//
+//     err ≈ dt/(dt+dt_prev)·|V(t+dt) - V(t) - dt·V'_prev|
+//         = dt²/(dt+dt_prev)·|V'_step - V'_prev|
+//
+// where V'_step and V'_prev are the mean slopes of the voltage over the step
+// and the previous step. The error of a cell is the largest error over its
+// CVs.
+//
+// Steps are not rejected, as the mechanism state can not be rolled back:
+// instead the error of a step sets the size of the next step, so that its
+// error would be about the tolerance. The step grows at most twofold from
+// one step to the next, and is kept in [dt_min, dt_max].
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include <arbor/fvm_types.hpp>
+
+#include "backends/multi_event_stream_state.hpp"
+
+namespace arb {
+namespace adaptive_dt {
+
+constexpr fvm_value_type safety = 0.9;
+constexpr fvm_value_type max_growth = 2;
+
+// Set dt_step to dt, and discard the error estimate history, of cells with
+// marked events: the voltage slope over the last step is not a prediction
+// of the slope after a synaptic event.
+template <typename EvData>
+void restart_marked(
+    const multi_event_stream_state<EvData>& s,
+    fvm_value_type* dt_step, fvm_value_type* dt_prev, fvm_value_type dt)
+{
+    for (fvm_size_type i = 0; i<s.n_streams(); ++i) {
+        if (s.begin_offset[i]!=s.end_offset[i]) {
+            dt_step[i] = dt;
+            dt_prev[i] = 0;
+        }
+    }
+}
+
+// Update the voltage slope of each CV and the next step of each cell after
+// a step, for cells that took a step of size dt_cell > 0.
+//
+// The CVs of each cell are contiguous.
+inline void update_step(
+    std::size_t n_cv, const fvm_index_type* cv_to_cell, const fvm_value_type* dt_cell,
+    const fvm_value_type* voltage, const fvm_value_type* voltage_prev,
+    fvm_value_type* dvdt, fvm_value_type* dt_step, fvm_value_type* dt_prev,
+    fvm_value_type tolerance, fvm_value_type dt_min, fvm_value_type dt_max)
+{
+    std::size_t i = 0;
+    while (i<n_cv) {
+        auto c = cv_to_cell[i];
+        auto end = i+1;
+        while (end<n_cv && cv_to_cell[end]==c) ++end;
+
+        auto dt = dt_cell[c];
+        if (dt>0) {
+            fvm_value_type dslope = 0;
+            for (auto k = i; k<end; ++k) {
+                auto slope = (voltage[k]-voltage_prev[k])/dt;
+                dslope = std::max(dslope, std::abs(slope-dvdt[k]));
+                dvdt[k] = slope;
+            }
+
+            // A step cut short by an event or the end of an epoch does not
+            // shorten the next step.
+            auto h = std::max(max_growth*dt, dt_step[c]);
+            if (dt_prev[c]>0) {
+                auto err = dt*dt/(dt+dt_prev[c])*dslope;
+                if (err>0) {
+                    h = std::min(h, safety*dt*std::sqrt(tolerance/err));
+                }
+            }
+            dt_step[c] = std::min(std::max(h, dt_min), dt_max);
+            dt_prev[c] = dt;
+        }
+        i = end;
+    }
+}
+
+} // namespace adaptive_dt
+} // namespace arb
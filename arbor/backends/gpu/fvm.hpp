@@ -24,6 +24,9 @@ struct backend {
     static bool is_supported() { return true; }
     static std::string name() { return "gpu"; }
 
+    // Adaptive time stepping needs device kernels for the step control.
+    static bool has_adaptive_dt() { return false; }
+
     using value_type = fvm_value_type;
     using index_type = fvm_index_type;
     using size_type  = fvm_size_type;
@@ -132,6 +132,14 @@ struct matrix_state_flat {
                           cell_cv_divs.data(), num_matrices());
     }
 
+    // Assemble and solve the matrix, and overwrite the voltage with the
+    // solution.
+    void assemble_and_solve(const_view dt_cell, array& voltage, const_view current) {
+        assemble(dt_cell, voltage, current);
+        solve();
+        memory::copy(solution(), voltage);
+    }
+
     std::size_t size() const {
         return parent_index.size();
     }
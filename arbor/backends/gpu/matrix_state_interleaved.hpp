@@ -4,6 +4,7 @@
 #include <arbor/fvm_types.hpp>
 #include <arbor/math.hpp>
 
+#include "execution_context.hpp"
 #include "memory/memory.hpp"
 #include "util/span.hpp"
 #include "util/partition.hpp"
@@ -253,6 +254,16 @@ struct matrix_state_interleaved {
         solution_ = array(p.size());
     }
 
+    // The execution context is not used: the matrices are solved on the GPU.
+    matrix_state_interleaved(const std::vector<index_type>& p,
+                 const std::vector<index_type>& cell_cv_divs,
+                 const std::vector<value_type>& cv_cap,
+                 const std::vector<value_type>& face_cond,
+                 const std::vector<value_type>& area,
+                 const execution_context&):
+        matrix_state_interleaved(p, cell_cv_divs, cv_cap, face_cond, area)
+    {}
+
     const_view solution() const {
         return solution_;
     }
@@ -284,6 +295,14 @@ struct matrix_state_interleaved {
              padded_matrix_size(), num_matrices());
     }
 
+    // Assemble and solve the matrix, and overwrite the voltage with the
+    // solution.
+    void assemble_and_solve(const_view dt_cell, array& voltage, const_view current) {
+        assemble(dt_cell, voltage, current);
+        solve();
+        memory::copy(solution_, voltage);
+    }
+
 private:
 
     // The number of matrices stored in the matrix state.
@@ -178,5 +178,17 @@ void mechanism::set_global(const std::string& key, fvm_value_type value) {
     }
 }
 
+std::vector<fvm_value_type> mechanism::get_state() const {
+    auto values = memory::on_host(data_);
+    return std::vector<fvm_value_type>(values.begin(), values.end());
+}
+
+void mechanism::set_state(const std::vector<fvm_value_type>& values) {
+    if (values.size()!=data_.size()) {
+        throw bad_checkpoint("mechanism state size mismatch");
+    }
+    memory::copy(make_const_view(values), data_);
+}
+
 } // namespace multicore
 } // namespace arb
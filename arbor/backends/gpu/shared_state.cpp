@@ -1,6 +1,7 @@
 #include <cstddef>
 #include <vector>
 
+#include <arbor/arbexcept.hpp>
 #include <arbor/constants.hpp>
 #include <arbor/fvm_types.hpp>
 #include <arbor/ion.hpp>
@@ -120,6 +121,10 @@ shared_state::shared_state(
     dt_cv(n_cv),
     voltage(n_cv),
     current_density(n_cv),
+    dt_step(n_cell),
+    dt_prev(n_cell),
+    voltage_prev(n_cv),
+    dvdt(n_cv),
     temperature_degC(1),
     deliverable_events(n_cell)
 {}
@@ -170,6 +175,27 @@ void shared_state::update_time_to(fvm_value_type dt_step, fvm_value_type tmax) {
     update_time_to_impl(n_cell, time_to.data(), time.data(), dt_step, tmax);
 }
 
+// Adaptive time stepping is not supported by the GPU back end (see
+// backend::has_adaptive_dt), and fvm_lowered_cell does not call these.
+
+void shared_state::update_time_to(const array&, fvm_value_type, fvm_value_type) {
+    throw arbor_internal_error("gpu/shared_state: adaptive time stepping is not supported");
+}
+
+void shared_state::reset_dt_step(fvm_value_type dt) {
+    memory::fill(dt_step, dt);
+    memory::fill(dt_prev, 0);
+    memory::fill(dvdt, 0);
+}
+
+void shared_state::reset_dt_step(const deliverable_event_stream::state&, fvm_value_type) {
+    throw arbor_internal_error("gpu/shared_state: adaptive time stepping is not supported");
+}
+
+void shared_state::update_dt_step(fvm_value_type, fvm_value_type, fvm_value_type) {
+    throw arbor_internal_error("gpu/shared_state: adaptive time stepping is not supported");
+}
+
 void shared_state::set_dt() {
     set_dt_impl(n_cell, n_cv, dt_cell.data(), dt_cv.data(), time_to.data(), time.data(), cv_to_cell.data());
 }
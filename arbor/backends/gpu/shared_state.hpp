@@ -75,6 +75,13 @@ struct shared_state {
     array  dt_cv;             // Maps CV index to dt [ms].
     array  voltage;           // Maps CV index to membrane voltage [mV].
     array  current_density;   // Maps CV index to current density [A/m²].
+
+    // Adaptive time stepping state, kept so that checkpoints have the same
+    // layout on both back ends (see backends/adaptive_dt.hpp):
+    array  dt_step;           // Maps cell index to size of next step [ms].
+    array  dt_prev;           // Maps cell index to size of last step [ms], 0 if none.
+    array  voltage_prev;      // Maps CV index to membrane voltage at start of step [mV].
+    array  dvdt;              // Maps CV index to mean dV/dt over last step [mV/ms].
     array  temperature_degC;  // Global temperature [°C] (length 1 array).
 
     std::unordered_map<ionKind, ion_state> ion_data;
@@ -104,6 +111,15 @@ struct shared_state {
     // Set time_to to earliest of time+dt_step and tmax.
     void update_time_to(fvm_value_type dt_step, fvm_value_type tmax);
 
+    // Set the next adaptive step of each cell to dt, without error estimate.
+    void reset_dt_step(fvm_value_type dt);
+
+    // Adaptive time stepping is not supported (see backend::has_adaptive_dt):
+    // the following throw arbor_internal_error.
+    void update_time_to(const array& dt_step, fvm_value_type dt_max, fvm_value_type tmax);
+    void reset_dt_step(const deliverable_event_stream::state& s, fvm_value_type dt);
+    void update_dt_step(fvm_value_type tolerance, fvm_value_type dt_min, fvm_value_type dt_max);
+
     // Set the per-cell and per-compartment dt from time_to - time.
     void set_dt();
 
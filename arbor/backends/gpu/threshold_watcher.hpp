@@ -9,6 +9,7 @@
 #include "util/span.hpp"
 
 #include "backends/threshold_crossing.hpp"
+#include "checkpoint.hpp"
 #include "backends/gpu/gpu_store_types.hpp"
 #include "backends/gpu/managed_ptr.hpp"
 #include "backends/gpu/stack.hpp"
@@ -121,6 +122,23 @@ public:
         }
     }
 
+    /// Write the state of each watch to a checkpoint, or restore it.
+    void checkpoint(checkpoint_writer& out) const {
+        out.write_range(memory::on_host(is_crossed_));
+        out.write_range(memory::on_host(v_prev_));
+    }
+
+    void restore(checkpoint_reader& in) {
+        clear_crossings();
+        auto crossed = in.read_vector<fvm_index_type>();
+        auto v_prev = in.read_vector<fvm_value_type>();
+        if (crossed.size()!=size() || v_prev.size()!=size()) {
+            throw bad_checkpoint("number of threshold watches differs");
+        }
+        memory::copy(memory::make_const_view(crossed), is_crossed_);
+        memory::copy(memory::make_const_view(v_prev), v_prev_);
+    }
+
     /// the number of threshold values that are being monitored
     std::size_t size() const {
         return cv_index_.size();
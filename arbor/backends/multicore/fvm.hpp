@@ -5,6 +5,7 @@
 
 #include "backends/event.hpp"
 #include "backends/multicore/matrix_state.hpp"
+#include "backends/multicore/matrix_state_interleaved.hpp"
 #include "backends/multicore/multi_event_stream.hpp"
 #include "backends/multicore/multicore_common.hpp"
 #include "backends/multicore/shared_state.hpp"
@@ -20,6 +21,7 @@ namespace multicore {
 struct backend {
     static bool is_supported() { return true; }
     static std::string name() { return "cpu"; }
+    static bool has_adaptive_dt() { return true; }
 
     using value_type = fvm_value_type;
     using index_type = fvm_index_type;
@@ -36,7 +38,11 @@ struct backend {
         return util::range_pointer_view(v);
     }
 
+#ifdef ARB_HAVE_INTERLEAVED_MATRIX
+    using matrix_state = arb::multicore::matrix_state_interleaved<value_type, index_type>;
+#else
     using matrix_state = arb::multicore::matrix_state<value_type, index_type>;
+#endif
     using threshold_watcher = arb::multicore::threshold_watcher;
 
     using deliverable_event_stream = arb::multicore::deliverable_event_stream;
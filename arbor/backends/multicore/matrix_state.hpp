@@ -1,13 +1,31 @@
 #pragma once
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include <util/partition.hpp>
 #include <util/span.hpp>
 
+#include "execution_context.hpp"
+#include "threading/threading.hpp"
+#include "tree.hpp"
+
 #include "multicore_common.hpp"
 
 namespace arb {
 namespace multicore {
 
+// Hines matrices of a set of cells, stored one after the other.
+//
+// When constructed with an execution context with more than one thread, the
+// matrix of each cell with at least min_parallel_cvs CVs is decomposed into
+// subtrees, which are eliminated in parallel by assemble_and_solve, and the
+// junction CVs near the root that connect them, which are eliminated
+// serially. The updates of each CV are applied in the same order as by the
+// serial solver, so that the solution is the same. Smaller cells, and the
+// separate assemble and solve, are always serial.
+
 template <typename T, typename I>
 struct matrix_state {
 public:
@@ -44,7 +62,11 @@ public:
         d(size(), 0), u(size(), 0), rhs(size()),
         cv_capacitance(cap.begin(), cap.end()),
         face_conductance(cond.begin(), cond.end()),
-        cv_area(area.begin(), area.end())
+        cv_area(area.begin(), area.end()),
+        elimination_factor_(size(), 0),
+        inv_eliminated_d_(size(), 0),
+        factorized_dt_(cell_cv_divs.size()-1, 0),
+        is_decomposed_(cell_cv_divs.size()-1, 0)
     {
         arb_assert(cap.size() == size());
         arb_assert(cond.size() == size());
@@ -61,6 +83,26 @@ public:
         }
     }
 
+    matrix_state(const std::vector<index_type>& p,
+                 const std::vector<index_type>& cell_cv_divs,
+                 const std::vector<value_type>& cap,
+                 const std::vector<value_type>& cond,
+                 const std::vector<value_type>& area,
+                 const execution_context& context):
+        matrix_state(p, cell_cv_divs, cap, cond, area)
+    {
+        thread_pool_ = context.thread_pool;
+        if (thread_pool_ && thread_pool_->get_num_threads()>1) {
+            decompose(thread_pool_->get_num_threads());
+        }
+    }
+
+    // Cells with at least min_parallel_cvs CVs are decomposed into subtrees
+    // of at least min_subtree_cvs CVs, or fewer for a subtree of a
+    // decomposed cell that has no larger subtree containing it.
+    static constexpr index_type min_parallel_cvs = 4096;
+    static constexpr index_type min_subtree_cvs = 512;
+
     const_view solution() const {
         // In this back end the solution is a simple view of the rhs, which
         // contains the solution after the matrix_solve is performed.
@@ -124,11 +166,282 @@ public:
         }
     }
 
+    // Assemble and solve the matrix, overwriting the voltage with the
+    // solution, in one pass over the CVs of each cell.
+    //
+    // The diagonal depends only on dt, so the elimination factors u[i]/d[i]
+    // of the backward sweep and the inverse of the eliminated diagonal are
+    // computed once for each cell and reused while the dt of the cell is
+    // unchanged, and only the RHS is swept.
+    //   dt_cell         [ms]     (per cell)
+    //   voltage         [mV]     (per compartment)
+    //   current density [A.m^-2] (per compartment)
+    void assemble_and_solve(const_view dt_cell, array& voltage, const_view current) {
+        auto cell_cv_part = util::partition_view(cell_cv_divs);
+        const index_type ncells = cell_cv_part.size();
+
+        // loop over submatrices
+        for (auto m: util::make_span(0, ncells)) {
+            auto dt = dt_cell[m];
+
+            // The solution for a cell with zero dt is its voltage.
+            if (!(dt>0) || is_decomposed_[m]) continue;
+
+            auto first = cell_cv_part[m].first;
+            auto last = cell_cv_part[m].second; // one past the end
+
+            if (dt!=factorized_dt_[m]) {
+                factorize(m, dt);
+            }
+
+            assemble_rhs(first, last, dt, voltage, current);
+            backward_sweep(first+1, last, voltage);
+            voltage[first] *= inv_eliminated_d_[first];
+            forward_sweep(first+1, last, voltage);
+        }
+
+        if (!decomposed_cells_.empty()) {
+            assemble_and_solve_decomposed(dt_cell, voltage, current);
+        }
+    }
+
 private:
+    // Elimination factors and the inverse of the diagonal after the backward
+    // sweep, for each CV, and the dt for which they were computed, for each
+    // cell (zero if not yet computed).
+    array elimination_factor_;
+    array inv_eliminated_d_;
+    array factorized_dt_;
+
+    // Compute the elimination factors of cell m for the given dt, using d as
+    // scratch space.
+    void factorize(index_type m, value_type dt) {
+        auto first = cell_cv_divs[m];
+        auto last = cell_cv_divs[m+1];
+
+        value_type factor = 1e-3/dt;
+        for (auto i: util::make_span(first, last)) {
+            d[i] = factor*cv_capacitance[i] + invariant_d[i];
+        }
+        for (auto i=last-1; i>first; --i) {
+            auto f = u[i]/d[i];
+            elimination_factor_[i] = f;
+            d[parent_index[i]] -= f*u[i];
+        }
+        for (auto i: util::make_span(first, last)) {
+            inv_eliminated_d_[i] = 1/d[i];
+        }
+        factorized_dt_[m] = dt;
+    }
 
     std::size_t size() const {
         return parent_index.size();
     }
+
+    // Assemble the RHS of CVs [first, last) in place.
+    void assemble_rhs(index_type first, index_type last, value_type dt, array& voltage, const_view current) const {
+        value_type factor = 1e-3/dt;
+        for (auto i: util::make_span(first, last)) {
+            auto gi = factor*cv_capacitance[i];
+            // convert current to units nA
+            voltage[i] = gi*voltage[i] - 1e-3*cv_area[i]*current[i];
+        }
+    }
+
+    // Eliminate CVs [first, last) from their parents, in reverse order.
+    void backward_sweep(index_type first, index_type last, array& x) const {
+        for (auto i=last-1; i>=first; --i) {
+            x[parent_index[i]] -= elimination_factor_[i]*x[i];
+        }
+    }
+
+    // Substitute the solution of the parents of CVs [first, last).
+    void forward_sweep(index_type first, index_type last, array& x) const {
+        for (auto i: util::make_span(first, last)) {
+            x[i] = (x[i] - u[i]*x[parent_index[i]])*inv_eliminated_d_[i];
+        }
+    }
+
+    // Decomposition of large cells.
+    //
+    // The CVs of a subtree are stored as a sequence of runs of contiguous CV
+    // indices, in increasing order; the first CV of the first run is the
+    // root of the subtree. Subtrees are grouped into tasks of about equal
+    // numbers of CVs.
+    //
+    // The junction CVs of a cell are those not in any subtree except the root
+    // of the cell, and the roots of the subtrees. They are eliminated in
+    // decreasing order after the subtrees, so that the contributions of the
+    // children of each CV are accumulated in the same order as by the serial
+    // solver.
+
+    using cv_run = std::pair<index_type, index_type>;
+
+    struct subtree {
+        index_type cell;
+        index_type first_run;
+        index_type last_run;
+    };
+
+    struct decomposed_cell {
+        index_type cell;
+        std::vector<index_type> top;        // CVs not in a subtree, in increasing order.
+        std::vector<index_type> junction;   // Junction CVs, in increasing order.
+    };
+
+    task_system_handle thread_pool_;
+    std::vector<char> is_decomposed_;
+    std::vector<decomposed_cell> decomposed_cells_;
+    std::vector<cv_run> runs_;
+    std::vector<subtree> subtrees_;
+    std::vector<index_type> task_divs_;     // Partition of subtrees by task.
+
+    void decompose(unsigned nthreads) {
+        const index_type ncells = cell_cv_divs.size()-1;
+
+        // Several tasks per thread, for load balance.
+        const index_type ntask_per_cell = 4*nthreads;
+
+        task_divs_ = {0};
+        index_type task_cvs = 0;
+
+        for (auto m: util::make_span(ncells)) {
+            const auto first = cell_cv_divs[m];
+            const index_type n = cell_cv_divs[m+1]-first;
+            if (n<min_parallel_cvs) continue;
+
+            const index_type max_subtree_cvs = std::max(min_subtree_cvs, n/ntask_per_cell);
+
+            std::vector<tree::int_type> parents(n);
+            for (auto i: util::make_span(n)) {
+                parents[i] = parent_index[first+i]-first;
+            }
+            tree cell_tree(parents);
+
+            std::vector<index_type> subtree_cvs(n, 1);
+            for (auto i = n-1; i>0; --i) {
+                subtree_cvs[parents[i]] += subtree_cvs[i];
+            }
+
+            // Descend from the root to the largest subtrees of at most
+            // max_subtree_cvs CVs.
+            decomposed_cell cell{m, {}, {}};
+            std::vector<index_type> stack = {0}, cvs;
+            while (!stack.empty()) {
+                auto c = stack.back();
+                stack.pop_back();
+
+                if (c && subtree_cvs[c]<=max_subtree_cvs) {
+                    cell.junction.push_back(first+c);
+
+                    // Collect the CVs of the subtree, and store them as runs.
+                    cvs.clear();
+                    std::vector<index_type> subtree_stack = {c};
+                    while (!subtree_stack.empty()) {
+                        auto k = subtree_stack.back();
+                        subtree_stack.pop_back();
+                        cvs.push_back(first+k);
+                        for (auto child: cell_tree.children(k)) {
+                            subtree_stack.push_back(child);
+                        }
+                    }
+                    std::sort(cvs.begin(), cvs.end());
+
+                    index_type first_run = runs_.size();
+                    for (auto k: cvs) {
+                        if (runs_.size()>std::size_t(first_run) && runs_.back().second==k) {
+                            ++runs_.back().second;
+                        }
+                        else {
+                            runs_.push_back({k, k+1});
+                        }
+                    }
+                    subtrees_.push_back({m, first_run, index_type(runs_.size())});
+
+                    task_cvs += cvs.size();
+                    if (task_cvs>=max_subtree_cvs) {
+                        task_divs_.push_back(subtrees_.size());
+                        task_cvs = 0;
+                    }
+                }
+                else {
+                    cell.top.push_back(first+c);
+                    if (c) cell.junction.push_back(first+c);
+                    for (auto child: cell_tree.children(c)) {
+                        stack.push_back(child);
+                    }
+                }
+            }
+
+            std::sort(cell.top.begin(), cell.top.end());
+            std::sort(cell.junction.begin(), cell.junction.end());
+            decomposed_cells_.push_back(std::move(cell));
+            is_decomposed_[m] = 1;
+        }
+
+        if (task_divs_.back()!=index_type(subtrees_.size())) {
+            task_divs_.push_back(subtrees_.size());
+        }
+    }
+
+    void assemble_and_solve_decomposed(const_view dt_cell, array& voltage, const_view current) {
+        for (const auto& c: decomposed_cells_) {
+            auto dt = dt_cell[c.cell];
+            if (dt>0 && dt!=factorized_dt_[c.cell]) {
+                factorize(c.cell, dt);
+            }
+        }
+
+        auto for_each_subtree = [&](auto&& f) {
+            const int ntask = task_divs_.size()-1;
+            threading::parallel_for::apply(0, ntask, thread_pool_.get(),
+                [&](int t) {
+                    for (auto k: util::make_span(task_divs_[t], task_divs_[t+1])) {
+                        const auto& s = subtrees_[k];
+                        auto dt = dt_cell[s.cell];
+                        if (dt>0) {
+                            f(s, dt);
+                        }
+                    }
+                });
+        };
+
+        // Assemble and eliminate the subtrees, except for their roots.
+        for_each_subtree([&](const subtree& s, value_type dt) {
+            for (auto r: util::make_span(s.first_run, s.last_run)) {
+                assemble_rhs(runs_[r].first, runs_[r].second, dt, voltage, current);
+            }
+            for (auto r = s.last_run-1; r>s.first_run; --r) {
+                backward_sweep(runs_[r].first, runs_[r].second, voltage);
+            }
+            backward_sweep(runs_[s.first_run].first+1, runs_[s.first_run].second, voltage);
+        });
+
+        // Solve the junctions.
+        for (const auto& c: decomposed_cells_) {
+            auto dt = dt_cell[c.cell];
+            if (!(dt>0)) continue;
+
+            for (auto i: c.top) {
+                assemble_rhs(i, i+1, dt, voltage, current);
+            }
+            for (auto j = c.junction.rbegin(); j!=c.junction.rend(); ++j) {
+                backward_sweep(*j, *j+1, voltage);
+            }
+            auto root = c.top.front();
+            voltage[root] *= inv_eliminated_d_[root];
+            for (auto i: util::make_span(1, c.top.size())) {
+                forward_sweep(c.top[i], c.top[i]+1, voltage);
+            }
+        }
+
+        // Substitute in the subtrees.
+        for_each_subtree([&](const subtree& s, value_type) {
+            for (auto r: util::make_span(s.first_run, s.last_run)) {
+                forward_sweep(runs_[r].first, runs_[r].second, voltage);
+            }
+        });
+    }
 };
 
 } // namespace multicore
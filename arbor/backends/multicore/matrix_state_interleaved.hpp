@@ -0,0 +1,294 @@
+#pragma once
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include <arbor/assert.hpp>
+#include <arbor/simd/simd.hpp>
+
+#include "execution_context.hpp"
+#include "util/rangeutil.hpp"
+#include "util/span.hpp"
+
+#include "multicore_common.hpp"
+
+namespace arb {
+namespace multicore {
+
+// Hines matrices of a set of cells, stored and solved in an interleaved
+// format.
+//
+// The matrices are sorted in descending order of size, and packed into blocks
+// of simd_width matrices. The i-th row of the matrices of a block is stored
+// contiguously, so that the backward and forward sweeps of the matrices of a
+// block can be performed in lockstep, simd_width matrices per instruction.
+// Rows past the end of a smaller matrix in a block, and lanes of the last
+// block that hold no matrix, are padded with rows with u = 0 and d = 1, that
+// are decoupled from the rest of the matrix.
+//
+// The layout follows that of gpu::matrix_state_interleaved, except that each
+// block is padded to the size of its largest matrix, not the largest matrix
+// overall. See also arbor/backends/matrix_storage.md.
+
+template <typename T, typename I>
+struct matrix_state_interleaved {
+public:
+    using value_type = T;
+    using index_type = I;
+
+    using array = padded_vector<value_type>;
+    using const_view = const array&;
+
+    using iarray = padded_vector<index_type>;
+
+    // At least four lanes per block, even without native SIMD support, so
+    // that the dependency chains of the sweeps of several matrices are
+    // interleaved.
+    static constexpr unsigned simd_width =
+        std::max(simd::simd_abi::native_width<value_type>::value, 4);
+
+    using simd_value = simd::simd<value_type, simd_width>;
+    using simd_index = simd::simd<index_type, simd_width>;
+
+    // Per-cell partition of the CVs in the flat (external) storage.
+    iarray cell_cv_divs;
+
+    // Offset in the interleaved storage of each block, and the number of rows
+    // in the block.
+    std::vector<index_type> block_start;
+    std::vector<index_type> block_size;
+
+    // Cell index of each matrix, after sorting by size.
+    std::vector<index_type> matrix_to_cell;
+
+    // Interleaved storage. The parent indices are offsets in the interleaved
+    // storage.
+    iarray parent_index;
+
+    // For each row of each block, whether the parents of the lanes are in the
+    // same row, as is the case for matrices of the same structure, so that
+    // they can be accessed without gather and scatter.
+    std::vector<simd::index_constraint> parent_constraint;
+    array d;     // [μS]
+    array u;     // [μS]
+    array rhs;   // [nA]
+
+    array cv_capacitance;      // [pF]
+    array cv_area;             // [μm^2]
+
+    // the invariant part of the matrix diagonal
+    array invariant_d;         // [μS]
+
+    matrix_state_interleaved() = default;
+
+    matrix_state_interleaved(const std::vector<index_type>& p,
+                 const std::vector<index_type>& cell_cv_divs,
+                 const std::vector<value_type>& cap,
+                 const std::vector<value_type>& cond,
+                 const std::vector<value_type>& area):
+        cell_cv_divs(cell_cv_divs.begin(), cell_cv_divs.end())
+    {
+        arb_assert(cap.size() == p.size());
+        arb_assert(cond.size() == p.size());
+        arb_assert(cell_cv_divs.back() == (index_type)p.size());
+
+        const index_type ncells = cell_cv_divs.size()-1;
+        auto cell_size = [&](index_type c) { return cell_cv_divs[c+1]-cell_cv_divs[c]; };
+
+        // Sort the matrices in descending order of size.
+        matrix_to_cell.resize(ncells);
+        std::iota(matrix_to_cell.begin(), matrix_to_cell.end(), 0);
+        util::stable_sort_by(matrix_to_cell,
+            [&](index_type c) { return -cell_size(c); });
+
+        const index_type nblocks = (ncells+simd_width-1)/simd_width;
+        block_start.assign(nblocks+1, 0);
+        block_size.assign(nblocks, 0);
+        for (auto b: util::make_span(nblocks)) {
+            block_size[b] = cell_size(matrix_to_cell[b*simd_width]);
+            block_start[b+1] = block_start[b] + block_size[b]*simd_width;
+        }
+        const auto n = block_start.back();
+
+        // Padding rows have u = 0 and d = 1.
+        parent_index = iarray(n);
+        d = array(n, 1);
+        u = array(n, 0);
+        rhs = array(n, 0);
+        cv_capacitance = array(n, 0);
+        cv_area = array(n, 0);
+        invariant_d = array(n, 1);
+
+        std::vector<bool> is_padding(n, true);
+        for_each_cv([&](index_type i, index_type k, index_type first, index_type dst) {
+            is_padding[k] = false;
+            parent_index[k] = dst + simd_width*(p[i]-first);
+            cv_capacitance[k] = cap[i];
+            cv_area[k] = area[i];
+            invariant_d[k] = 0;
+        });
+        for_each_cv([&](index_type i, index_type k, index_type, index_type) {
+            if (i>0) {
+                auto gij = cond[i];
+
+                u[k] = -gij;
+                invariant_d[k] += gij;
+                invariant_d[parent_index[k]] += gij;
+            }
+        });
+
+        // The parent of a padding row is taken in the row of the parent of
+        // the first lane, which always holds a matrix, so that padding does
+        // not prevent contiguous access to the parents.
+        parent_constraint.assign(n/simd_width, simd::index_constraint::contiguous);
+        for (auto k: util::make_span(n)) {
+            auto lane = index_type(k%simd_width);
+            auto parent = parent_index[k-lane]+lane;
+            if (is_padding[k]) {
+                parent_index[k] = parent;
+            }
+            else if (parent_index[k]!=parent) {
+                parent_constraint[k/simd_width] = simd::index_constraint::independent;
+            }
+        }
+
+        solution_ = array(p.size(), 0);
+    }
+
+    // The matrices are solved serially.
+    matrix_state_interleaved(const std::vector<index_type>& p,
+                 const std::vector<index_type>& cell_cv_divs,
+                 const std::vector<value_type>& cap,
+                 const std::vector<value_type>& cond,
+                 const std::vector<value_type>& area,
+                 const execution_context&):
+        matrix_state_interleaved(p, cell_cv_divs, cap, cond, area)
+    {}
+
+    const_view solution() const {
+        return solution_;
+    }
+
+    // Assemble the matrix
+    // Afterwards the diagonal and RHS will have been set given dt, voltage and current.
+    //   dt_cell         [ms]     (per cell)
+    //   voltage         [mV]     (per compartment)
+    //   current density [A.m^-2] (per compartment)
+    void assemble(const_view dt_cell, const_view voltage, const_view current) {
+        for (auto m: util::count_along(matrix_to_cell)) {
+            auto c = matrix_to_cell[m];
+            auto dt = dt_cell[c];
+            auto k = block_start[m/simd_width] + m%simd_width;
+
+            if (dt>0) {
+                value_type factor = 1e-3/dt;
+                for (auto i = cell_cv_divs[c]; i<cell_cv_divs[c+1]; ++i, k += simd_width) {
+                    auto gi = factor*cv_capacitance[k];
+
+                    d[k] = gi + invariant_d[k];
+                    // convert current to units nA
+                    rhs[k] = gi*voltage[i] - 1e-3*cv_area[k]*current[i];
+                }
+            }
+            else {
+                for (auto i = cell_cv_divs[c]; i<cell_cv_divs[c+1]; ++i, k += simd_width) {
+                    d[k] = 0;
+                    rhs[k] = voltage[i];
+                }
+            }
+        }
+    }
+
+    void solve() {
+        sweep();
+        copy_solution(solution_);
+    }
+
+    // Assemble and solve the matrix, and overwrite the voltage with the
+    // solution.
+    void assemble_and_solve(const_view dt_cell, array& voltage, const_view current) {
+        assemble(dt_cell, voltage, current);
+        sweep();
+        copy_solution(voltage);
+    }
+
+private:
+    // The solution in the flat storage.
+    array solution_;
+
+    // Solve the matrices in place, leaving the solution in rhs.
+    void sweep() {
+        using simd::indirect;
+        using simd::where;
+
+        const simd_value zero(value_type(0));
+        const index_type width = simd_width;
+
+        // loop over blocks
+        for (auto b: util::count_along(block_size)) {
+            const auto first = block_start[b];
+            const auto last = block_start[b+1];
+
+            // Matrices with zero diagonal are left unchanged.
+            const auto solve_mask = simd_value(d.data()+first)!=zero;
+
+            // backward sweep
+            for (auto k = last-width; k>first; k -= width) {
+                simd_index p(parent_index.data()+k);
+                auto constraint = parent_constraint[k/width];
+                simd_value u_k(u.data()+k);
+
+                simd_value factor = zero;
+                where(solve_mask, factor) = u_k/simd_value(d.data()+k);
+
+                indirect(d.data(), p, constraint) -= factor*u_k;
+                indirect(rhs.data(), p, constraint) -= factor*simd_value(rhs.data()+k);
+            }
+
+            simd_value rhs_first(rhs.data()+first);
+            where(solve_mask, rhs_first) = rhs_first/simd_value(d.data()+first);
+            rhs_first.copy_to(rhs.data()+first);
+
+            // forward sweep
+            for (auto k = first+width; k<last; k += width) {
+                simd_index p(parent_index.data()+k);
+
+                simd_value rhs_k(rhs.data()+k);
+                simd_value x = rhs_k - simd_value(u.data()+k)*simd_value(indirect(rhs.data(), p, parent_constraint[k/width]));
+                where(solve_mask, rhs_k) = x/simd_value(d.data()+k);
+                rhs_k.copy_to(rhs.data()+k);
+            }
+        }
+
+    }
+
+    // Copy the solution in rhs to the flat storage.
+    void copy_solution(array& out) const {
+        for (auto m: util::count_along(matrix_to_cell)) {
+            auto c = matrix_to_cell[m];
+            auto k = block_start[m/simd_width] + m%simd_width;
+            for (auto i = cell_cv_divs[c]; i<cell_cv_divs[c+1]; ++i, k += simd_width) {
+                out[i] = rhs[k];
+            }
+        }
+    }
+
+    // Call f(i, k, first, dst) for each CV, with the index i of the CV in the
+    // flat storage, its index k in the interleaved storage, and the indices
+    // of the first CV of its cell in the flat and interleaved storage.
+    template <typename F>
+    void for_each_cv(F&& f) const {
+        for (auto m: util::count_along(matrix_to_cell)) {
+            auto c = matrix_to_cell[m];
+            auto first = cell_cv_divs[c];
+            auto dst = block_start[m/simd_width] + m%simd_width;
+            for (auto i: util::make_span(first, cell_cv_divs[c+1])) {
+                f(i, dst + simd_width*(i-first), first, dst);
+            }
+        }
+    }
+};
+
+} // namespace multicore
+} // namespace arb
@@ -5,6 +5,7 @@
 #include <utility>
 #include <vector>
 
+#include <arbor/arbexcept.hpp>
 #include <arbor/fvm_types.hpp>
 #include <arbor/common_types.hpp>
 #include <arbor/math.hpp>
@@ -183,5 +184,16 @@ void mechanism::set_global(const std::string& key, fvm_value_type value) {
     }
 }
 
+std::vector<fvm_value_type> mechanism::get_state() const {
+    return std::vector<fvm_value_type>(data_.begin(), data_.end());
+}
+
+void mechanism::set_state(const std::vector<fvm_value_type>& values) {
+    if (values.size()!=data_.size()) {
+        throw bad_checkpoint("mechanism state size mismatch");
+    }
+    std::copy(values.begin(), values.end(), data_.begin());
+}
+
 } // namespace multicore
 } // namespace arb
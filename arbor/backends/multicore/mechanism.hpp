@@ -65,6 +65,10 @@ public:
 
     void set_global(const std::string& key, fvm_value_type value) override;
 
+    std::vector<fvm_value_type> get_state() const override;
+
+    void set_state(const std::vector<fvm_value_type>& values) override;
+
 protected:
     size_type width_ = 0;        // Instance width (number of CVs/sites)
     size_type width_padded_ = 0; // Width rounded up to multiple of pad/alignment.
@@ -14,6 +14,7 @@
 #include <arbor/math.hpp>
 #include <arbor/simd/simd.hpp>
 
+#include "backends/adaptive_dt.hpp"
 #include "backends/event.hpp"
 #include "io/sepval.hpp"
 #include "util/padded_alloc.hpp"
@@ -130,6 +131,10 @@ shared_state::shared_state(
     dt_cv(n_cv, pad(alignment)),
     voltage(n_cv, pad(alignment)),
     current_density(n_cv, pad(alignment)),
+    dt_step(n_cell, pad(alignment)),
+    dt_prev(n_cell, pad(alignment)),
+    voltage_prev(n_cv, pad(alignment)),
+    dvdt(n_cv, pad(alignment)),
     temperature_degC(NAN),
     deliverable_events(n_cell)
 {
@@ -191,6 +196,30 @@ void shared_state::update_time_to(fvm_value_type dt_step, fvm_value_type tmax) {
     }
 }
 
+void shared_state::update_time_to(const array& dt_step, fvm_value_type dt_max, fvm_value_type tmax) {
+    for (fvm_size_type i = 0; i<n_cell; i+=simd_width) {
+        simd_value_type t(time.data()+i);
+        simd_value_type dt(dt_step.data()+i);
+        t = min(t+min(dt, simd_value_type(dt_max)), simd_value_type(tmax));
+        t.copy_to(time_to.data()+i);
+    }
+}
+
+void shared_state::reset_dt_step(fvm_value_type dt) {
+    util::fill(dt_step, dt);
+    util::fill(dt_prev, 0);
+    util::fill(dvdt, 0);
+}
+
+void shared_state::reset_dt_step(const deliverable_event_stream::state& s, fvm_value_type dt) {
+    adaptive_dt::restart_marked(s, dt_step.data(), dt_prev.data(), dt);
+}
+
+void shared_state::update_dt_step(fvm_value_type tolerance, fvm_value_type dt_min, fvm_value_type dt_max) {
+    adaptive_dt::update_step(n_cv, cv_to_cell.data(), dt_cell.data(), voltage.data(), voltage_prev.data(),
+        dvdt.data(), dt_step.data(), dt_prev.data(), tolerance, dt_min, dt_max);
+}
+
 void shared_state::set_dt() {
     for (fvm_size_type j = 0; j<n_cell; j+=simd_width) {
         simd_value_type t(time.data()+j);
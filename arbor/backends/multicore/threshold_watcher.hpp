@@ -5,6 +5,7 @@
 #include <arbor/math.hpp>
 
 #include "backends/threshold_crossing.hpp"
+#include "checkpoint.hpp"
 #include "execution_context.hpp"
 #include "multicore_common.hpp"
 
@@ -96,6 +97,18 @@ public:
         return is_crossed_[i];
     }
 
+    /// Write the state of each watch to a checkpoint, or restore it.
+    void checkpoint(checkpoint_writer& out) const {
+        out.write_range(is_crossed_);
+        out.write_range(v_prev_);
+    }
+
+    void restore(checkpoint_reader& in) {
+        clear_crossings();
+        in.read_into(is_crossed_);
+        in.read_into(v_prev_);
+    }
+
     /// The number of threshold values that are monitored.
     std::size_t size() const {
         return n_cv_;
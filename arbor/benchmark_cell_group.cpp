@@ -80,6 +80,18 @@ void benchmark_cell_group::clear_spikes() {
     spikes_.clear();
 }
 
+void benchmark_cell_group::checkpoint(checkpoint_writer& out) const {
+    out.write(t_);
+}
+
+void benchmark_cell_group::restore(checkpoint_reader& in) {
+    in.read(t_);
+    clear_spikes();
+    for (auto& c: cells_) {
+        fast_forward(c.time_sequence, t_);
+    }
+}
+
 void benchmark_cell_group::add_sampler(sampler_association_handle h,
                                    cell_member_predicate probe_ids,
                                    schedule sched,
@@ -10,6 +10,7 @@
 #include <arbor/spike.hpp>
 #include <arbor/spike_event.hpp>
 
+#include "checkpoint.hpp"
 #include "epoch.hpp"
 #include "event_binner.hpp"
 #include "event_queue.hpp"
@@ -32,6 +33,12 @@ public:
     virtual const std::vector<spike>& spikes() const = 0;
     virtual void clear_spikes() = 0;
 
+    // Write the state of the cells to a checkpoint, or restore it from a
+    // checkpoint written by a cell group with the same cells, at the end
+    // of an epoch. Samplers and the binning policy are not included.
+    virtual void checkpoint(checkpoint_writer&) const = 0;
+    virtual void restore(checkpoint_reader&) = 0;
+
     // Sampler association methods below should be thread-safe, as they might be invoked
     // from a sampler call back called from a different cell group running on a different thread.
 
@@ -0,0 +1,152 @@
+#pragma once
+
+// Binary buffers for simulation checkpoints.
+//
+// Values are written in the byte order and representation of the host, so a
+// checkpoint can only be restored on the same kind of system. Arrays are
+// written in bulk, prefixed by their length, and checked against the length
+// expected when they are read back.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/common_types.hpp>
+
+#include "util/strprintf.hpp"
+
+namespace arb {
+
+class checkpoint_writer {
+public:
+    template <typename T>
+    void write(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "checkpoint values must be trivially copyable");
+        append(&value, sizeof(T));
+    }
+
+    // Write the length of a contiguous range followed by its values.
+    template <typename Range>
+    void write_range(const Range& r) {
+        using T = std::decay_t<decltype(*std::begin(r))>;
+        static_assert(std::is_trivially_copyable<T>::value, "checkpoint values must be trivially copyable");
+
+        std::uint64_t n = std::distance(std::begin(r), std::end(r));
+        write(n);
+        if (n) append(&*std::begin(r), n*sizeof(T));
+    }
+
+    // Write the contents of another checkpoint as a block that can be read
+    // back with checkpoint_reader::read_block.
+    void write_block(const checkpoint_writer& block) {
+        write_range(block.data_);
+    }
+
+    const std::vector<char>& data() const { return data_; }
+    std::vector<char>& data() { return data_; }
+
+private:
+    std::vector<char> data_;
+
+    void append(const void* p, std::size_t n) {
+        auto offset = data_.size();
+        data_.resize(offset+n);
+        std::memcpy(data_.data()+offset, p, n);
+    }
+};
+
+class checkpoint_reader {
+public:
+    checkpoint_reader(const char* begin, const char* end):
+        pos_(begin), end_(end)
+    {}
+
+    template <typename T>
+    T read() {
+        static_assert(std::is_trivially_copyable<T>::value, "checkpoint values must be trivially copyable");
+        T value;
+        take(&value, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    void read(T& value) {
+        value = read<T>();
+    }
+
+    template <typename T>
+    std::vector<T> read_vector() {
+        auto n = read_size();
+        check_available(n, sizeof(T));
+        std::vector<T> v(n);
+        if (n) take(v.data(), n*sizeof(T));
+        return v;
+    }
+
+    // Read a range written with checkpoint_writer::write_range into a
+    // contiguous container of the same length.
+    template <typename Container>
+    void read_into(Container& c) {
+        using T = std::decay_t<decltype(*std::begin(c))>;
+        auto n = read_size();
+        if (n!=std::size_t(std::distance(std::begin(c), std::end(c)))) {
+            throw bad_checkpoint(util::pprintf("expected {} values, found {}", c.size(), n));
+        }
+        if (n) take(&*std::begin(c), n*sizeof(T));
+    }
+
+    // A reader for a block written with checkpoint_writer::write_block.
+    checkpoint_reader read_block() {
+        auto n = read_size();
+        check_available(n, 1);
+        checkpoint_reader block(pos_, pos_+n);
+        pos_ += n;
+        return block;
+    }
+
+    bool done() const {
+        return pos_==end_;
+    }
+
+private:
+    const char* pos_;
+    const char* end_;
+
+    std::size_t read_size() {
+        return read<std::uint64_t>();
+    }
+
+    void check_available(std::uint64_t n, std::size_t size) {
+        if (n>std::uint64_t(end_-pos_)/size) {
+            throw bad_checkpoint("unexpected end of checkpoint data");
+        }
+    }
+
+    void take(void* p, std::size_t n) {
+        check_available(n, 1);
+        std::memcpy(p, pos_, n);
+        pos_ += n;
+    }
+};
+
+// Schedules and event generators are not written to checkpoints: queries
+// are monotonic in time, so the state of a schedule or generator that has
+// been queried for all times before t is restored by resetting it and
+// querying [0, t), in intervals that bound the number of events generated
+// by each query.
+template <typename Seq>
+void fast_forward(Seq& seq, time_type t) {
+    constexpr time_type interval = 1000;
+
+    seq.reset();
+    for (std::uint64_t i = 0; i*interval<t; ++i) {
+        seq.events(i*interval, std::min<time_type>(t, (i+1)*interval));
+    }
+}
+
+} // namespace arb
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <random>
 #include <utility>
 #include <vector>
@@ -12,9 +13,13 @@
 #include <arbor/domain_decomposition.hpp>
 #include <arbor/recipe.hpp>
 #include <arbor/spike.hpp>
+#include <arbor/util/optional.hpp>
 
 #include "algorithms.hpp"
+#include "communication/connection_index.hpp"
+#include "communication/gather_request.hpp"
 #include "communication/gathered_vector.hpp"
+#include "communication/packed_spikes.hpp"
 #include "connection.hpp"
 #include "distributed_context.hpp"
 #include "event_queue.hpp"
@@ -39,6 +44,36 @@ namespace arb {
 // to build the data structures required for efficient spike communication and
 // event generation.
 
+// A spike exchange started by communicator::start_exchange(), and completed
+// by communicator::finish_exchange().
+class spike_exchange {
+public:
+    // The spikes received in the exchange, after it has been completed:
+    // with the gather policy these are all the spikes of all domains.
+    const std::vector<spike>& spikes() {
+        if (compressed_) {
+            if (!unpacked_) {
+                unpacked_ = unpack_spikes(packed_.finish());
+            }
+            return *unpacked_;
+        }
+        return gathered_.finish().values();
+    }
+
+private:
+    friend class communicator;
+
+    // With the point to point policy, the local spikes to be exchanged when
+    // the exchange is completed.
+    std::vector<spike> local_spikes_;
+    bool started_ = false;
+
+    bool compressed_ = false;
+    gather_request<spike> gathered_;
+    gather_request<char> packed_;
+    util::optional<std::vector<spike>> unpacked_;
+};
+
 class communicator {
 public:
     communicator() {}
@@ -54,84 +89,119 @@ public:
         num_local_groups_ = dom_dec.groups.size();
         num_local_cells_ = dom_dec.num_local_cells;
 
-        // For caching information about each cell
-        struct gid_info {
-            using connection_list = decltype(std::declval<recipe>().connections_on(0));
-            cell_gid_type gid;              // global identifier of cell
-            cell_size_type index_on_domain; // index of cell in this domain
-            connection_list conns;          // list of connections terminating at this cell
-            gid_info() = default;           // so we can in a std::vector
-            gid_info(cell_gid_type g, cell_size_type di, connection_list c):
-                gid(g), index_on_domain(di), conns(std::move(c)) {}
-        };
-
-        // Make a list of local gid with their group index and connections
-        //   -> gid_infos
-        // Count the number of local connections (i.e. connections terminating on this domain)
-        //   -> n_cons: scalar
-        // Calculate and store domain id of the presynaptic cell on each local connection
-        //   -> src_domains: array with one entry for every local connection
-        // Also the count of presynaptic sources from each domain
-        //   -> src_counts: array with one entry for each domain
-
-        // Record all the gid in a flat vector.
-        // These are used to map from local index to gid in the parallel loop
-        // that populates gid_infos.
+        // Record all the gid in a flat vector, in order of local index.
         std::vector<cell_gid_type> gids;
         gids.reserve(num_local_cells_);
         for (auto g: dom_dec.groups) {
             util::append(gids, g.gids);
         }
-        // Build the connection information for local cells in parallel.
-        std::vector<gid_info> gid_infos;
-        gid_infos.resize(num_local_cells_);
-        threading::parallel_for::apply(0, gids.size(), thread_pool_.get(),
-            [&](cell_size_type i) {
-                auto gid = gids[i];
-                gid_infos[i] = gid_info(gid, i, rec.connections_on(gid));
+
+        // The connections are built with a counting sort by the domain of
+        // their source gid, in two parallel passes over blocks of local cells.
+        // The first pass collects the connections on the cells of each block
+        // in a flat buffer, and counts them by source domain. The second
+        // scatters the connections of each block to their place in connections_,
+        // after those of the blocks before it with sources on the same domain.
+        // A few blocks per thread balance the work, while bounding the size
+        // of the table of counts by block and domain.
+        const cell_size_type max_blocks = 8*thread_pool_->get_num_threads();
+        const cell_size_type min_block_size = 256;
+        const cell_size_type n_blocks = std::min(max_blocks, (num_local_cells_+min_block_size-1)/min_block_size);
+        const cell_size_type block_size = n_blocks? (num_local_cells_+n_blocks-1)/n_blocks: 0;
+
+        std::vector<std::vector<connection>> block_connections(n_blocks);
+        std::vector<std::vector<int>> block_domains(n_blocks);
+        std::vector<cell_size_type> block_counts(n_blocks*num_domains_);
+
+        threading::parallel_for::apply(0, n_blocks, thread_pool_.get(),
+            [&](cell_size_type b) {
+                auto& conns = block_connections[b];
+                auto& domains = block_domains[b];
+                auto counts = block_counts.data()+b*num_domains_;
+                auto push = [&](const connection& c) {
+                    auto d = dom_dec.gid_domain(c.source().gid);
+                    conns.push_back(c);
+                    domains.push_back(d);
+                    ++counts[d];
+                };
+
+                const cell_size_type first = b*block_size;
+                const cell_size_type last = std::min(first+block_size, num_local_cells_);
+
+                // Fetch the connections on each run of consecutive gids
+                // in the block with one call to the recipe.
+                std::vector<cell_connection> buffer;
+                for (auto i = first; i<last;) {
+                    auto j = i+1;
+                    while (j<last && gids[j]==gids[j-1]+1) ++j;
+
+                    const auto gid_first = gids[i];
+                    const auto gid_last = gids[j-1]+1;
+                    buffer.clear();
+                    rec.append_connections_on(gid_first, gid_last, buffer);
+                    for (const auto& c: buffer) {
+                        if (c.dest.gid<gid_first || c.dest.gid>=gid_last) {
+                            throw bad_connection_target(c.dest, gid_first, gid_last);
+                        }
+                        push({c.source, c.dest, c.weight, c.delay, i+(c.dest.gid-gid_first)});
+                    }
+                    i = j;
+                }
             });
 
-        cell_local_size_type n_cons =
-            util::sum_by(gid_infos, [](const gid_info& g){ return g.conns.size(); });
-        std::vector<unsigned> src_domains;
-        src_domains.reserve(n_cons);
+        // The offset of the connections of each block with sources on each
+        // domain: these are ordered first by domain, then by block.
         std::vector<cell_size_type> src_counts(num_domains_);
-        for (const auto& g: gid_infos) {
-            for (auto con: g.conns) {
-                const auto src = dom_dec.gid_domain(con.source.gid);
-                src_domains.push_back(src);
-                src_counts[src]++;
+        for (cell_size_type b = 0; b<n_blocks; ++b) {
+            for (cell_size_type d = 0; d<num_domains_; ++d) {
+                src_counts[d] += block_counts[b*num_domains_+d];
             }
         }
-
-        // Construct the connections.
-        // The loop above gave the information required to construct in place
-        // the connections as partitioned by the domain of their source gid.
-        connections_.resize(n_cons);
         connection_part_ = algorithms::make_index(src_counts);
-        auto offsets = connection_part_;
-        std::size_t pos = 0;
-        for (const auto& cell: gid_infos) {
-            for (auto c: cell.conns) {
-                const auto i = offsets[src_domains[pos]]++;
-                connections_[i] = {c.source, c.dest, c.weight, c.delay, cell.index_on_domain};
-                ++pos;
+        connections_.resize(connection_part_.back());
+
+        auto& block_offsets = block_counts;
+        for (cell_size_type d = 0; d<num_domains_; ++d) {
+            auto offset = connection_part_[d];
+            for (cell_size_type b = 0; b<n_blocks; ++b) {
+                auto n = block_offsets[b*num_domains_+d];
+                block_offsets[b*num_domains_+d] = offset;
+                offset += n;
             }
         }
 
+        threading::parallel_for::apply(0, n_blocks, thread_pool_.get(),
+            [&](cell_size_type b) {
+                auto offsets = block_offsets.data()+b*num_domains_;
+                const auto& conns = block_connections[b];
+                const auto& domains = block_domains[b];
+                for (std::size_t i = 0; i<conns.size(); ++i) {
+                    connections_[offsets[domains[i]]++] = conns[i];
+                }
+            });
+
         // Build cell partition by group for passing events to cell groups
         index_part_ = util::make_partition(index_divisions_,
             util::transform_view(
                 dom_dec.groups,
                 [](const group_description& g){return g.gids.size();}));
 
-        // Sort the connections for each domain.
+        // Sort the connections for each domain by source, and connections
+        // with the same source by target cell.
         // This is num_domains_ independent sorts, so it can be parallelized trivially.
         const auto& cp = connection_part_;
         threading::parallel_for::apply(0, num_domains_, thread_pool_.get(),
             [&](cell_size_type i) {
-                util::sort(util::subrange_view(connections_, cp[i], cp[i+1]));
+                util::sort(util::subrange_view(connections_, cp[i], cp[i+1]),
+                    [](const connection& a, const connection& b) {
+                        return a.source()<b.source() ||
+                               (a.source()==b.source() && a.index_on_domain()<b.index_on_domain());
+                    });
             });
+
+        // Index the connections by source for make_event_queues.
+        // Each source is on exactly one domain, so one index covers all domains.
+        connection_index_ = connection_index(connections_);
     }
 
     /// The range of event queues that belong to cells in group i.
@@ -150,16 +220,87 @@ public:
         return distributed_->min(local_min);
     }
 
+    /// The minimum delay of connections from cells on domain dom to cells
+    /// on this domain.
+    time_type min_delay_from(cell_size_type dom) const {
+        arb_assert(dom<num_domains_);
+        auto local_min = std::numeric_limits<time_type>::max();
+        for (auto& con: util::subrange_view(connections_, connection_part_[dom], connection_part_[dom+1])) {
+            local_min = std::min(local_min, con.delay());
+        }
+        return local_min;
+    }
+
+    /// The minimum delay of all connections between cells on different
+    /// domains in the global network: the latest that a spike must be sent
+    /// to other domains. The maximum time_type value if there are none.
+    time_type min_remote_delay() {
+        auto local_min = std::numeric_limits<time_type>::max();
+        for (auto dom: util::make_span(num_domains_)) {
+            if (int(dom)!=distributed_->id()) {
+                local_min = std::min(local_min, min_delay_from(dom));
+            }
+        }
+        return distributed_->min(local_min);
+    }
+
+    /// Select how spikes are exchanged between domains.
+    ///
+    /// The first time point_to_point is selected the tables that map local
+    /// sources to the domains that have connections from them are built,
+    /// which is a collective operation: the policy must be set on all domains.
+    void set_exchange_policy(spike_exchange_policy policy) {
+        if (policy==spike_exchange_policy::point_to_point && route_part_.empty()) {
+            make_routes();
+        }
+        policy_ = policy;
+    }
+
+    spike_exchange_policy exchange_policy() const {
+        return policy_;
+    }
+
+    /// Select whether spikes gathered with the gather policy are exchanged
+    /// in the packed format of communication/packed_spikes.hpp, in which case
+    /// exchange_packed() is used in place of exchange().
+    /// Must be set to the same value on all domains.
+    void set_compression(bool compress) {
+        compress_ = compress;
+    }
+
+    bool compression() const {
+        return compress_ && policy_==spike_exchange_policy::gather;
+    }
+
+    /// Select whether start_exchange() gathers spikes with point to point
+    /// messages between every pair of domains, if the distributed context
+    /// supports it, instead of with a collective.
+    /// Must be set to the same value on all domains.
+    void set_pairwise_gather(bool pairwise) {
+        pairwise_ = pairwise;
+    }
+
+    bool pairwise_gather() const {
+        return pairwise_;
+    }
+
     /// Perform exchange of spikes.
     ///
     /// Takes as input the list of local_spikes that were generated on the calling domain.
-    /// Returns the full global set of vectors, along with meta data about their partition
+    /// Returns the set of spikes required by the local domain partitioned by
+    /// source domain. With the gather policy this is the full global set of
+    /// spikes; with the point_to_point policy it is only the spikes from
+    /// sources with connections on the local domain.
     gathered_vector<spike> exchange(std::vector<spike> local_spikes) {
         PE(communication_exchange_sort);
         // sort the spikes in ascending order of source gid
-        util::sort_by(local_spikes, [](spike s){return s.source;});
+        sort_by_source(local_spikes);
         PL();
 
+        if (policy_==spike_exchange_policy::point_to_point) {
+            return exchange_point_to_point(local_spikes);
+        }
+
         PE(communication_exchange_gather);
         // global all-to-all to gather a local copy of the global spike list on each node.
         auto global_spikes = distributed_->gather_spikes(local_spikes);
@@ -169,6 +310,113 @@ public:
         return global_spikes;
     }
 
+    /// Perform exchange of spikes in the packed format.
+    ///
+    /// Takes as input the list of local_spikes that were generated on the calling domain.
+    /// Returns the full global set of packed spikes, partitioned by domain.
+    gathered_vector<char> exchange_packed(std::vector<spike> local_spikes) {
+        PE(communication_exchange_sort);
+        // sort the spikes in ascending order of source gid
+        sort_by_source(local_spikes);
+        PL();
+
+        PE(communication_exchange_pack);
+        std::vector<char> local_packed;
+        local_packed.reserve(16+6*local_spikes.size());
+        pack_spikes(local_spikes, local_packed);
+        PL();
+
+        PE(communication_exchange_gather);
+        auto global_packed = distributed_->gather_packed_spikes(local_packed);
+        const auto& part = global_packed.partition();
+        const char* base = global_packed.values().data();
+        for (auto dom: util::make_span(num_domains_)) {
+            num_spikes_ += packed_spike_count(base+part[dom], base+part[dom+1]);
+        }
+        PL();
+
+        return global_packed;
+    }
+
+    /// Start an exchange of spikes, that is completed by finish_exchange().
+    ///
+    /// With the gather policy the gather is started without waiting for the
+    /// other domains, if the distributed context supports it, so that work
+    /// can be done while the spikes are in transit: with a non-blocking
+    /// collective, or with point to point messages (see set_pairwise_gather). With the point to point
+    /// policy the exchange is performed by finish_exchange().
+    spike_exchange start_exchange(std::vector<spike> local_spikes) {
+        spike_exchange ex;
+        if (policy_==spike_exchange_policy::point_to_point) {
+            ex.local_spikes_ = std::move(local_spikes);
+            return ex;
+        }
+
+        PE(communication_exchange_sort);
+        sort_by_source(local_spikes);
+        PL();
+
+        ex.started_ = true;
+        if (compression()) {
+            PE(communication_exchange_pack);
+            std::vector<char> local_packed;
+            local_packed.reserve(16+6*local_spikes.size());
+            pack_spikes(local_spikes, local_packed);
+            PL();
+
+            PE(communication_exchange_post);
+            ex.compressed_ = true;
+            ex.packed_ = distributed_->start_gather_packed_spikes(std::move(local_packed), pairwise_);
+            PL();
+        }
+        else {
+            PE(communication_exchange_post);
+            ex.gathered_ = distributed_->start_gather_spikes(std::move(local_spikes), pairwise_);
+            PL();
+        }
+        return ex;
+    }
+
+    /// Complete an exchange started by start_exchange(), and add the events
+    /// generated by the received spikes to queues, as make_event_queues().
+    ///
+    /// The events of the spikes of each domain are generated as soon as
+    /// they arrive. The time spent waiting for spikes is recorded in the
+    /// communication_exchange_wait profiler region, and the time spent
+    /// generating events in communication_walkspikes.
+    void finish_exchange(
+            spike_exchange& ex,
+            std::vector<pse_vector>& queues,
+            bool remote_only = false)
+    {
+        if (!ex.started_) {
+            ex.started_ = true;
+            PE(communication_exchange_sort);
+            sort_by_source(ex.local_spikes_);
+            PL();
+
+            ex.gathered_ = gather_request<spike>(exchange_point_to_point(ex.local_spikes_));
+            ex.local_spikes_.clear();
+        }
+
+        if (ex.compressed_) {
+            make_event_queues_incremental(ex.packed_, queues, remote_only,
+                [](const char* first, const char* last) { return packed_spike_count(first, last); },
+                [](const char* first, const char* last, std::vector<spike>& buffer) {
+                    buffer = unpack_spikes(first, last);
+                    return spike_range(buffer.data(), buffer.data()+buffer.size());
+                });
+        }
+        else {
+            // Spikes received by point to point exchange have already been
+            // counted.
+            const bool count = policy_==spike_exchange_policy::gather;
+            make_event_queues_incremental(ex.gathered_, queues, remote_only,
+                [count](const spike* first, const spike* last) { return count? last-first: 0; },
+                [](const spike* first, const spike* last, std::vector<spike>&) { return spike_range(first, last); });
+        }
+    }
+
     /// Check each global spike in turn to see it generates local events.
     /// If so, make the events and insert them into the appropriate event list.
     ///
@@ -176,70 +424,75 @@ public:
     /// for each local cell group. On completion, the events in each list are
     /// all events that must be delivered to targets in that cell group as a
     /// result of the global spike exchange, plus any events that were already
-    /// in the list.
+    /// in the list. Lists that are sorted on entry are sorted on completion.
+    ///
+    /// If remote_only is set, the spikes from this domain are skipped, for
+    /// when they have already been delivered by make_local_event_queues().
     void make_event_queues(
             const gathered_vector<spike>& global_spikes,
-            std::vector<pse_vector>& queues)
+            std::vector<pse_vector>& queues,
+            bool remote_only = false)
     {
-        arb_assert(queues.size()==num_local_cells_);
+        const auto& part = global_spikes.partition();
+        const spike* base = global_spikes.values().data();
+        std::vector<spike_range> ranges;
+        for (auto dom: util::make_span(num_domains_)) {
+            if (remote_only && int(dom)==distributed_->id()) continue;
+            ranges.push_back({base+part[dom], base+part[dom+1]});
+        }
+        make_event_queues_impl(ranges, queues);
+    }
 
-        using util::subrange_view;
-        using util::make_span;
-        using util::make_range;
+    /// As above, for spikes gathered by exchange_packed().
+    void make_event_queues(
+            const gathered_vector<char>& global_packed,
+            std::vector<pse_vector>& queues,
+            bool remote_only = false)
+    {
+        const auto& part = global_packed.partition();
+        const char* base = global_packed.values().data();
+        std::vector<std::vector<spike>> unpacked;
+        std::vector<spike_range> ranges;
+        unpacked.reserve(num_domains_);
+        for (auto dom: util::make_span(num_domains_)) {
+            if (remote_only && int(dom)==distributed_->id()) continue;
+            unpacked.push_back(unpack_spikes(base+part[dom], base+part[dom+1]));
+            const auto& v = unpacked.back();
+            ranges.push_back({v.data(), v.data()+v.size()});
+        }
+        make_event_queues_impl(ranges, queues);
+    }
 
-        const auto& sp = global_spikes.partition();
-        const auto& cp = connection_part_;
-        for (auto dom: make_span(num_domains_)) {
-            auto cons = subrange_view(connections_, cp[dom], cp[dom+1]);
-            auto spks = subrange_view(global_spikes.values(), sp[dom], sp[dom+1]);
-
-            struct spike_pred {
-                bool operator()(const spike& spk, const cell_member_type& src)
-                    {return spk.source<src;}
-                bool operator()(const cell_member_type& src, const spike& spk)
-                    {return src<spk.source;}
-            };
-
-            // We have a choice of whether to walk spikes or connections:
-            // i.e., we can iterate over the spikes, and for each spike search
-            // the for connections that have the same source; or alternatively
-            // for each connection, we can search the list of spikes for spikes
-            // with the same source.
-            //
-            // We iterate over whichever set is the smallest, which has
-            // complexity of order max(S log(C), C log(S)), where S is the
-            // number of spikes, and C is the number of connections.
-            if (cons.size()<spks.size()) {
-                auto sp = spks.begin();
-                auto cn = cons.begin();
-                while (cn!=cons.end() && sp!=spks.end()) {
-                    auto sources = std::equal_range(sp, spks.end(), cn->source(), spike_pred());
-                    for (auto s: make_range(sources)) {
-                        queues[cn->index_on_domain()].push_back(cn->make_event(s));
-                    }
+    /// Generate the events from spikes generated on this domain to cells on
+    /// this domain, without communication.
+    void make_local_event_queues(
+            const std::vector<spike>& local_spikes,
+            std::vector<pse_vector>& queues)
+    {
+        make_event_queues_impl({{local_spikes.data(), local_spikes.data()+local_spikes.size()}}, queues);
+    }
 
-                    sp = sources.first;
-                    ++cn;
-                }
-            }
-            else {
-                auto cn = cons.begin();
-                auto sp = spks.begin();
-                while (cn!=cons.end() && sp!=spks.end()) {
-                    auto targets = std::equal_range(cn, cons.end(), sp->source);
-                    for (auto c: make_range(targets)) {
-                        queues[c.index_on_domain()].push_back(c.make_event(*sp));
-                    }
+    /// Returns the total number of global spikes over the duration of the simulation.
+    /// Spikes exchanged with the point to point policy are counted only
+    /// once reduce_num_spikes() has been called.
+    std::uint64_t num_spikes() const { return num_spikes_; }
 
-                    cn = targets.first;
-                    ++sp;
-                }
-            }
+    /// Add the spikes exchanged with the point to point policy since the
+    /// last call to the global spike count. An exchange with that policy
+    /// only sees the spikes sent to this domain, so the count of local
+    /// spikes is summed over all domains here, once, rather than with
+    /// another collective in every exchange. A collective operation, if
+    /// the point to point policy has been selected: must be called on
+    /// all domains.
+    void reduce_num_spikes() {
+        if (!route_part_.empty()) {
+            num_spikes_ += distributed_->sum(num_unreduced_spikes_);
+            num_unreduced_spikes_ = 0;
         }
     }
 
-    /// Returns the total number of global spikes over the duration of the simulation
-    std::uint64_t num_spikes() const { return num_spikes_; }
+    /// Set the spike count, when a simulation is restored from a checkpoint.
+    void set_num_spikes(std::uint64_t n) { num_spikes_ = n; }
 
     cell_size_type num_local_cells() const {
         return num_local_cells_;
@@ -251,20 +504,350 @@ public:
 
     void reset() {
         num_spikes_ = 0;
+        num_unreduced_spikes_ = 0;
     }
 
 private:
+    // Spikes gathered from a thread_private_spike_store are already sorted,
+    // so the sort is skipped when it is not needed.
+    static void sort_by_source(std::vector<spike>& spikes) {
+        auto by_source = [](const spike& a, const spike& b) { return a.source<b.source; };
+        if (!std::is_sorted(spikes.begin(), spikes.end(), by_source)) {
+            std::sort(spikes.begin(), spikes.end(), by_source);
+        }
+    }
+
+    using spike_range = std::pair<const spike*, const spike*>;
+
+    // Generate events from the spikes in ranges.
+    void make_event_queues_impl(const std::vector<spike_range>& ranges, std::vector<pse_vector>& queues) {
+        arb_assert(queues.size()==num_local_cells_);
+
+        std::vector<std::size_t> old_size;
+        old_size.reserve(num_local_cells_);
+        for (const auto& q: queues) {
+            old_size.push_back(q.size());
+        }
+        append_events(ranges, queues, old_size.data());
+    }
+
+    // Generate events from the spikes of each domain of a gather request as
+    // they arrive. The domains that have arrived are walked together: with
+    // the gather of a collective, all domains but the local one arrive at
+    // once. The new events are sorted and merged into the queues once all
+    // domains have been received, rather than once per domain.
+    //
+    // count(first, last) gives the number of spikes in the values [first, last)
+    // of a domain, and decode(first, last, buffer) returns the range of
+    // spikes in the values, which may be decoded into buffer.
+    template <typename T, typename Count, typename Decode>
+    void make_event_queues_incremental(
+            gather_request<T>& request,
+            std::vector<pse_vector>& queues,
+            bool remote_only,
+            Count&& count,
+            Decode&& decode)
+    {
+        arb_assert(queues.size()==num_local_cells_);
+        const cell_size_type n_blocks = num_event_blocks();
+
+        std::vector<std::size_t> old_size;
+        old_size.reserve(num_local_cells_);
+        for (const auto& q: queues) {
+            old_size.push_back(q.size());
+        }
+
+        std::vector<std::vector<spike>> decoded(num_domains_);
+        std::vector<spike_range> ready;
+        for (;;) {
+            PE(communication_exchange_wait);
+            int dom = request.next();
+            PL();
+            if (dom<0) break;
+
+            ready.clear();
+            for (; dom>=0; dom = request.try_next()) {
+                const auto values = request.values(dom);
+                num_spikes_ += count(values.first, values.second);
+                if (!(remote_only && dom==distributed_->id())) {
+                    ready.push_back(decode(values.first, values.second, decoded[dom]));
+                }
+            }
+            if (!ready.empty()) {
+                append_events(ready, queues);
+            }
+        }
+
+        threading::parallel_for::apply(0, n_blocks, thread_pool_.get(),
+            [&](cell_size_type b) {
+                const auto block = event_block(b, n_blocks);
+                merge_new_events(queues, block, old_size.data()+block.first);
+            });
+    }
+
+    cell_size_type num_event_blocks() const {
+        return std::min<cell_size_type>(thread_pool_->get_num_threads(), num_local_cells_);
+    }
+
+    // The range of local cells in block b of n_blocks.
+    std::pair<cell_size_type, cell_size_type> event_block(cell_size_type b, cell_size_type n_blocks) const {
+        return {std::size_t(b)*num_local_cells_/n_blocks, std::size_t(b+1)*num_local_cells_/n_blocks};
+    }
+
+    // The block of n_blocks that holds local cell i: the largest b with
+    // event_block(b, n_blocks).first<=i.
+    cell_size_type event_block_of(cell_size_type i, cell_size_type n_blocks) const {
+        return (std::size_t(i+1)*n_blocks-1)/num_local_cells_;
+    }
+
+    // An event for local cell `cell`, staged before it is appended to the
+    // queue of the cell.
+    struct staged_event {
+        cell_size_type cell;
+        spike_event event;
+    };
+
+    // Append to the queues the events generated by the spikes in ranges.
+    //
+    // The events for a spike are generated by looking up the range of
+    // connections with its source, which is O(1), so the walk is linear in
+    // the number of spikes and events. It is done in two parallel passes:
+    //  1. The spikes are partitioned into contiguous chunks, one per task,
+    //     and each task stages the events of its spikes in its own buckets,
+    //     one for each block of target cells. Connections with the same
+    //     source are sorted by target cell, so the events of a spike go to
+    //     the buckets in order.
+    //  2. One task per block of target cells appends the events in the
+    //     buckets of that block to the queues of its cells, so that tasks
+    //     push to disjoint queues.
+    // Each spike is looked up once, by one task.
+    //
+    // If old_size is not null, each task of the second pass then sorts the
+    // new events of the cells in its block, while they are still in cache,
+    // and merges them with the old_size[i] events already in the queue of
+    // cell i, so that consumers of the queues do not have to sort them.
+    void append_events(
+            const std::vector<spike_range>& ranges,
+            std::vector<pse_vector>& queues,
+            const std::size_t* old_size = nullptr)
+    {
+        const cell_size_type n_blocks = num_event_blocks();
+        if (!n_blocks) return;
+
+        std::vector<std::size_t> range_start = {0};
+        for (const auto& r: ranges) {
+            range_start.push_back(range_start.back()+(r.second-r.first));
+        }
+        const std::size_t n_spikes = range_start.back();
+
+        const std::size_t min_chunk_size = 256;
+        const std::size_t n_chunks = std::max<std::size_t>(1,
+            std::min<std::size_t>(thread_pool_->get_num_threads(), (n_spikes+min_chunk_size-1)/min_chunk_size));
+
+        // Call f(spike, connection) for each connection from each of the
+        // spikes [first, last) of the concatenated ranges.
+        auto walk = [&](std::size_t first, std::size_t last, auto&& f) {
+            auto r = std::upper_bound(range_start.begin(), range_start.end(), first)-range_start.begin()-1;
+            for (auto i = first; i<last; ++r) {
+                const spike* spk = ranges[r].first+(i-range_start[r]);
+                const spike* end = ranges[r].first+(std::min(last, range_start[r+1])-range_start[r]);
+                i += end-spk;
+                for (; spk!=end; ++spk) {
+                    for (auto k: util::make_span(connection_index_.lookup(spk->source))) {
+                        f(*spk, connections_[k]);
+                    }
+                }
+            }
+        };
+
+        // With one chunk and one block, the events need not be staged.
+        if (n_chunks==1 && n_blocks==1) {
+            PE(communication_walkspikes);
+            walk(0, n_spikes, [&](const spike& spk, connection& con) {
+                queues[con.index_on_domain()].push_back(con.make_event(spk));
+            });
+            PL();
+            if (old_size) {
+                merge_new_events(queues, event_block(0, 1), old_size);
+            }
+            return;
+        }
+
+        event_buckets_.resize(n_chunks*n_blocks);
+        for (auto& bucket: event_buckets_) {
+            bucket.clear();
+        }
+
+        threading::parallel_for::apply(0, n_chunks, thread_pool_.get(),
+            [&](std::size_t c) {
+                PE(communication_walkspikes);
+                auto buckets = event_buckets_.data()+c*n_blocks;
+                walk(c*n_spikes/n_chunks, (c+1)*n_spikes/n_chunks,
+                    [&](const spike& spk, connection& con) {
+                        const auto cell = con.index_on_domain();
+                        buckets[event_block_of(cell, n_blocks)].push_back({cell, con.make_event(spk)});
+                    });
+                PL();
+            });
+
+        threading::parallel_for::apply(0, n_blocks, thread_pool_.get(),
+            [&](cell_size_type b) {
+                PE(communication_enqueue_append);
+                for (auto c: util::make_span(n_chunks)) {
+                    for (const auto& e: event_buckets_[c*n_blocks+b]) {
+                        queues[e.cell].push_back(e.event);
+                    }
+                }
+                PL();
+
+                if (old_size) {
+                    const auto block = event_block(b, n_blocks);
+                    merge_new_events(queues, block, old_size+block.first);
+                }
+            });
+    }
+
+    // Sort the events appended to the queue of each cell i in block since
+    // it had old_size[i-block.first] events, and merge them with the sorted
+    // events before them.
+    void merge_new_events(
+            std::vector<pse_vector>& queues,
+            std::pair<cell_size_type, cell_size_type> block,
+            const std::size_t* old_size)
+    {
+        PE(communication_enqueue_sort);
+        for (auto i: util::make_span(block)) {
+            auto& q = queues[i];
+            auto mid = q.begin()+old_size[i-block.first];
+            std::sort(mid, q.end());
+            std::inplace_merge(q.begin(), mid, q.end());
+        }
+        PL();
+    }
+
+    // Build the routing tables for point to point exchange.
+    //
+    // Each domain sends to every source domain the sorted list of source gids
+    // on that domain that have connections here. Inverting what is received
+    // gives, for each local source gid, the domains that need its spikes.
+    void make_routes() {
+        PE(communication_routes);
+        using count_type = gathered_vector<spike>::count_type;
+
+        // connections_ are partitioned by source domain and sorted by source,
+        // so the unique source gids of each partition are already in order.
+        const auto& cp = connection_part_;
+        std::vector<cell_gid_type> wanted;
+        std::vector<count_type> wanted_part = {0u};
+        for (auto dom: util::make_span(num_domains_)) {
+            for (const auto& c: util::subrange_view(connections_, cp[dom], cp[dom+1])) {
+                auto gid = c.source().gid;
+                if (wanted.size()==wanted_part.back() || wanted.back()!=gid) {
+                    wanted.push_back(gid);
+                }
+            }
+            wanted_part.push_back(wanted.size());
+        }
+
+        auto requests = distributed_->all_to_all_gids(wanted, wanted_part);
+
+        // Pair each requested local gid with the domain that wants it, and
+        // sort by gid; the sort is stable, so domains are in ascending order.
+        std::vector<std::pair<cell_gid_type, unsigned>> pairs;
+        pairs.reserve(requests.size());
+        const auto& rp = requests.partition();
+        for (auto dom: util::make_span(num_domains_)) {
+            for (auto i: util::make_span(rp[dom], rp[dom+1])) {
+                pairs.push_back({requests.values()[i], dom});
+            }
+        }
+        std::stable_sort(pairs.begin(), pairs.end(),
+            [](const auto& a, const auto& b) { return a.first<b.first; });
+
+        route_gids_.clear();
+        route_domains_.clear();
+        route_part_ = {0u};
+        for (const auto& p: pairs) {
+            if (route_gids_.empty() || route_gids_.back()!=p.first) {
+                route_gids_.push_back(p.first);
+                route_part_.push_back(route_part_.back());
+            }
+            route_domains_.push_back(p.second);
+            ++route_part_.back();
+        }
+        PL();
+    }
+
+    // Send each spike only to the domains with connections from its source.
+    // local_spikes must be sorted by source.
+    gathered_vector<spike> exchange_point_to_point(const std::vector<spike>& local_spikes) {
+        using count_type = gathered_vector<spike>::count_type;
+
+        PE(communication_exchange_route);
+        // Walk the sorted spikes and the sorted route table together, calling
+        // f(domain, spike) for every destination of every spike.
+        auto for_each_destination = [&](auto&& f) {
+            std::size_t r = 0;
+            for (const auto& spk: local_spikes) {
+                auto gid = spk.source.gid;
+                while (r<route_gids_.size() && route_gids_[r]<gid) ++r;
+                if (r==route_gids_.size()) break;
+                if (route_gids_[r]!=gid) continue;
+                for (auto i: util::make_span(route_part_[r], route_part_[r+1])) {
+                    f(route_domains_[i], spk);
+                }
+            }
+        };
+
+        std::vector<count_type> counts(num_domains_);
+        for_each_destination([&](unsigned dom, const spike&) { ++counts[dom]; });
+        auto send_part = algorithms::make_index(counts);
+
+        std::vector<spike> send(send_part.back());
+        auto offsets = send_part;
+        for_each_destination([&](unsigned dom, const spike& s) { send[offsets[dom]++] = s; });
+        PL();
+
+        PE(communication_exchange_alltoall);
+        auto spikes = distributed_->all_to_all_spikes(send, send_part);
+        num_unreduced_spikes_ += local_spikes.size();
+        PL();
+
+        return spikes;
+    }
+
     cell_size_type num_local_cells_;
     cell_size_type num_local_groups_;
     cell_size_type num_domains_;
     std::vector<connection> connections_;
     std::vector<cell_size_type> connection_part_;
+    connection_index connection_index_;
     std::vector<cell_size_type> index_divisions_;
     util::partition_view_type<std::vector<cell_size_type>> index_part_;
 
+    // Routing tables for point to point exchange: the domains that need the
+    // spikes from route_gids_[i] are route_domains_[route_part_[i]:route_part_[i+1]].
+    spike_exchange_policy policy_ = spike_exchange_policy::gather;
+    std::vector<cell_gid_type> route_gids_;
+    std::vector<cell_size_type> route_part_;
+    std::vector<unsigned> route_domains_;
+
+    // Exchange spikes in the packed format with the gather policy.
+    bool compress_ = false;
+
+    // Start gathers with point to point messages.
+    bool pairwise_ = false;
+
+    // Staged events of append_events, by chunk of spikes and block of
+    // target cells, kept to reuse their storage.
+    std::vector<std::vector<staged_event>> event_buckets_;
+
     distributed_context_handle distributed_;
     task_system_handle thread_pool_;
     std::uint64_t num_spikes_ = 0u;
+
+    // Local spikes exchanged point to point, not yet in num_spikes_.
+    std::uint64_t num_unreduced_spikes_ = 0u;
 };
 
 } // namespace arb
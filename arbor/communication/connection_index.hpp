@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include <arbor/assert.hpp>
+#include <arbor/common_types.hpp>
+
+#include "connection.hpp"
+
+namespace arb {
+
+// Maps the source of a connection to the range of connections with that
+// source, in a sequence of connections in which connections with the same
+// source are contiguous (e.g. sorted by source).
+//
+// A flat open addressing hash table with linear probing, with power of two
+// capacity that is kept at most half full, so that a lookup touches one or
+// two adjacent entries on average.
+
+class connection_index {
+public:
+    using range_type = std::pair<cell_size_type, cell_size_type>;
+
+    connection_index() = default;
+
+    template <typename Seq>
+    explicit connection_index(const Seq& connections) {
+        // Count the unique sources to size the table.
+        std::size_t n_sources = 0;
+        const connection* prev = nullptr;
+        for (const auto& c: connections) {
+            if (!prev || prev->source()!=c.source()) ++n_sources;
+            prev = &c;
+        }
+
+        shift_ = 64;
+        std::size_t capacity = 1;
+        while (capacity<2*n_sources) {
+            capacity *= 2;
+            --shift_;
+        }
+        table_.assign(capacity, entry{});
+        mask_ = capacity-1;
+
+        cell_size_type i = 0;
+        for (auto it = std::begin(connections); it!=std::end(connections); ) {
+            auto src = it->source();
+            cell_size_type first = i;
+            while (it!=std::end(connections) && it->source()==src) {
+                ++it;
+                ++i;
+            }
+            insert(src, first, i);
+        }
+    }
+
+    // Range of connections with source src; empty if there are none.
+    range_type lookup(cell_member_type src) const {
+        if (table_.empty()) return {0, 0};
+
+        for (auto h = hash(src); ; h = (h+1)&mask_) {
+            const auto& e = table_[h];
+            if (e.first==e.last) return {0, 0};
+            if (e.source==src) return {e.first, e.last};
+        }
+    }
+
+    // Number of unique sources.
+    std::size_t size() const {
+        return size_;
+    }
+
+private:
+    // An entry is empty if its range is empty.
+    struct entry {
+        cell_member_type source = {0, 0};
+        cell_size_type first = 0;
+        cell_size_type last = 0;
+    };
+
+    // Fibonacci hashing of the 64 bit key formed from gid and index.
+    std::size_t hash(cell_member_type src) const {
+        std::uint64_t k = (std::uint64_t(src.gid)<<32) | src.index;
+        return shift_==64? 0: std::size_t((k*0x9e3779b97f4a7c15ull)>>shift_);
+    }
+
+    void insert(cell_member_type src, cell_size_type first, cell_size_type last) {
+        auto h = hash(src);
+        while (table_[h].first!=table_[h].last) {
+            // Connections with the same source must be contiguous.
+            arb_assert(table_[h].source!=src);
+            h = (h+1)&mask_;
+        }
+        table_[h] = {src, first, last};
+        ++size_;
+    }
+
+    std::vector<entry> table_;
+    std::size_t mask_ = 0;
+    unsigned shift_ = 64;
+    std::size_t size_ = 0;
+};
+
+} // namespace arb
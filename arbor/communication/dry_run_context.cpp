@@ -4,6 +4,7 @@
 
 #include <arbor/spike.hpp>
 
+#include <communication/packed_spikes.hpp>
 #include <distributed_context.hpp>
 #include <threading/threading.hpp>
 
@@ -41,6 +42,91 @@ struct dry_run_context_impl {
         return gathered_vector<arb::spike>(std::move(gathered_spikes), std::move(partition));
     }
 
+    gathered_vector<char>
+    gather_packed_spikes(const std::vector<char>& local_packed) const {
+        using count_type = typename gathered_vector<char>::count_type;
+
+        std::vector<char> gathered;
+        std::vector<count_type> partition = {0u};
+        const char* first = local_packed.data();
+        const char* last = first + local_packed.size();
+
+        for (count_type i = 0; i < num_ranks_; i++) {
+            shift_packed_spikes(first, last, num_cells_per_tile_*i, gathered);
+            partition.push_back(gathered.size());
+        }
+
+        return gathered_vector<char>(std::move(gathered), std::move(partition));
+    }
+
+    gathered_vector<cell_gid_type>
+    gather_gids(const std::vector<cell_gid_type>& local_gids) const {
+        using count_type = typename gathered_vector<cell_gid_type>::count_type;
+
+        std::vector<cell_gid_type> gathered;
+        gathered.reserve(local_gids.size()*num_ranks_);
+        std::vector<count_type> partition = {0u};
+
+        for (count_type i = 0; i < num_ranks_; i++) {
+            for (auto gid: local_gids) {
+                gathered.push_back(shift_gid(gid, i));
+            }
+            partition.push_back(gathered.size());
+        }
+
+        return gathered_vector<cell_gid_type>(std::move(gathered), std::move(partition));
+    }
+
+    gather_request<arb::spike>
+    start_gather_spikes(std::vector<arb::spike> local_spikes, bool) const {
+        return gather_request<arb::spike>(gather_spikes(local_spikes));
+    }
+
+    gather_request<char>
+    start_gather_packed_spikes(std::vector<char> local_packed, bool) const {
+        return gather_request<char>(gather_packed_spikes(local_packed));
+    }
+
+    // Every rank is a copy of rank 0 shifted by a whole number of tiles, so
+    // the part that rank j sends to rank 0 is the part that rank 0 sends to
+    // rank -j, shifted by j tiles.
+    template <typename T, typename Shift>
+    gathered_vector<T>
+    all_to_all(const std::vector<T>& values, const std::vector<unsigned>& partition, Shift shift) const {
+        using count_type = typename gathered_vector<T>::count_type;
+        arb_assert(partition.size()==num_ranks_+1);
+
+        std::vector<T> received;
+        received.reserve(values.size());
+        std::vector<count_type> recv_partition = {0u};
+
+        for (count_type j = 0; j < num_ranks_; j++) {
+            auto from = (num_ranks_-j)%num_ranks_;
+            for (auto k = partition[from]; k < partition[from+1]; k++) {
+                received.push_back(shift(values[k], j));
+            }
+            recv_partition.push_back(received.size());
+        }
+
+        return gathered_vector<T>(std::move(received), std::move(recv_partition));
+    }
+
+    cell_gid_type shift_gid(cell_gid_type gid, unsigned tiles) const {
+        return (gid + tiles*num_cells_per_tile_) % (num_ranks_*num_cells_per_tile_);
+    }
+
+    gathered_vector<arb::spike>
+    all_to_all_spikes(const std::vector<arb::spike>& values, const std::vector<unsigned>& partition) const {
+        return all_to_all(values, partition,
+            [this](arb::spike s, unsigned tiles) { s.source.gid = shift_gid(s.source.gid, tiles); return s; });
+    }
+
+    gathered_vector<cell_gid_type>
+    all_to_all_gids(const std::vector<cell_gid_type>& values, const std::vector<unsigned>& partition) const {
+        return all_to_all(values, partition,
+            [this](cell_gid_type gid, unsigned tiles) { return shift_gid(gid, tiles); });
+    }
+
     int id() const { return 0; }
 
     int size() const { return num_ranks_; }
@@ -59,6 +145,16 @@ struct dry_run_context_impl {
         return std::vector<T>(num_ranks_, value);
     }
 
+    template <typename T>
+    std::vector<T> all_gather(const std::vector<T>& values) const {
+        std::vector<T> gathered;
+        gathered.reserve(values.size()*num_ranks_);
+        for (unsigned i = 0; i < num_ranks_; i++) {
+            gathered.insert(gathered.end(), values.begin(), values.end());
+        }
+        return gathered;
+    }
+
     void barrier() const {}
 
     std::string name() const { return "dryrun"; }
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <arbor/assert.hpp>
+#include <arbor/util/optional.hpp>
+
+#include "communication/gathered_vector.hpp"
+
+namespace arb {
+
+// A gather of values from all domains, that may still be in progress.
+//
+// The values of each domain can be used as soon as they arrive: next() waits
+// for the values of one more domain and returns the index of that domain, in
+// the order that the values arrive, which need not be domain order. Once the
+// values of every domain have been returned, next() returns -1. try_next()
+// returns the next domain only if it has already arrived, so that the domains
+// that are ready can be handled together.
+//
+// A request is either complete on construction, for distributed contexts that
+// gather values in one blocking step, or is constructed from a receiver that
+// waits for the values of each domain in turn. The receiver is destroyed with
+// the request, and must wait in its destructor for any sends it has posted,
+// so that the request can be kept alive until the next one has been started
+// to avoid waiting for the other domains to receive the local values.
+//
+// Requests must be completed in the order they are started on every domain,
+// and a request must be completed before the one after next is started.
+template <typename T>
+class gather_request {
+public:
+    using count_type = typename gathered_vector<T>::count_type;
+
+    struct receiver {
+        // Wait for the values of a domain whose values have not yet been
+        // received, store them in values and return the domain.
+        virtual int receive(std::vector<T>& values) = 0;
+
+        // Whether receive() would return without waiting, if that can be
+        // told without waiting.
+        virtual bool ready() { return false; }
+
+        virtual ~receiver() {}
+    };
+
+    // A complete request with no domains.
+    gather_request():
+        gather_request(gathered_vector<T>({}, {0u}))
+    {}
+
+    // A complete request with the values gathered from each domain.
+    explicit gather_request(gathered_vector<T> gathered):
+        num_domains_(gathered.partition().size()-1),
+        gathered_(std::move(gathered))
+    {}
+
+    // A request in progress for the values of num_domains domains.
+    gather_request(unsigned num_domains, std::unique_ptr<receiver> r):
+        num_domains_(num_domains),
+        receiver_(std::move(r)),
+        chunks_(num_domains)
+    {}
+
+    gather_request(gather_request&&) = default;
+    gather_request& operator=(gather_request&&) = default;
+
+    unsigned size() const {
+        return num_domains_;
+    }
+
+    // Wait for the values of one more domain and return the domain, or -1
+    // if the values of all domains have been returned.
+    int next() {
+        if (num_returned_==num_domains_) return -1;
+
+        if (gathered_) {
+            return num_returned_++;
+        }
+        std::vector<T> values;
+        int dom = receiver_->receive(values);
+        arb_assert(dom>=0 && unsigned(dom)<num_domains_);
+        chunks_[dom] = std::move(values);
+        ++num_returned_;
+        return dom;
+    }
+
+    // As next(), if the values of one more domain can be returned without
+    // waiting, or else return -1.
+    int try_next() {
+        if (num_returned_==num_domains_) return -1;
+        if (!gathered_ && !receiver_->ready()) return -1;
+        return next();
+    }
+
+    // The values of domain dom, which must have been returned by next().
+    std::pair<const T*, const T*> values(int dom) const {
+        if (gathered_) {
+            const auto& p = gathered_->partition();
+            const T* base = gathered_->values().data();
+            return {base+p[dom], base+p[dom+1]};
+        }
+        const auto& v = chunks_[dom];
+        return {v.data(), v.data()+v.size()};
+    }
+
+    // Wait for the values of all domains, and return them partitioned by
+    // domain.
+    const gathered_vector<T>& finish() {
+        while (next()>=0) {}
+
+        if (!gathered_) {
+            std::vector<T> values;
+            std::vector<count_type> partition = {0u};
+            for (const auto& v: chunks_) {
+                values.insert(values.end(), v.begin(), v.end());
+                partition.push_back(values.size());
+            }
+            chunks_.clear();
+            gathered_ = gathered_vector<T>(std::move(values), std::move(partition));
+        }
+        return *gathered_;
+    }
+
+private:
+    unsigned num_domains_;
+    unsigned num_returned_ = 0;
+    std::unique_ptr<receiver> receiver_;
+    std::vector<std::vector<T>> chunks_;
+    util::optional<gathered_vector<T>> gathered_;
+};
+
+} // namespace arb
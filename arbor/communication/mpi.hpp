@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <iostream>
+#include <memory>
 #include <type_traits>
 #include <vector>
 
@@ -11,6 +12,7 @@
 #include <arbor/communication/mpi_error.hpp>
 
 #include "algorithms.hpp"
+#include "communication/gather_request.hpp"
 #include "communication/gathered_vector.hpp"
 #include "profile/profiler_macro.hpp"
 
@@ -177,6 +179,253 @@ gathered_vector<T> gather_all_with_partition(const std::vector<T>& values, MPI_C
     );
 }
 
+// Receives the values of every rank for one non-blocking gather with
+// MPI_Iallgatherv.
+//
+// The gather of the counts is started with MPI_Iallgather on construction,
+// without waiting for the other ranks. The gather of the values is posted
+// once the counts have arrived: when the local values are returned, if the
+// counts have arrived by then, or else when the values of the other ranks
+// are first asked for. The local values are returned first, without
+// waiting, and the values of the other ranks in rank order once the gather
+// of the values is complete: they all arrive together.
+template <typename T>
+class allgather_receiver: public gather_request<T>::receiver {
+public:
+    allgather_receiver(std::vector<T> values, MPI_Comm comm):
+        local_(std::move(values)), comm_(comm), rank_(rank(comm)),
+        local_count_(local_.size()*mpi_traits<T>::count()),
+        counts_(size(comm))
+    {
+        MPI_OR_THROW(MPI_Iallgather,
+            &local_count_, 1, MPI_INT,
+            counts_.data(), 1, MPI_INT,
+            comm_, &count_request_);
+    }
+
+    int receive(std::vector<T>& values) override {
+        using traits = mpi_traits<T>;
+
+        // The local values need no communication.
+        if (!local_received_) {
+            local_received_ = true;
+            int counted = 0;
+            MPI_OR_THROW(MPI_Test, &count_request_, &counted, MPI_STATUS_IGNORE);
+            if (counted) post();
+            values = local_;
+            return rank_;
+        }
+
+        if (!posted_) {
+            MPI_OR_THROW(MPI_Wait, &count_request_, MPI_STATUS_IGNORE);
+            post();
+        }
+        if (request_!=MPI_REQUEST_NULL) {
+            MPI_OR_THROW(MPI_Wait, &request_, MPI_STATUS_IGNORE);
+        }
+
+        if (next_==rank_) ++next_;
+        auto first = buffer_.begin()+displs_[next_]/traits::count();
+        auto last = buffer_.begin()+displs_[next_+1]/traits::count();
+        values.assign(first, last);
+        return next_++;
+    }
+
+    bool ready() override {
+        if (!local_received_) return true;
+        if (!posted_) {
+            int counted = 0;
+            MPI_OR_THROW(MPI_Test, &count_request_, &counted, MPI_STATUS_IGNORE);
+            if (!counted) return false;
+            post();
+        }
+        int done = 0;
+        MPI_OR_THROW(MPI_Test, &request_, &done, MPI_STATUS_IGNORE);
+        return done;
+    }
+
+    ~allgather_receiver() {
+        // The gather of the values is collective, so it is posted even if
+        // the values are not used.
+        if (!posted_) {
+            MPI_Wait(&count_request_, MPI_STATUS_IGNORE);
+            post();
+        }
+        if (request_!=MPI_REQUEST_NULL) {
+            MPI_Wait(&request_, MPI_STATUS_IGNORE);
+        }
+    }
+
+private:
+    std::vector<T> local_;
+    MPI_Comm comm_;
+    int rank_;
+    int local_count_;
+    bool local_received_ = false;
+    bool posted_ = false;
+    int next_ = 0;
+    std::vector<int> counts_;
+    std::vector<int> displs_;
+    std::vector<T> buffer_;
+    MPI_Request count_request_ = MPI_REQUEST_NULL;
+    MPI_Request request_ = MPI_REQUEST_NULL;
+
+    // Post the gather of the values, once the counts have arrived.
+    void post() {
+        using traits = mpi_traits<T>;
+
+        posted_ = true;
+        displs_ = algorithms::make_index(counts_);
+        buffer_.resize(displs_.back()/traits::count());
+
+        // const_cast required for MPI implementations that don't use const* in their interfaces
+        MPI_OR_THROW(MPI_Iallgatherv,
+            const_cast<T*>(local_.data()), local_count_, traits::mpi_type(),
+            buffer_.data(), counts_.data(), displs_.data(), traits::mpi_type(),
+            comm_, &request_);
+    }
+};
+
+/// Start a non-blocking gather of a distributed vector with MPI_Iallgatherv.
+/// Returns without waiting for the other ranks: see allgather_receiver.
+template <typename T>
+gather_request<T> start_gather_all_with_partition(std::vector<T> values, MPI_Comm comm) {
+    return gather_request<T>(size(comm),
+        std::unique_ptr<allgather_receiver<T>>(new allgather_receiver<T>(std::move(values), comm)));
+}
+
+// Message tags used by start_pairwise_gather_all_with_partition: consecutive
+// gathers alternate between gather_tag and gather_tag+1.
+constexpr int gather_tag = 3217;
+
+// Receives the values sent by every other rank for one non-blocking gather
+// with point to point messages.
+//
+// The local values are sent to every other rank on construction, and the
+// values of the other ranks are received in the order that they arrive, so
+// that they can be used while those of slower ranks are still in transit.
+// Each rank sends and receives P-1 messages, so this is only suited to small
+// numbers of ranks P.
+template <typename T>
+class pairwise_gather_receiver: public gather_request<T>::receiver {
+public:
+    pairwise_gather_receiver(std::vector<T> values, int tag, MPI_Comm comm):
+        local_(std::move(values)), tag_(tag), comm_(comm), rank_(rank(comm))
+    {
+        using traits = mpi_traits<T>;
+        const int n = size(comm_);
+        const int count = local_.size()*traits::count();
+
+        sends_.resize(n-1);
+        for (int i=1; i<n; ++i) {
+            // const_cast required for MPI implementations that don't use const* in their interfaces
+            MPI_OR_THROW(MPI_Isend,
+                const_cast<T*>(local_.data()), count, traits::mpi_type(),
+                (rank_+i)%n, tag_, comm_, &sends_[i-1]);
+        }
+    }
+
+    int receive(std::vector<T>& values) override {
+        using traits = mpi_traits<T>;
+
+        // The local values need no communication.
+        if (!local_received_) {
+            local_received_ = true;
+            values = local_;
+            return rank_;
+        }
+
+        MPI_Status status;
+        MPI_OR_THROW(MPI_Probe, MPI_ANY_SOURCE, tag_, comm_, &status);
+        int count;
+        MPI_OR_THROW(MPI_Get_count, &status, traits::mpi_type(), &count);
+
+        values.resize(count/traits::count());
+        MPI_OR_THROW(MPI_Recv,
+            values.data(), count, traits::mpi_type(),
+            status.MPI_SOURCE, tag_, comm_, MPI_STATUS_IGNORE);
+        return status.MPI_SOURCE;
+    }
+
+    bool ready() override {
+        if (!local_received_) return true;
+        int arrived = 0;
+        MPI_OR_THROW(MPI_Iprobe, MPI_ANY_SOURCE, tag_, comm_, &arrived, MPI_STATUS_IGNORE);
+        return arrived;
+    }
+
+    ~pairwise_gather_receiver() {
+        MPI_Waitall(sends_.size(), sends_.data(), MPI_STATUSES_IGNORE);
+    }
+
+private:
+    std::vector<T> local_;
+    int tag_;
+    MPI_Comm comm_;
+    int rank_;
+    bool local_received_ = false;
+    std::vector<MPI_Request> sends_;
+};
+
+/// Start a non-blocking gather of a distributed vector, with point to point
+/// messages between every pair of ranks. Gathers with the same tag must not
+/// overlap: see gather_tag.
+template <typename T>
+gather_request<T> start_pairwise_gather_all_with_partition(std::vector<T> values, int tag, MPI_Comm comm) {
+    return gather_request<T>(size(comm),
+        std::unique_ptr<pairwise_gather_receiver<T>>(new pairwise_gather_receiver<T>(std::move(values), tag, comm)));
+}
+
+/// Personalised all-to-all exchange of a partitioned vector.
+/// Partition i of values is sent to rank i, and the result is partitioned
+/// by the rank that sent each part.
+template <typename T>
+gathered_vector<T> all_to_all_with_partition(
+        const std::vector<T>& values,
+        const std::vector<typename gathered_vector<T>::count_type>& partition,
+        MPI_Comm comm)
+{
+    using gathered_type = gathered_vector<T>;
+    using count_type = typename gathered_vector<T>::count_type;
+    using traits = mpi_traits<T>;
+
+    const auto n = size(comm);
+    arb_assert(partition.size()==std::size_t(n+1));
+
+    // As for gather_all_with_partition, the count and displacement vectors
+    // are int because that is what MPI_Alltoallv expects.
+    std::vector<int> send_counts(n);
+    std::vector<int> send_displs(n);
+    for (int i=0; i<n; ++i) {
+        send_counts[i] = (partition[i+1]-partition[i])*traits::count();
+        send_displs[i] = partition[i]*traits::count();
+    }
+
+    std::vector<int> recv_counts(n);
+    MPI_OR_THROW(MPI_Alltoall,
+            send_counts.data(), 1, MPI_INT,
+            recv_counts.data(), 1, MPI_INT,
+            comm);
+    auto recv_displs = algorithms::make_index(recv_counts);
+
+    std::vector<T> buffer(recv_displs.back()/traits::count());
+
+    MPI_OR_THROW(MPI_Alltoallv,
+            // const_cast required for MPI implementations that don't use const* in their interfaces
+            const_cast<T*>(values.data()), send_counts.data(), send_displs.data(), traits::mpi_type(), // send buffer
+            buffer.data(), recv_counts.data(), recv_displs.data(), traits::mpi_type(), // receive buffer
+            comm);
+
+    for (auto& d : recv_displs) {
+        d /= traits::count();
+    }
+
+    return gathered_type(
+        std::move(buffer),
+        std::vector<count_type>(recv_displs.begin(), recv_displs.end())
+    );
+}
+
 template <typename T>
 T reduce(T value, MPI_Op op, int root, MPI_Comm comm) {
     using traits = mpi_traits<T>;
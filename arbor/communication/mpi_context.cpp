@@ -23,6 +23,15 @@ struct mpi_context_impl {
     int rank_;
     MPI_Comm comm_;
 
+    // Consecutive pairwise non-blocking gathers use alternate tags, so that
+    // the messages of a domain that has started the next gather can not be
+    // taken for those of the current one.
+    mutable unsigned num_requests_ = 0;
+
+    int next_tag() const {
+        return mpi::gather_tag + (num_requests_++)%2;
+    }
+
     explicit mpi_context_impl(MPI_Comm comm): comm_(comm) {
         size_ = mpi::size(comm_);
         rank_ = mpi::rank(comm_);
@@ -33,6 +42,43 @@ struct mpi_context_impl {
         return mpi::gather_all_with_partition(local_spikes, comm_);
     }
 
+    gathered_vector<char>
+    gather_packed_spikes(const std::vector<char>& local_packed) const {
+        return mpi::gather_all_with_partition(local_packed, comm_);
+    }
+
+    gathered_vector<cell_gid_type>
+    gather_gids(const std::vector<cell_gid_type>& local_gids) const {
+        return mpi::gather_all_with_partition(local_gids, comm_);
+    }
+
+    template <typename T>
+    gather_request<T> start_gather(std::vector<T> values, bool pairwise) const {
+        return pairwise?
+            mpi::start_pairwise_gather_all_with_partition(std::move(values), next_tag(), comm_):
+            mpi::start_gather_all_with_partition(std::move(values), comm_);
+    }
+
+    gather_request<arb::spike>
+    start_gather_spikes(std::vector<arb::spike> local_spikes, bool pairwise) const {
+        return start_gather(std::move(local_spikes), pairwise);
+    }
+
+    gather_request<char>
+    start_gather_packed_spikes(std::vector<char> local_packed, bool pairwise) const {
+        return start_gather(std::move(local_packed), pairwise);
+    }
+
+    gathered_vector<arb::spike>
+    all_to_all_spikes(const std::vector<arb::spike>& values, const std::vector<unsigned>& partition) const {
+        return mpi::all_to_all_with_partition(values, partition, comm_);
+    }
+
+    gathered_vector<cell_gid_type>
+    all_to_all_gids(const std::vector<cell_gid_type>& values, const std::vector<unsigned>& partition) const {
+        return mpi::all_to_all_with_partition(values, partition, comm_);
+    }
+
     std::string name() const { return "MPI"; }
     int id() const { return rank_; }
     int size() const { return size_; }
@@ -57,6 +103,11 @@ struct mpi_context_impl {
         return mpi::gather(value, root, comm_);
     }
 
+    template <typename T>
+    std::vector<T> all_gather(const std::vector<T>& values) const {
+        return mpi::gather_all(values, comm_);
+    }
+
     void barrier() const {
         mpi::barrier(comm_);
     }
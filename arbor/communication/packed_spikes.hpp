@@ -0,0 +1,159 @@
+#pragma once
+
+// Compact wire format for spikes exchanged between domains.
+//
+// A packed sequence of spikes, which must be sorted by source, is a header
+// followed by one record per spike:
+//
+//   header: varint count, varint base gid
+//   record: varint token, [varint index], time_type time
+//
+// where token = (gid - previous gid)<<1 | (index!=0), the previous gid of
+// the first record is the base gid, and the index is present only when it
+// is non-zero. Varints are unsigned LEB128.
+//
+// Spikes are typically packed into 5 or 6 bytes, against 12 bytes for
+// arb::spike. Spike times are stored unchanged.
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <arbor/assert.hpp>
+#include <arbor/common_types.hpp>
+#include <arbor/spike.hpp>
+
+#include "communication/gathered_vector.hpp"
+
+namespace arb {
+
+namespace impl {
+    inline void put_varint(std::uint64_t v, std::vector<char>& buf) {
+        while (v>=0x80) {
+            buf.push_back(char(v|0x80));
+            v >>= 7;
+        }
+        buf.push_back(char(v));
+    }
+
+    inline std::uint64_t get_varint(const char*& p) {
+        std::uint64_t v = 0;
+        unsigned shift = 0;
+        unsigned char c;
+        do {
+            c = static_cast<unsigned char>(*p++);
+            v |= std::uint64_t(c&0x7f)<<shift;
+            shift += 7;
+        } while (c&0x80);
+        return v;
+    }
+
+    template <typename T>
+    void put_raw(T v, std::vector<char>& buf) {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &v, sizeof(T));
+        buf.insert(buf.end(), bytes, bytes+sizeof(T));
+    }
+
+    template <typename T>
+    T get_raw(const char*& p) {
+        T v;
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return v;
+    }
+
+    struct packed_spike_header {
+        std::size_t count = 0;
+        cell_gid_type base = 0;
+    };
+
+    inline void put_header(const packed_spike_header& h, std::vector<char>& buf) {
+        put_varint(h.count, buf);
+        put_varint(h.base, buf);
+    }
+
+    inline packed_spike_header get_header(const char*& p) {
+        packed_spike_header h;
+        h.count = get_varint(p);
+        h.base = get_varint(p);
+        return h;
+    }
+} // namespace impl
+
+// Append the packed representation of spikes, which must be sorted by
+// source, to buf.
+inline void pack_spikes(const std::vector<spike>& spikes, std::vector<char>& buf) {
+    impl::packed_spike_header h;
+    h.count = spikes.size();
+    if (!spikes.empty()) {
+        h.base = spikes.front().source.gid;
+    }
+    impl::put_header(h, buf);
+
+    auto prev = h.base;
+    for (const auto& s: spikes) {
+        arb_assert(s.source.gid>=prev);
+        std::uint64_t token = std::uint64_t(s.source.gid-prev)<<1 | (s.source.index!=0);
+        impl::put_varint(token, buf);
+        if (s.source.index) {
+            impl::put_varint(s.source.index, buf);
+        }
+        impl::put_raw<time_type>(s.time, buf);
+        prev = s.source.gid;
+    }
+}
+
+// Number of spikes in the packed sequence in [first, last).
+inline std::size_t packed_spike_count(const char* first, const char* last) {
+    return first==last? 0: impl::get_header(first).count;
+}
+
+// Call f(spike) for each spike in the packed sequence in [first, last).
+template <typename F>
+void unpack_spikes(const char* first, const char* last, F&& f) {
+    if (first==last) return;
+
+    auto h = impl::get_header(first);
+    auto gid = h.base;
+    for (std::size_t i = 0; i<h.count; ++i) {
+        auto token = impl::get_varint(first);
+        gid += cell_gid_type(token>>1);
+        cell_lid_type index = (token&1)? cell_lid_type(impl::get_varint(first)): 0;
+        time_type t = impl::get_raw<time_type>(first);
+        f(spike({gid, index}, t));
+    }
+    arb_assert(first==last);
+}
+
+inline std::vector<spike> unpack_spikes(const char* first, const char* last) {
+    std::vector<spike> spikes;
+    spikes.reserve(packed_spike_count(first, last));
+    unpack_spikes(first, last, [&spikes](const spike& s) { spikes.push_back(s); });
+    return spikes;
+}
+
+// Unpack the spikes of every partition of a gathered vector of packed
+// spikes, in partition order.
+inline std::vector<spike> unpack_spikes(const gathered_vector<char>& packed) {
+    std::vector<spike> spikes;
+    const auto& part = packed.partition();
+    const char* base = packed.values().data();
+    for (std::size_t i = 0; i+1<part.size(); ++i) {
+        unpack_spikes(base+part[i], base+part[i+1], [&spikes](const spike& s) { spikes.push_back(s); });
+    }
+    return spikes;
+}
+
+// Append to buf a copy of the packed sequence in [first, last) with the
+// source gid of every spike increased by offset. Only the header changes.
+inline void shift_packed_spikes(const char* first, const char* last, cell_gid_type offset, std::vector<char>& buf) {
+    if (first==last) return;
+
+    auto h = impl::get_header(first);
+    h.base += offset;
+    impl::put_header(h, buf);
+    buf.insert(buf.end(), first, last);
+}
+
+} // namespace arb
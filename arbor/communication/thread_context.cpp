@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/context.hpp>
+#include <arbor/spike.hpp>
+
+#include "distributed_context.hpp"
+#include "util/strprintf.hpp"
+
+namespace arb {
+
+// State shared by the ranks of an in-process distributed context.
+//
+// Collective operations are implemented by each rank publishing a pointer to
+// its contribution, waiting on a barrier, reading the contributions of the
+// other ranks directly from their memory, then waiting on a second barrier
+// before the contributions can go out of scope.
+struct thread_ranks_state {
+    explicit thread_ranks_state(unsigned n):
+        num_ranks(n), slots(n, nullptr)
+    {}
+
+    void barrier() {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto gen = generation;
+        if (++waiting==num_ranks) {
+            waiting = 0;
+            ++generation;
+            cv.notify_all();
+        }
+        else {
+            cv.wait(lock, [&] { return gen!=generation; });
+        }
+    }
+
+    const unsigned num_ranks;
+    std::vector<const void*> slots;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    unsigned waiting = 0;
+    unsigned long generation = 0;
+};
+
+thread_ranks make_thread_ranks(unsigned num_ranks) {
+    if (!num_ranks) {
+        throw arbor_exception("thread ranks: number of ranks must be positive");
+    }
+    return std::make_shared<thread_ranks_state>(num_ranks);
+}
+
+struct thread_context_impl {
+    using count_type = gathered_vector<arb::spike>::count_type;
+
+    thread_context_impl(thread_ranks ranks, unsigned rank):
+        ranks_(std::move(ranks)), rank_(rank)
+    {}
+
+    // Publish value, and return f(values) where values[i] is the value
+    // published by rank i.
+    template <typename T, typename F>
+    auto collective(const T& value, F&& f) const {
+        auto& s = *ranks_;
+        s.slots[rank_] = &value;
+        s.barrier();
+
+        std::vector<const T*> values;
+        values.reserve(s.num_ranks);
+        for (auto p: s.slots) {
+            values.push_back(static_cast<const T*>(p));
+        }
+        auto result = f(values);
+
+        s.barrier();
+        return result;
+    }
+
+    template <typename T>
+    gathered_vector<T> gather_all(const std::vector<T>& local) const {
+        return collective(local,
+            [](const std::vector<const std::vector<T>*>& all) {
+                std::vector<T> values;
+                std::vector<count_type> partition = {0u};
+                for (auto v: all) {
+                    values.insert(values.end(), v->begin(), v->end());
+                    partition.push_back(values.size());
+                }
+                return gathered_vector<T>(std::move(values), std::move(partition));
+            });
+    }
+
+    template <typename T>
+    gathered_vector<T> all_to_all(const std::vector<T>& local, const std::vector<count_type>& partition) const {
+        struct send {
+            const std::vector<T>& values;
+            const std::vector<count_type>& partition;
+        };
+        return collective(send{local, partition},
+            [this](const std::vector<const send*>& all) {
+                std::vector<T> values;
+                std::vector<count_type> recv_partition = {0u};
+                for (auto s: all) {
+                    arb_assert(s->partition.size()==size()+1u);
+                    auto b = s->values.begin();
+                    values.insert(values.end(), b+s->partition[rank_], b+s->partition[rank_+1]);
+                    recv_partition.push_back(values.size());
+                }
+                return gathered_vector<T>(std::move(values), std::move(recv_partition));
+            });
+    }
+
+    gathered_vector<arb::spike>
+    gather_spikes(const std::vector<arb::spike>& local_spikes) const {
+        return gather_all(local_spikes);
+    }
+
+    gathered_vector<char>
+    gather_packed_spikes(const std::vector<char>& local_packed) const {
+        return gather_all(local_packed);
+    }
+
+    gathered_vector<cell_gid_type>
+    gather_gids(const std::vector<cell_gid_type>& local_gids) const {
+        return gather_all(local_gids);
+    }
+
+    // Ranks in threads have no progress of their own, so these gather the
+    // spikes before returning.
+    gather_request<arb::spike>
+    start_gather_spikes(std::vector<arb::spike> local_spikes, bool) const {
+        return gather_request<arb::spike>(gather_all(local_spikes));
+    }
+
+    gather_request<char>
+    start_gather_packed_spikes(std::vector<char> local_packed, bool) const {
+        return gather_request<char>(gather_all(local_packed));
+    }
+
+    gathered_vector<arb::spike>
+    all_to_all_spikes(const std::vector<arb::spike>& values, const std::vector<unsigned>& partition) const {
+        return all_to_all(values, partition);
+    }
+
+    gathered_vector<cell_gid_type>
+    all_to_all_gids(const std::vector<cell_gid_type>& values, const std::vector<unsigned>& partition) const {
+        return all_to_all(values, partition);
+    }
+
+    int id() const { return rank_; }
+
+    int size() const { return ranks_->num_ranks; }
+
+    template <typename T, typename Op>
+    T reduce(T value, Op op) const {
+        return collective(value,
+            [op](const std::vector<const T*>& all) {
+                T result = *all.front();
+                for (auto p: all) result = op(result, *p);
+                return result;
+            });
+    }
+
+    template <typename T>
+    T min(T value) const {
+        return reduce(value, [](T a, T b) { return std::min(a, b); });
+    }
+
+    template <typename T>
+    T max(T value) const {
+        return reduce(value, [](T a, T b) { return std::max(a, b); });
+    }
+
+    template <typename T>
+    T sum(T value) const {
+        // Sum in rank order, so that every rank gets the same result.
+        return collective(value,
+            [](const std::vector<const T*>& all) {
+                T result = T();
+                for (auto p: all) result += *p;
+                return result;
+            });
+    }
+
+    // As with MPI, the gathered values are returned on the root rank only.
+    template <typename T>
+    std::vector<T> gather(T value, int root) const {
+        return collective(value,
+            [this, root](const std::vector<const T*>& all) {
+                std::vector<T> values;
+                if (rank_==unsigned(root)) {
+                    for (auto p: all) values.push_back(*p);
+                }
+                return values;
+            });
+    }
+
+    template <typename T>
+    std::vector<T> all_gather(const std::vector<T>& values) const {
+        return gather_all(values).values();
+    }
+
+    void barrier() const {
+        ranks_->barrier();
+    }
+
+    std::string name() const { return "threads"; }
+
+    thread_ranks ranks_;
+    unsigned rank_;
+};
+
+distributed_context_handle make_thread_context(thread_ranks ranks, unsigned rank) {
+    if (!ranks) {
+        throw arbor_exception("thread ranks: no shared state");
+    }
+    if (rank>=ranks->num_ranks) {
+        throw arbor_exception(util::pprintf("thread ranks: rank {} out of range for {} ranks", rank, ranks->num_ranks));
+    }
+    return std::make_shared<distributed_context>(thread_context_impl(std::move(ranks), rank));
+}
+
+} // namespace arb
@@ -2,10 +2,15 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
+#include <arbor/assert.hpp>
+#include <arbor/common_types.hpp>
+#include <arbor/context.hpp>
 #include <arbor/spike.hpp>
 #include <arbor/util/pp_util.hpp>
 
+#include "communication/gather_request.hpp"
 #include "communication/gathered_vector.hpp"
 
 namespace arb {
@@ -14,19 +19,22 @@ namespace arb {
     T min(T value) const { return impl_->min(value); }\
     T max(T value) const { return impl_->max(value); }\
     T sum(T value) const { return impl_->sum(value); }\
-    std::vector<T> gather(T value, int root) const { return impl_->gather(value, root); }
+    std::vector<T> gather(T value, int root) const { return impl_->gather(value, root); }\
+    std::vector<T> all_gather(const std::vector<T>& values) const { return impl_->all_gather(values); }
 
 #define ARB_INTERFACE_COLLECTIVES_(T) \
     virtual T min(T value) const = 0;\
     virtual T max(T value) const = 0;\
     virtual T sum(T value) const = 0;\
-    virtual std::vector<T> gather(T value, int root) const = 0;
+    virtual std::vector<T> gather(T value, int root) const = 0;\
+    virtual std::vector<T> all_gather(const std::vector<T>& values) const = 0;
 
 #define ARB_WRAP_COLLECTIVES_(T) \
     T min(T value) const override { return wrapped.min(value); }\
     T max(T value) const override { return wrapped.max(value); }\
     T sum(T value) const override { return wrapped.sum(value); }\
-    std::vector<T> gather(T value, int root) const override { return wrapped.gather(value, root); }
+    std::vector<T> gather(T value, int root) const override { return wrapped.gather(value, root); }\
+    std::vector<T> all_gather(const std::vector<T>& values) const override { return wrapped.all_gather(values); }
 
 #define ARB_COLLECTIVE_TYPES_ float, double, int, unsigned, long, unsigned long, long long, unsigned long long
 
@@ -42,6 +50,8 @@ namespace arb {
 class distributed_context {
 public:
     using spike_vector = std::vector<arb::spike>;
+    using gid_vector = std::vector<cell_gid_type>;
+    using count_vector = std::vector<gathered_vector<arb::spike>::count_type>;
 
     // default constructor uses a local context: see below.
     distributed_context();
@@ -58,6 +68,45 @@ public:
         return impl_->gather_spikes(local_spikes);
     }
 
+    // Gather spikes packed with pack_spikes (see communication/packed_spikes.hpp)
+    // from all domains. The result is partitioned by domain.
+    gathered_vector<char> gather_packed_spikes(const std::vector<char>& local_packed) const {
+        return impl_->gather_packed_spikes(local_packed);
+    }
+
+    // Gather gids from all domains. The result is partitioned by domain.
+    gathered_vector<cell_gid_type> gather_gids(const gid_vector& local_gids) const {
+        return impl_->gather_gids(local_gids);
+    }
+
+    // Start gathering spikes from all domains, returning a request from
+    // which the spikes of each domain can be taken as they arrive. Contexts
+    // without support for non-blocking communication gather the spikes
+    // before returning.
+    //
+    // If pairwise is set, contexts that support it send the spikes to each
+    // domain with point to point messages, so that the spikes of each domain
+    // can be taken as soon as they arrive, rather than once all have arrived.
+    // This takes a message between every pair of domains.
+    gather_request<arb::spike> start_gather_spikes(spike_vector local_spikes, bool pairwise = false) const {
+        return impl_->start_gather_spikes(std::move(local_spikes), pairwise);
+    }
+
+    gather_request<char> start_gather_packed_spikes(std::vector<char> local_packed, bool pairwise = false) const {
+        return impl_->start_gather_packed_spikes(std::move(local_packed), pairwise);
+    }
+
+    // Personalised all-to-all exchange: the values in partition i of the
+    // input are sent to domain i, and the result is partitioned by the
+    // domain that sent each part.
+    gathered_vector<arb::spike> all_to_all_spikes(const spike_vector& values, const count_vector& partition) const {
+        return impl_->all_to_all_spikes(values, partition);
+    }
+
+    gathered_vector<cell_gid_type> all_to_all_gids(const gid_vector& values, const count_vector& partition) const {
+        return impl_->all_to_all_gids(values, partition);
+    }
+
     int id() const {
         return impl_->id();
     }
@@ -84,6 +133,18 @@ private:
     struct interface {
         virtual gathered_vector<arb::spike>
             gather_spikes(const spike_vector& local_spikes) const = 0;
+        virtual gathered_vector<char>
+            gather_packed_spikes(const std::vector<char>& local_packed) const = 0;
+        virtual gathered_vector<cell_gid_type>
+            gather_gids(const gid_vector& local_gids) const = 0;
+        virtual gather_request<arb::spike>
+            start_gather_spikes(spike_vector local_spikes, bool pairwise) const = 0;
+        virtual gather_request<char>
+            start_gather_packed_spikes(std::vector<char> local_packed, bool pairwise) const = 0;
+        virtual gathered_vector<arb::spike>
+            all_to_all_spikes(const spike_vector& values, const count_vector& partition) const = 0;
+        virtual gathered_vector<cell_gid_type>
+            all_to_all_gids(const gid_vector& values, const count_vector& partition) const = 0;
         virtual int id() const = 0;
         virtual int size() const = 0;
         virtual void barrier() const = 0;
@@ -104,6 +165,30 @@ private:
         gather_spikes(const spike_vector& local_spikes) const override {
             return wrapped.gather_spikes(local_spikes);
         }
+        gathered_vector<char>
+        gather_packed_spikes(const std::vector<char>& local_packed) const override {
+            return wrapped.gather_packed_spikes(local_packed);
+        }
+        gathered_vector<cell_gid_type>
+        gather_gids(const gid_vector& local_gids) const override {
+            return wrapped.gather_gids(local_gids);
+        }
+        gather_request<arb::spike>
+        start_gather_spikes(spike_vector local_spikes, bool pairwise) const override {
+            return wrapped.start_gather_spikes(std::move(local_spikes), pairwise);
+        }
+        gather_request<char>
+        start_gather_packed_spikes(std::vector<char> local_packed, bool pairwise) const override {
+            return wrapped.start_gather_packed_spikes(std::move(local_packed), pairwise);
+        }
+        gathered_vector<arb::spike>
+        all_to_all_spikes(const spike_vector& values, const count_vector& partition) const override {
+            return wrapped.all_to_all_spikes(values, partition);
+        }
+        gathered_vector<cell_gid_type>
+        all_to_all_gids(const gid_vector& values, const count_vector& partition) const override {
+            return wrapped.all_to_all_gids(values, partition);
+        }
         int id() const override {
             return wrapped.id();
         }
@@ -139,6 +224,56 @@ struct local_context {
         );
     }
 
+    gathered_vector<char>
+    gather_packed_spikes(const std::vector<char>& local_packed) const {
+        using count_type = typename gathered_vector<char>::count_type;
+        return gathered_vector<char>(
+            std::vector<char>(local_packed),
+            {0u, static_cast<count_type>(local_packed.size())}
+        );
+    }
+
+    gathered_vector<cell_gid_type>
+    gather_gids(const std::vector<cell_gid_type>& local_gids) const {
+        using count_type = typename gathered_vector<cell_gid_type>::count_type;
+        return gathered_vector<cell_gid_type>(
+            std::vector<cell_gid_type>(local_gids),
+            {0u, static_cast<count_type>(local_gids.size())}
+        );
+    }
+
+    gather_request<arb::spike>
+    start_gather_spikes(std::vector<arb::spike> local_spikes, bool) const {
+        return gather_request<arb::spike>(gather_spikes(local_spikes));
+    }
+
+    gather_request<char>
+    start_gather_packed_spikes(std::vector<char> local_packed, bool) const {
+        return gather_request<char>(gather_packed_spikes(local_packed));
+    }
+
+    // With one domain, everything is sent to and received from itself.
+    template <typename T>
+    gathered_vector<T>
+    all_to_all(const std::vector<T>& values, const std::vector<unsigned>& partition) const {
+        using count_type = typename gathered_vector<T>::count_type;
+        arb_assert(partition.size()==2u);
+        return gathered_vector<T>(
+            std::vector<T>(values),
+            {0u, static_cast<count_type>(values.size())}
+        );
+    }
+
+    gathered_vector<arb::spike>
+    all_to_all_spikes(const std::vector<arb::spike>& values, const std::vector<unsigned>& partition) const {
+        return all_to_all(values, partition);
+    }
+
+    gathered_vector<cell_gid_type>
+    all_to_all_gids(const std::vector<cell_gid_type>& values, const std::vector<unsigned>& partition) const {
+        return all_to_all(values, partition);
+    }
+
     int id() const { return 0; }
 
     int size() const { return 1; }
@@ -155,6 +290,9 @@ struct local_context {
     template <typename T>
     std::vector<T> gather(T value, int) const { return {std::move(value)}; }
 
+    template <typename T>
+    std::vector<T> all_gather(const std::vector<T>& values) const { return values; }
+
     void barrier() const {}
 
     std::string name() const { return "local"; }
@@ -173,6 +311,9 @@ distributed_context_handle make_local_context() {
 
 distributed_context_handle make_dry_run_context(unsigned num_ranks, unsigned num_cells_per_rank);
 
+// Context for rank `rank` of ranks that run in threads of one process.
+distributed_context_handle make_thread_context(thread_ranks ranks, unsigned rank);
+
 // MPI context creation functions only provided if built with MPI support.
 template <typename MPICommType>
 distributed_context_handle make_mpi_context(MPICommType);
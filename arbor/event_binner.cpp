@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <limits>
 #include <stdexcept>
 #include <unordered_map>
@@ -43,5 +44,16 @@ time_type event_binner::bin(time_type t, time_type t_min) {
     return std::max(t_binned, t_min);
 }
 
+void event_binner::checkpoint(checkpoint_writer& out) const {
+    out.write<std::uint8_t>(bool(last_event_time_));
+    out.write(last_event_time_? *last_event_time_: time_type(0));
+}
+
+void event_binner::restore(checkpoint_reader& in) {
+    bool has_last = in.read<std::uint8_t>();
+    auto t = in.read<time_type>();
+    last_event_time_ = has_last? util::optional<time_type>(t): util::nullopt;
+}
+
 } // namespace arb
 
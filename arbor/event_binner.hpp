@@ -7,6 +7,8 @@
 #include <arbor/spike.hpp>
 #include <arbor/util/optional.hpp>
 
+#include "checkpoint.hpp"
+
 namespace arb {
 
 class event_binner {
@@ -26,6 +28,9 @@ public:
 
     time_type bin(time_type t, time_type t_min = std::numeric_limits<time_type>::lowest());
 
+    void checkpoint(checkpoint_writer&) const;
+    void restore(checkpoint_reader&);
+
 private:
     binning_kind policy_;
 
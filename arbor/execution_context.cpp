@@ -6,7 +6,9 @@
 #include "gpu_context.hpp"
 #include "distributed_context.hpp"
 #include "execution_context.hpp"
+#include "profile/profiler_macro.hpp"
 #include "threading/threading.hpp"
+#include "threading/thread_info.hpp"
 
 #ifdef ARB_HAVE_MPI
 #include <mpi.h>
@@ -14,37 +16,53 @@
 
 namespace arb {
 
+// Deleter of the context handles returned by make_context.
+// The execution_context is copied into simulations and cell groups, which
+// share its thread pool: the profiler stops using the thread pool only when
+// the context made for the user is destroyed.
+static void delete_context(execution_context* p) {
+    profile::profiler_release(p->thread_pool.get());
+    delete p;
+}
+
+static task_system_handle make_thread_pool(const proc_allocation& resources) {
+    return std::make_shared<threading::task_system>(
+        resources.num_threads,
+        threading::scheduler_kind::work_stealing,
+        threading::thread_binding_cpus(resources));
+}
+
 execution_context::execution_context():
     execution_context(proc_allocation())
 {}
 
 execution_context::execution_context(const proc_allocation& resources):
     distributed(make_local_context()),
-    thread_pool(std::make_shared<threading::task_system>(resources.num_threads)),
+    thread_pool(make_thread_pool(resources)),
     gpu(resources.has_gpu()? std::make_shared<gpu_context>(resources.gpu_id)
                            : std::make_shared<gpu_context>())
 {}
 
 context make_context() {
-    return context(new execution_context(), [](execution_context* p){delete p;});
+    return context(new execution_context(), delete_context);
 }
 
 context make_context(const proc_allocation& p) {
-    return context(new execution_context(p), [](execution_context* p){delete p;});
+    return context(new execution_context(p), delete_context);
 }
 
 #ifdef ARB_HAVE_MPI
 template <>
 execution_context::execution_context(const proc_allocation& resources, MPI_Comm comm):
     distributed(make_mpi_context(comm)),
-    thread_pool(std::make_shared<threading::task_system>(resources.num_threads)),
+    thread_pool(make_thread_pool(resources)),
     gpu(resources.has_gpu()? std::make_shared<gpu_context>(resources.gpu_id)
                            : std::make_shared<gpu_context>())
 {}
 
 template <>
 context make_context<MPI_Comm>(const proc_allocation& p, MPI_Comm comm) {
-    return context(new execution_context(p, comm), [](execution_context* p){delete p;});
+    return context(new execution_context(p, comm), delete_context);
 }
 #endif
 template <>
@@ -52,14 +70,29 @@ execution_context::execution_context(
         const proc_allocation& resources,
         dry_run_info d):
         distributed(make_dry_run_context(d.num_ranks, d.num_cells_per_rank)),
-        thread_pool(std::make_shared<threading::task_system>(resources.num_threads)),
+        thread_pool(make_thread_pool(resources)),
         gpu(resources.has_gpu()? std::make_shared<gpu_context>(resources.gpu_id)
                                : std::make_shared<gpu_context>())
 {}
 
 template <>
 context make_context(const proc_allocation& p, dry_run_info d) {
-    return context(new execution_context(p, d), [](execution_context* p){delete p;});
+    return context(new execution_context(p, d), delete_context);
+}
+
+template <>
+execution_context::execution_context(
+        const proc_allocation& resources,
+        thread_rank_info r):
+        distributed(make_thread_context(std::move(r.ranks), r.rank)),
+        thread_pool(make_thread_pool(resources)),
+        gpu(resources.has_gpu()? std::make_shared<gpu_context>(resources.gpu_id)
+                               : std::make_shared<gpu_context>())
+{}
+
+template <>
+context make_context(const proc_allocation& p, thread_rank_info r) {
+    return context(new execution_context(p, std::move(r)), delete_context);
 }
 
 std::string distribution_type(const context& ctx) {
@@ -1,3 +1,4 @@
+#include <numeric>
 #include <set>
 #include <stdexcept>
 #include <unordered_set>
@@ -9,7 +10,6 @@
 #include "algorithms.hpp"
 #include "fvm_compartment.hpp"
 #include "fvm_layout.hpp"
-#include "tree.hpp"
 #include "util/maputil.hpp"
 #include "util/meta.hpp"
 #include "util/partition.hpp"
@@ -34,18 +34,53 @@ namespace {
         }
     }
 
-    struct compartment_model {
-        arb::tree tree;
-        std::vector<tree::int_type> parent_index;
-        std::vector<tree::int_type> segment_index;
+    // Index of the first CV of each segment of a cell, relative to the first
+    // CV of the cell, with CVs numbered according to the given ordering.
+    std::vector<fvm_index_type> make_segment_cv_offsets(const mc_cell& cell, cv_ordering order) {
+        using index_type = fvm_index_type;
 
-        explicit compartment_model(const mc_cell& cell) {
-            tree = arb::tree(cell.parents());
-            auto counts = cell.compartment_counts();
-            parent_index = make_parent_index(tree, counts);
-            segment_index = algorithms::make_index(counts);
+        auto counts = cell.compartment_counts();
+        if (!algorithms::all_positive(counts)) {
+            throw arbor_internal_error("fvm_layout: segments must have at least one compartment");
         }
-    };
+
+        const index_type nseg = counts.size();
+        std::vector<index_type> offsets(nseg, 0);
+
+        if (order==cv_ordering::segment) {
+            std::partial_sum(counts.begin(), counts.end()-1, offsets.begin()+1);
+            return offsets;
+        }
+
+        // Depth-first ordering. Parents precede their children in segment
+        // order, so the number of CVs in the subtree of each segment can be
+        // accumulated in reverse segment order, and the subtrees of the
+        // children of a segment placed one after the other in segment order.
+        const auto& parents = cell.parents();
+
+        std::vector<index_type> subtree_size(counts.begin(), counts.end());
+        for (index_type i = nseg-1; i>0; --i) {
+            subtree_size[parents[i]] += subtree_size[i];
+        }
+
+        std::vector<std::vector<index_type>> children(nseg);
+        for (auto i: make_span(1, nseg)) {
+            children[parents[i]].push_back(i);
+        }
+
+        for (auto i: make_span(nseg)) {
+            // Visiting smaller subtrees first minimizes the sum of the
+            // distances between the first CV of each child and its parent.
+            util::stable_sort_by(children[i], [&](index_type j) { return subtree_size[j]; });
+
+            index_type next = offsets[i]+counts[i];
+            for (auto j: children[i]) {
+                offsets[j] = next;
+                next += subtree_size[j];
+            }
+        }
+        return offsets;
+    }
 } // namespace
 
 // Cable segment discretization
@@ -110,7 +145,7 @@ namespace {
 //       = 1/R · hV₁V₂/(h₂²V₁+h₁²V₂)
 //
 
-fvm_discretization fvm_discretize(const std::vector<mc_cell>& cells) {
+fvm_discretization fvm_discretize(const std::vector<mc_cell>& cells, cv_ordering order) {
     using value_type = fvm_value_type;
     using index_type = fvm_index_type;
     using size_type = fvm_size_type;
@@ -136,29 +171,22 @@ fvm_discretization fvm_discretize(const std::vector<mc_cell>& cells) {
         util::fill(subrange_view(D.cv_to_cell, cell_comp_part[i]), static_cast<index_type>(i));
     }
 
-    std::vector<size_type> seg_comp_bounds;
     for (auto i: make_span(0, D.ncell)) {
         const auto& c = cells[i];
-        compartment_model cell_graph (c);
-        auto cell_comp_ival = cell_comp_part[i];
+        auto cell_comp_base = cell_comp_part[i].first;
 
-        auto cell_comp_base = cell_comp_ival.first;
-        for (auto k: make_span(cell_comp_ival)) {
-            D.parent_cv[k] = cell_graph.parent_index[k-cell_comp_base]+cell_comp_base;
-        }
-
-        // Compartment index range for each segment in this cell.
-        seg_comp_bounds.clear();
-        auto seg_comp_part = make_partition(
-            seg_comp_bounds,
-            transform_view(c.segments(), [](const mc_segment_ptr& s) { return s->num_compartments(); }),
-            cell_comp_base);
-
-        const auto nseg = seg_comp_part.size();
+        const auto nseg = c.num_segments();
         if (nseg==0) {
             throw arbor_internal_error("fvm_layout: cannot discretrize cell with no segments");
         }
 
+        // Compartment index range for each segment in this cell.
+        auto seg_cv_offsets = make_segment_cv_offsets(c, order);
+        auto segment_cvs = [&](size_type j) {
+            index_type first = cell_comp_base+seg_cv_offsets[j];
+            return std::make_pair(first, first+index_type(c.segment(j)->num_compartments()));
+        };
+
         // Handle soma (first segment and root of tree) specifically.
         const auto soma = c.segment(0)->as_soma();
         if (!soma) {
@@ -173,6 +201,7 @@ fvm_discretization fvm_discretize(const std::vector<mc_cell>& cells) {
         size_type soma_cv = cell_comp_base;
         value_type soma_area = math::area_sphere(soma->radius());
 
+        D.parent_cv[soma_cv] = soma_cv;
         D.cv_area[soma_cv] = soma_area;                  // [µm²]
         D.cv_capacitance[soma_cv] = soma_area*soma->cm;  // [pF]
 
@@ -183,7 +212,7 @@ fvm_discretization fvm_discretize(const std::vector<mc_cell>& cells) {
 
         // Other segments must all be cable segments.
         for (size_type j = 1; j<nseg; ++j) {
-            const auto& seg_comp_ival = seg_comp_part[j];
+            const auto seg_comp_ival = segment_cvs(j);
             const auto ncomp = seg_comp_ival.second-seg_comp_ival.first;
 
             segment_info seg_info;
@@ -197,6 +226,13 @@ fvm_discretization fvm_discretize(const std::vector<mc_cell>& cells) {
 
             auto divs = div_compartment_integrator(ncomp, cable->radii(), cable->lengths());
 
+            // The first CV of the segment is attached to the last CV of the
+            // parent segment.
+            D.parent_cv[seg_comp_ival.first] = segment_cvs(c.parents()[j]).second-1;
+            for (auto k: make_span(seg_comp_ival.first+1, seg_comp_ival.second)) {
+                D.parent_cv[k] = k-1;
+            }
+
             seg_info.parent_cv = D.parent_cv[seg_comp_ival.first];
             seg_info.parent_cv_area = divs(0).left.area;
 
@@ -366,6 +402,17 @@ fvm_mechanism_data fvm_build_mechanism_data(const mechanism_catalogue& catalogue
         }
     }
 
+    // Segments are visited below in increasing order of their first CV, so
+    // that the CV lists of ions and density mechanisms are in increasing
+    // order for any CV ordering.
+
+    auto segment_first_cv = [&D](size_type segment) { return D.segments[segment].proximal_cv; };
+
+    for (auto& entry: density_mech_table) {
+        util::stable_sort_by(entry.second.segments,
+            [&](const std::pair<size_type, const mechanism_desc*>& p) { return segment_first_cv(p.first); });
+    }
+
     // II. Build ion and mechanism configs.
 
     // Shared temporary lookup info across mechanism instances, set by build_param_data.
@@ -394,7 +441,10 @@ fvm_mechanism_data fvm_build_mechanism_data(const mechanism_catalogue& catalogue
     for (auto& ionseg: ion_segments) {
         auto& ion = mechdata.ions[ionseg.first];
 
-        for (size_type segment: ionseg.second) {
+        std::vector<size_type> segments(ionseg.second.begin(), ionseg.second.end());
+        sort_by(segments, segment_first_cv);
+
+        for (size_type segment: segments) {
             const segment_info& seg_info = D.segments[segment];
 
             if (seg_info.has_parent()) {
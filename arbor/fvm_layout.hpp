@@ -86,7 +86,9 @@ struct fvm_discretization {
     }
 };
 
-fvm_discretization fvm_discretize(const std::vector<mc_cell>& cells);
+// The CVs of each cell are numbered according to order; see cv_ordering.
+
+fvm_discretization fvm_discretize(const std::vector<mc_cell>& cells, cv_ordering order = cv_ordering::segment);
 
 
 // Post-discretization data for point and density mechanism instantiation.
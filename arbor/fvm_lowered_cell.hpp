@@ -9,6 +9,7 @@
 
 #include "backends/event.hpp"
 #include "backends/threshold_crossing.hpp"
+#include "checkpoint.hpp"
 #include "execution_context.hpp"
 #include "sampler_map.hpp"
 #include "util/range.hpp"
@@ -40,6 +41,11 @@ struct fvm_lowered_cell {
 
     virtual fvm_value_type time() const = 0;
 
+    // Write the cell state to a checkpoint, or restore it from a checkpoint
+    // written by a lowered cell initialized with the same cells.
+    virtual void checkpoint(checkpoint_writer&) const = 0;
+    virtual void restore(checkpoint_reader&) = 0;
+
     virtual ~fvm_lowered_cell() {}
 };
 
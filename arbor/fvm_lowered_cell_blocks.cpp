@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/common_types.hpp>
+#include <arbor/fvm_types.hpp>
+#include <arbor/recipe.hpp>
+
+#include "backends/event.hpp"
+#include "backends/threshold_crossing.hpp"
+#include "checkpoint.hpp"
+#include "execution_context.hpp"
+#include "fvm_lowered_cell.hpp"
+#include "fvm_lowered_cell_blocks.hpp"
+#include "profile/profiler_macro.hpp"
+#include "sampler_map.hpp"
+#include "threading/threading.hpp"
+#include "util/range.hpp"
+#include "util/rangeutil.hpp"
+#include "util/span.hpp"
+
+namespace arb {
+
+fvm_lowered_cell_blocks::fvm_lowered_cell_blocks(
+    execution_context ctx, block_factory make_block, unsigned block_cells):
+    context_(ctx),
+    make_block_(std::move(make_block)),
+    block_cells_(std::max(block_cells, 1u))
+{}
+
+void fvm_lowered_cell_blocks::reset() {
+    threading::parallel_for::apply(0, blocks_.size(), context_.thread_pool.get(),
+        [&](int i) { blocks_[i].cell->reset(); });
+}
+
+void fvm_lowered_cell_blocks::initialize(
+    const std::vector<cell_gid_type>& gids,
+    const recipe& rec,
+    std::vector<target_handle>& target_handles,
+    probe_association_map<probe_handle>& probe_map)
+{
+    // Blocks of about equal numbers of cells.
+    const std::size_t ncell = gids.size();
+    const std::size_t nblock = std::max<std::size_t>(1, ncell/block_cells_);
+
+    blocks_.clear();
+    blocks_.resize(nblock);
+    cell_block_.resize(ncell);
+
+    cell_size_type n_sources = 0;
+    for (auto i: util::make_span(nblock)) {
+        auto& b = blocks_[i];
+        b.first_cell = ncell*i/nblock;
+        b.first_source = n_sources;
+
+        const cell_size_type end = ncell*(i+1)/nblock;
+        for (auto c: util::make_span(b.first_cell, end)) {
+            cell_block_[c] = i;
+            n_sources += rec.num_sources(gids[c]);
+        }
+    }
+
+    // Build the blocks in parallel, then gather their target handles and
+    // probes in cell order.
+    std::vector<std::vector<target_handle>> block_targets(nblock);
+    std::vector<probe_association_map<probe_handle>> block_probes(nblock);
+
+    threading::parallel_for::apply(0, nblock, context_.thread_pool.get(),
+        [&](int i) {
+            auto& b = blocks_[i];
+            auto end = i+1<(int)nblock? blocks_[i+1].first_cell: ncell;
+            std::vector<cell_gid_type> block_gids(gids.begin()+b.first_cell, gids.begin()+end);
+
+            b.cell = make_block_();
+            b.cell->initialize(block_gids, rec, block_targets[i], block_probes[i]);
+        });
+
+    target_handles.clear();
+    for (auto i: util::make_span(nblock)) {
+        for (auto h: block_targets[i]) {
+            h.cell_index += blocks_[i].first_cell;
+            target_handles.push_back(h);
+        }
+        probe_map.insert(block_probes[i].begin(), block_probes[i].end());
+    }
+}
+
+fvm_integration_result fvm_lowered_cell_blocks::integrate(
+    fvm_value_type tfinal,
+    fvm_value_type max_dt,
+    std::vector<deliverable_event> staged_events,
+    std::vector<sample_event> staged_samples)
+{
+    // The cell and sample indices of a single block are those of the group.
+    if (blocks_.size()==1) {
+        return blocks_[0].cell->integrate(tfinal, max_dt, std::move(staged_events), std::move(staged_samples));
+    }
+
+    PE(advance_integrate_blocks);
+    for (auto& b: blocks_) {
+        b.staged_events.clear();
+        b.staged_samples.clear();
+        b.sample_offsets.clear();
+    }
+
+    for (auto e: staged_events) {
+        auto& b = blocks_[cell_block_[e.handle.cell_index]];
+        e.handle.cell_index -= b.first_cell;
+        b.staged_events.push_back(e);
+    }
+    // Samples are assigned offsets in their block in the order staged,
+    // which is in time order.
+    for (auto s: staged_samples) {
+        auto& b = blocks_[cell_block_[s.cell_index]];
+        s.cell_index -= b.first_cell;
+        b.sample_offsets.push_back(s.raw.offset);
+        s.raw.offset = b.staged_samples.size();
+        b.staged_samples.push_back(s);
+    }
+    PL();
+
+    threading::parallel_for::apply(0, blocks_.size(), context_.thread_pool.get(),
+        [&](int i) {
+            auto& b = blocks_[i];
+            b.result = b.cell->integrate(tfinal, max_dt, std::move(b.staged_events), std::move(b.staged_samples));
+        });
+
+    // Gather crossings with group spike source indices, and samples at
+    // their group offsets.
+    PE(advance_integrate_blocks);
+    crossings_.clear();
+    sample_time_.resize(staged_samples.size());
+    sample_value_.resize(staged_samples.size());
+
+    for (auto& b: blocks_) {
+        for (auto c: b.result.crossings) {
+            c.index += b.first_source;
+            crossings_.push_back(c);
+        }
+        for (auto i: util::count_along(b.sample_offsets)) {
+            sample_time_[b.sample_offsets[i]] = b.result.sample_time[i];
+            sample_value_[b.sample_offsets[i]] = b.result.sample_value[i];
+        }
+    }
+    PL();
+
+    return fvm_integration_result{
+        util::range_pointer_view(crossings_),
+        util::range_pointer_view(sample_time_),
+        util::range_pointer_view(sample_value_)
+    };
+}
+
+fvm_value_type fvm_lowered_cell_blocks::time() const {
+    return blocks_.front().cell->time();
+}
+
+void fvm_lowered_cell_blocks::checkpoint(checkpoint_writer& out) const {
+    out.write<std::uint64_t>(blocks_.size());
+    for (auto& b: blocks_) {
+        b.cell->checkpoint(out);
+    }
+}
+
+void fvm_lowered_cell_blocks::restore(checkpoint_reader& in) {
+    if (in.read<std::uint64_t>()!=blocks_.size()) {
+        throw bad_checkpoint("number of cell blocks differs");
+    }
+    for (auto& b: blocks_) {
+        b.cell->restore(in);
+    }
+}
+
+} // namespace arb
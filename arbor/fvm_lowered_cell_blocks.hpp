@@ -0,0 +1,95 @@
+#pragma once
+
+// A lowered cell that partitions the cells of a cell group into blocks of
+// contiguous cells, and integrates the blocks in parallel.
+//
+// Each block is a lowered cell over the cells of the block, with its own
+// matrix, mechanism instances, event and sample streams, and threshold
+// watcher, so that the steps of the integration of one block are
+// independent of the other blocks. Target handles, sample events and
+// threshold crossings are translated between the indices of cells in the
+// group and in their block, so that the partition is not visible to the
+// cell group.
+//
+// The partition depends only on the number of cells, not on the number of
+// threads, so that a checkpoint can be restored with any number of threads.
+
+#include <functional>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/fvm_types.hpp>
+#include <arbor/recipe.hpp>
+
+#include "backends/event.hpp"
+#include "backends/threshold_crossing.hpp"
+#include "execution_context.hpp"
+#include "fvm_lowered_cell.hpp"
+#include "sampler_map.hpp"
+
+namespace arb {
+
+class fvm_lowered_cell_blocks: public fvm_lowered_cell {
+public:
+    using block_factory = std::function<fvm_lowered_cell_ptr ()>;
+
+    // Partition the cells into blocks of at least block_cells cells each,
+    // built with make_block.
+    fvm_lowered_cell_blocks(execution_context ctx, block_factory make_block, unsigned block_cells);
+
+    void reset() override;
+
+    void initialize(
+        const std::vector<cell_gid_type>& gids,
+        const recipe& rec,
+        std::vector<target_handle>& target_handles,
+        probe_association_map<probe_handle>& probe_map) override;
+
+    fvm_integration_result integrate(
+        fvm_value_type tfinal,
+        fvm_value_type max_dt,
+        std::vector<deliverable_event> staged_events,
+        std::vector<sample_event> staged_samples) override;
+
+    fvm_value_type time() const override;
+
+    void checkpoint(checkpoint_writer&) const override;
+
+    void restore(checkpoint_reader&) override;
+
+    std::size_t num_blocks() const {
+        return blocks_.size();
+    }
+
+private:
+    struct block {
+        fvm_lowered_cell_ptr cell;
+        cell_size_type first_cell = 0;    // Index in the group of the first cell.
+        cell_size_type first_source = 0;  // Index in the group of the first spike source.
+
+        // Events and samples for the cells of the block, with cell indices
+        // relative to first_cell, and the offset in the group sample
+        // buffers of each sample.
+        std::vector<deliverable_event> staged_events;
+        std::vector<sample_event> staged_samples;
+        std::vector<sample_size_type> sample_offsets;
+
+        fvm_integration_result result;
+    };
+
+    execution_context context_;
+    block_factory make_block_;
+    unsigned block_cells_;
+
+    std::vector<block> blocks_;
+
+    // The index of the block of each cell in the group.
+    std::vector<cell_size_type> cell_block_;
+
+    // Results of integration, gathered from the blocks.
+    std::vector<threshold_crossing> crossings_;
+    std::vector<fvm_value_type> sample_time_;
+    std::vector<fvm_value_type> sample_value_;
+};
+
+} // namespace arb
@@ -8,14 +8,26 @@
 #ifdef ARB_HAVE_GPU
 #include "backends/gpu/fvm.hpp"
 #endif
+#include "fvm_lowered_cell_blocks.hpp"
 #include "fvm_lowered_cell_impl.hpp"
 
 namespace arb {
 
+// Blocks of fewer cells do not do enough work to amortize the cost of a task.
+// The number of blocks does not depend on the number of threads, so that the
+// layout of checkpoints does not either.
+constexpr unsigned block_cells = 8;
+
 fvm_lowered_cell_ptr make_fvm_lowered_cell(backend_kind p, const execution_context& ctx) {
     switch (p) {
-    case backend_kind::multicore:
-        return fvm_lowered_cell_ptr(new fvm_lowered_cell_impl<multicore::backend>(ctx));
+    case backend_kind::multicore: {
+        // Integrate the cells of large groups in parallel, in blocks of
+        // cells.
+        auto make_block = [ctx]() {
+            return fvm_lowered_cell_ptr(new fvm_lowered_cell_impl<multicore::backend>(ctx));
+        };
+        return fvm_lowered_cell_ptr(new fvm_lowered_cell_blocks(ctx, make_block, block_cells));
+    }
     case backend_kind::gpu:
 #ifdef ARB_HAVE_GPU
         return fvm_lowered_cell_ptr(new fvm_lowered_cell_impl<gpu::backend>(ctx));
@@ -8,18 +8,21 @@
 // It should otherwise only be used in `fvm_lowered_cell.cpp`.
 
 #include <cmath>
+#include <cstdint>
 #include <iterator>
 #include <memory>
 #include <stdexcept>
 #include <utility>
 #include <vector>
 
+#include <arbor/arbexcept.hpp>
 #include <arbor/assert.hpp>
 #include <arbor/common_types.hpp>
 #include <arbor/ion.hpp>
 #include <arbor/recipe.hpp>
 
 #include "builtin_mechanisms.hpp"
+#include "checkpoint.hpp"
 #include "execution_context.hpp"
 #include "fvm_layout.hpp"
 #include "fvm_lowered_cell.hpp"
@@ -62,6 +65,10 @@ public:
 
     value_type time() const override { return tmin_; }
 
+    void checkpoint(checkpoint_writer&) const override;
+
+    void restore(checkpoint_reader&) override;
+
     //Exposed for testing purposes
     std::vector<mechanism_ptr>& mechanisms() {
         return mechanisms_;
@@ -93,6 +100,11 @@ private:
     // Non-physical voltage check threshold, 0 => no check.
     value_type check_voltage_mV = 0;
 
+    // Local voltage error tolerance for adaptive time stepping, 0 => fixed
+    // steps, and the smallest adaptive step.
+    value_type adaptive_tolerance_mV_ = 0;
+    value_type adaptive_dt_min_ = 0;
+
     // Host-side views/copies and local state.
     decltype(backend::host_view(sample_time_)) sample_time_host_;
     decltype(backend::host_view(sample_value_)) sample_value_host_;
@@ -111,6 +123,13 @@ private:
         arb_assert((assert_tmin(), true));
     }
 
+    // The ion species in the shared state, in order of ion kind.
+    std::vector<ionKind> ion_kinds() const {
+        std::vector<ionKind> kinds = util::assign_from(util::keys(state_->ion_data));
+        util::sort(kinds);
+        return kinds;
+    }
+
     static unsigned dt_steps(value_type t0, value_type t1, value_type dt) {
         return t0>=t1? 0: 1+(unsigned)((t1-t0)/dt);
     }
@@ -130,6 +149,7 @@ void fvm_lowered_cell_impl<Backend>::assert_tmin() {
 template <typename Backend>
 void fvm_lowered_cell_impl<Backend>::reset() {
     state_->reset(initial_voltage_, temperature_);
+    state_->reset_dt_step(adaptive_dt_min_);
     set_tmin(0);
 
     for (auto& m: mechanisms_) {
@@ -178,6 +198,9 @@ fvm_integration_result fvm_lowered_cell_impl<Backend>::integrate(
 
         PE(advance_integrate_events);
         state_->deliverable_events.mark_until_after(state_->time);
+        if (adaptive_tolerance_mV_>0) {
+            state_->reset_dt_step(state_->deliverable_events.marked_events(), adaptive_dt_min_);
+        }
         PL();
 
         PE(advance_integrate_current_zero);
@@ -193,29 +216,51 @@ fvm_integration_result fvm_lowered_cell_impl<Backend>::integrate(
 
         // Update event list and integration step times.
 
-        state_->update_time_to(dt_max, tfinal);
+        if (adaptive_tolerance_mV_>0) {
+            state_->update_time_to(state_->dt_step, dt_max, tfinal);
+        }
+        else {
+            state_->update_time_to(dt_max, tfinal);
+        }
         state_->deliverable_events.event_time_if_before(state_->time_to);
-        state_->set_dt();
         PL();
 
         // Take samples at cell time if sample time in this step interval.
+        // Adaptive steps instead end at the next sample time, so that
+        // samples are taken at the time requested.
 
         PE(advance_integrate_samples);
-        sample_events_.mark_until(state_->time_to);
+        if (adaptive_tolerance_mV_>0) {
+            sample_events_.mark_until_after(state_->time);
+        }
+        else {
+            sample_events_.mark_until(state_->time_to);
+        }
         state_->take_samples(sample_events_.marked_events(), sample_time_, sample_value_);
         sample_events_.drop_marked_events();
+        if (adaptive_tolerance_mV_>0) {
+            sample_events_.event_time_if_before(state_->time_to);
+        }
         PL();
 
         // Integrate voltage by matrix solve.
 
-        PE(advance_integrate_matrix_build);
-        matrix_.assemble(state_->dt_cell, state_->voltage, state_->current_density);
-        PL();
-        PE(advance_integrate_matrix_solve);
-        matrix_.solve();
-        memory::copy(matrix_.solution(), state_->voltage);
+        PE(advance_integrate_matrix);
+        state_->set_dt();
+        if (adaptive_tolerance_mV_>0) {
+            memory::copy(state_->voltage, state_->voltage_prev);
+        }
+        matrix_.assemble_and_solve(state_->dt_cell, state_->voltage, state_->current_density);
         PL();
 
+        // Choose the next step of each cell from the voltage error estimate.
+
+        if (adaptive_tolerance_mV_>0) {
+            PE(advance_integrate_adaptive);
+            state_->update_dt_step(adaptive_tolerance_mV_, adaptive_dt_min_, dt_max);
+            PL();
+        }
+
         // Integrate mechanism state.
 
         for (auto& m: mechanisms_) {
@@ -266,6 +311,76 @@ fvm_integration_result fvm_lowered_cell_impl<Backend>::integrate(
     };
 }
 
+// The state saved in a checkpoint is the time, the per-cell and per-CV
+// arrays of the shared state, including the adaptive step state, the state
+// of each ion species in order of ion kind, the values of each mechanism
+// instance, and the threshold watcher state. The matrix is assembled from
+// the voltage and current in each step, so need not be saved.
+
+template <typename B>
+void fvm_lowered_cell_impl<B>::checkpoint(checkpoint_writer& out) const {
+    out.write(tmin_);
+
+    for (auto a: {&state_->time, &state_->time_to, &state_->dt_cell, &state_->dt_cv, &state_->voltage, &state_->current_density,
+                  &state_->dt_step, &state_->dt_prev, &state_->dvdt}) {
+        out.write_range(backend::host_view(*a));
+    }
+
+    for (auto kind: ion_kinds()) {
+        const auto& ion = state_->ion_data.at(kind);
+        out.write(int(kind));
+        for (auto a: {&ion.iX_, &ion.eX_, &ion.Xi_, &ion.Xo_}) {
+            out.write_range(backend::host_view(*a));
+        }
+    }
+
+    out.write<std::uint64_t>(mechanisms_.size());
+    for (auto& m: mechanisms_) {
+        out.write_range(m->get_state());
+    }
+
+    threshold_watcher_.checkpoint(out);
+}
+
+template <typename B>
+void fvm_lowered_cell_impl<B>::restore(checkpoint_reader& in) {
+    // Read an array written from host_view into a back-end array of the
+    // same size.
+    auto restore_array = [&in](array& a) {
+        auto values = in.read_vector<value_type>();
+        if (values.size()!=a.size()) {
+            throw bad_checkpoint(util::pprintf("expected {} values, found {}", a.size(), values.size()));
+        }
+        memory::copy(values, a);
+    };
+
+    in.read(tmin_);
+
+    for (auto a: {&state_->time, &state_->time_to, &state_->dt_cell, &state_->dt_cv, &state_->voltage, &state_->current_density,
+                  &state_->dt_step, &state_->dt_prev, &state_->dvdt}) {
+        restore_array(*a);
+    }
+
+    for (auto kind: ion_kinds()) {
+        auto& ion = state_->ion_data.at(kind);
+        if (in.read<int>()!=int(kind)) {
+            throw bad_checkpoint("ion species differ");
+        }
+        for (auto a: {&ion.iX_, &ion.eX_, &ion.Xi_, &ion.Xo_}) {
+            restore_array(*a);
+        }
+    }
+
+    if (in.read<std::uint64_t>()!=mechanisms_.size()) {
+        throw bad_checkpoint("number of mechanisms differs");
+    }
+    for (auto& m: mechanisms_) {
+        m->set_state(in.read_vector<value_type>());
+    }
+
+    threshold_watcher_.restore(in);
+}
+
 template <typename B>
 void fvm_lowered_cell_impl<B>::update_ion_state() {
     state_->ions_init_concentration();
@@ -339,11 +454,19 @@ void fvm_lowered_cell_impl<B>::initialize(
 
     check_voltage_mV = global_props.membrane_voltage_limit_mV;
 
+    // Adaptive time stepping?
+
+    adaptive_tolerance_mV_ = global_props.adaptive_dt_tolerance_mV;
+    adaptive_dt_min_ = global_props.adaptive_dt_min_ms;
+    if (adaptive_tolerance_mV_>0 && (!(adaptive_dt_min_>0) || !backend::has_adaptive_dt())) {
+        throw bad_global_property(cell_kind::cable1d_neuron);
+    }
+
     // Discretize cells, build matrix.
 
-    fvm_discretization D = fvm_discretize(cells);
+    fvm_discretization D = fvm_discretize(cells, global_props.cv_order);
     arb_assert(D.ncell == ncell);
-    matrix_ = matrix<backend>(D.parent_cv, D.cell_cv_bounds, D.cv_capacitance, D.face_conductance, D.cv_area);
+    matrix_ = matrix<backend>(D.parent_cv, D.cell_cv_bounds, D.cv_capacitance, D.face_conductance, D.cv_area, context_);
     sample_events_ = sample_event_stream(ncell);
 
     // Discretize mechanism data.
@@ -0,0 +1,480 @@
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <arbor/assert.hpp>
+#include <arbor/common_types.hpp>
+
+#include "algorithms.hpp"
+#include "graph_partition.hpp"
+
+// The partitioner follows the multilevel scheme of METIS
+// (Karypis and Kumar, SIAM J. Sci. Comput. 20(1), 1998):
+//
+//   1. Coarsen: contract a heavy edge matching repeatedly, until the graph is
+//      small or the matching stops making progress.
+//   2. Partition the coarsest graph by greedy graph growing.
+//   3. Uncoarsen: project the partition back through the levels, refining
+//      it at each level by greedily moving vertices to the neighbouring part
+//      that most reduces the cut, subject to the balance constraint.
+
+namespace arb {
+
+namespace {
+
+constexpr auto npos = std::numeric_limits<cell_size_type>::max();
+
+// Fisher-Yates shuffle, with the same result on every platform for the same
+// random number generator state.
+void shuffle(std::vector<cell_size_type>& v, std::mt19937_64& rng) {
+    for (auto i = v.size(); i>1; --i) {
+        std::swap(v[i-1], v[rng()%i]);
+    }
+}
+
+double total_weight(const weighted_graph& g) {
+    return std::accumulate(g.vertex_weight.begin(), g.vertex_weight.end(), 0.);
+}
+
+// Largest allowed part weight: the requested imbalance, relaxed if the
+// heaviest vertex would make it impossible to meet.
+double max_part_weight(const weighted_graph& g, unsigned k, double imbalance) {
+    const double average = total_weight(g)/k;
+    const double max_vertex = g.size()?
+        *std::max_element(g.vertex_weight.begin(), g.vertex_weight.end()): 0.;
+    return std::max((1+imbalance)*average, average+max_vertex);
+}
+
+// Match every vertex, in random order, with the unmatched neighbour to which
+// it has the heaviest edge, unless their combined weight exceeds max_weight.
+// Vertices without neighbours are matched with each other.
+//
+// Returns the map from vertices to vertices of the contracted graph, which
+// are numbered in order of their lowest vertex, and sets nc to the number of
+// vertices in the contracted graph.
+std::vector<cell_size_type> heavy_edge_matching(
+    const weighted_graph& g, double max_weight, std::mt19937_64& rng, cell_size_type& nc)
+{
+    const cell_size_type n = g.size();
+
+    std::vector<cell_size_type> order(n);
+    std::iota(order.begin(), order.end(), 0u);
+    shuffle(order, rng);
+
+    std::vector<cell_size_type> match(n, npos);
+    cell_size_type isolated = npos;
+    for (auto v: order) {
+        if (match[v]!=npos) continue;
+
+        const auto b = g.offsets[v];
+        const auto e = g.offsets[v+1];
+        auto best = v;
+        if (b==e) {
+            // Pair isolated vertices with each other.
+            if (isolated!=npos && g.vertex_weight[v]+g.vertex_weight[isolated]<=max_weight) {
+                best = isolated;
+                isolated = npos;
+            }
+            else {
+                isolated = v;
+            }
+        }
+        else {
+            double best_weight = -1;
+            for (auto i = b; i<e; ++i) {
+                auto u = g.adjacency[i];
+                if (match[u]==npos && g.edge_weight[i]>best_weight &&
+                    g.vertex_weight[v]+g.vertex_weight[u]<=max_weight)
+                {
+                    best = u;
+                    best_weight = g.edge_weight[i];
+                }
+            }
+        }
+        match[v] = best;
+        match[best] = v;
+    }
+
+    // An isolated vertex waiting for a partner is matched with itself.
+    std::vector<cell_size_type> cmap(n);
+    nc = 0;
+    for (cell_size_type v = 0; v<n; ++v) {
+        if (match[v]==npos) match[v] = v;
+        if (match[v]>=v) {
+            cmap[v] = cmap[match[v]] = nc++;
+        }
+    }
+    return cmap;
+}
+
+// Contract the vertices of g that map to the same vertex under cmap. Edges
+// between contracted vertices are merged, summing their weights.
+weighted_graph contract(const weighted_graph& g, const std::vector<cell_size_type>& cmap, cell_size_type nc) {
+    const cell_size_type n = g.size();
+
+    // The vertices of g that map to each coarse vertex.
+    std::vector<cell_size_type> counts(nc, 0u);
+    for (auto c: cmap) ++counts[c];
+    auto first = algorithms::make_index(counts);
+    std::vector<cell_size_type> members(n);
+    {
+        auto pos = first;
+        for (cell_size_type v = 0; v<n; ++v) {
+            members[pos[cmap[v]]++] = v;
+        }
+    }
+
+    weighted_graph c;
+    c.vertex_weight.assign(nc, 0.);
+    c.offsets.reserve(nc+1);
+    c.adjacency.reserve(g.adjacency.size());
+    c.edge_weight.reserve(g.adjacency.size());
+
+    // Position of each coarse neighbour in the row being built.
+    std::vector<std::size_t> pos(nc, std::size_t(-1));
+    for (cell_size_type cv = 0; cv<nc; ++cv) {
+        const std::size_t row = c.adjacency.size();
+        for (auto i = first[cv]; i<first[cv+1]; ++i) {
+            const auto v = members[i];
+            c.vertex_weight[cv] += g.vertex_weight[v];
+            for (auto j = g.offsets[v]; j<g.offsets[v+1]; ++j) {
+                const auto cu = cmap[g.adjacency[j]];
+                if (cu==cv) continue;
+                if (pos[cu]==std::size_t(-1) || pos[cu]<row) {
+                    pos[cu] = c.adjacency.size();
+                    c.adjacency.push_back(cu);
+                    c.edge_weight.push_back(g.edge_weight[j]);
+                }
+                else {
+                    c.edge_weight[pos[cu]] += g.edge_weight[j];
+                }
+            }
+        }
+        c.offsets.push_back(c.adjacency.size());
+    }
+    return c;
+}
+
+// Partition by greedy graph growing: grow each part in turn, adding the
+// unassigned vertex with the heaviest edges into the part until the part has
+// about its share of the remaining weight. The first part is grown from
+// vertex start, and each following part from the unassigned vertex most
+// strongly connected to the part before it, so that consecutive parts are
+// neighbours. Every part is non-empty if g has at least k vertices.
+std::vector<unsigned> grow_partition(const weighted_graph& g, unsigned k, cell_size_type start) {
+    const cell_size_type n = g.size();
+    constexpr unsigned unassigned = -1;
+
+    std::vector<unsigned> part(n, unassigned);
+    cell_size_type num_unassigned = n;
+    cell_size_type lowest = 0;
+    auto lowest_unassigned = [&]() {
+        while (part[lowest]!=unassigned) ++lowest;
+        return lowest;
+    };
+
+    // Weight of the edges from each vertex into the part being grown, and
+    // the unassigned vertices by that weight. Entries in the queue with a
+    // weight that is out of date are skipped.
+    std::vector<double> conn(n, 0.);
+    std::vector<cell_size_type> touched;
+    using entry = std::pair<double, cell_size_type>;
+    std::priority_queue<entry> frontier;
+    auto current = [&](const entry& e) {
+        return part[e.second]==unassigned && e.first==conn[e.second];
+    };
+
+    double remaining = total_weight(g);
+    cell_size_type seed = start;
+    for (unsigned p = 0; p+1<k; ++p) {
+        const double target = remaining/(k-p);
+        double weight = 0;
+        cell_size_type count = 0;
+
+        frontier = {};
+        frontier.push({0., seed});
+        for (;;) {
+            while (!frontier.empty() && !current(frontier.top())) frontier.pop();
+            if (frontier.empty()) frontier.push({0., lowest_unassigned()});
+
+            const auto v = frontier.top().second;
+            const double w = g.vertex_weight[v];
+            // Stop at the closest division to the target weight, or when
+            // the remaining vertices are needed for one in each part.
+            if (count && (weight+w/2>target || num_unassigned<=k-1-p)) break;
+
+            frontier.pop();
+            part[v] = p;
+            weight += w;
+            ++count;
+            --num_unassigned;
+            for (auto j = g.offsets[v]; j<g.offsets[v+1]; ++j) {
+                const auto u = g.adjacency[j];
+                if (part[u]==unassigned) {
+                    conn[u] += g.edge_weight[j];
+                    touched.push_back(u);
+                    frontier.push({conn[u], u});
+                }
+            }
+        }
+        remaining -= weight;
+
+        while (!frontier.empty() && !current(frontier.top())) frontier.pop();
+        seed = frontier.empty()? lowest_unassigned(): frontier.top().second;
+
+        for (auto u: touched) conn[u] = 0;
+        touched.clear();
+    }
+
+    for (auto& q: part) {
+        if (q==unassigned) q = k-1;
+    }
+    return part;
+}
+
+// Greedy k-way refinement: visit every vertex in random order, and move it
+// to the part of one of its neighbours if that reduces the cut without making
+// the part heavier than max_weight. Moves that leave the cut unchanged are
+// made to parts no heavier than the vertex's own, which lets boundaries drift
+// to where later moves reduce the cut. A vertex in a part heavier than max_weight is moved to the
+// neighbouring or lightest part that increases the cut least.
+void refine(const weighted_graph& g, unsigned k, double max_weight, unsigned passes, std::mt19937_64& rng, std::vector<unsigned>& part) {
+    const cell_size_type n = g.size();
+
+    std::vector<double> part_weight(k, 0.);
+    for (cell_size_type v = 0; v<n; ++v) {
+        part_weight[part[v]] += g.vertex_weight[v];
+    }
+    auto lightest = [&]() {
+        return unsigned(std::min_element(part_weight.begin(), part_weight.end())-part_weight.begin());
+    };
+    unsigned light = lightest();
+
+    // Weight of the edges from the current vertex to each part.
+    std::vector<double> conn(k, 0.);
+    std::vector<char> seen(k, 0);
+    std::vector<unsigned> touched;
+
+    std::vector<cell_size_type> order(n);
+    std::iota(order.begin(), order.end(), 0u);
+
+    for (unsigned pass = 0; pass<passes; ++pass) {
+        shuffle(order, rng);
+        bool moved = false;
+        for (auto v: order) {
+            const unsigned p = part[v];
+            const double w = g.vertex_weight[v];
+            const bool overweight = part_weight[p]>max_weight;
+
+            touched.clear();
+            for (auto j = g.offsets[v]; j<g.offsets[v+1]; ++j) {
+                const auto q = part[g.adjacency[j]];
+                if (!seen[q]) {
+                    seen[q] = 1;
+                    touched.push_back(q);
+                }
+                conn[q] += g.edge_weight[j];
+            }
+            if (overweight && !seen[light]) {
+                seen[light] = 1;
+                touched.push_back(light);
+            }
+
+            unsigned best = p;
+            double best_gain = 0;
+            for (auto q: touched) {
+                if (q==p || part_weight[q]+w>max_weight) continue;
+
+                const double gain = conn[q]-conn[p];
+                if (!(overweight || gain>0 || (gain==0 && part_weight[q]<=part_weight[p]))) continue;
+
+                if (best==p || gain>best_gain || (gain==best_gain && part_weight[q]<part_weight[best])) {
+                    best = q;
+                    best_gain = gain;
+                }
+            }
+
+            for (auto q: touched) {
+                seen[q] = 0;
+                conn[q] = 0;
+            }
+
+            if (best!=p) {
+                part[v] = best;
+                part_weight[p] -= w;
+                part_weight[best] += w;
+                moved = true;
+                if (best==light || p==light || part_weight[p]<part_weight[light]) {
+                    light = lightest();
+                }
+            }
+        }
+        if (!moved) break;
+    }
+}
+
+// Amount by which the heaviest part exceeds max_weight.
+double excess_weight(const weighted_graph& g, unsigned k, double max_weight, const std::vector<unsigned>& part) {
+    std::vector<double> part_weight(k, 0.);
+    for (cell_size_type v = 0; v<g.size(); ++v) {
+        part_weight[part[v]] += g.vertex_weight[v];
+    }
+    return std::max(0., *std::max_element(part_weight.begin(), part_weight.end())-max_weight);
+}
+
+} // anonymous namespace
+
+weighted_graph make_weighted_graph(
+    std::vector<double> vertex_weight,
+    const std::vector<std::pair<cell_size_type, cell_size_type>>& edges)
+{
+    const cell_size_type n = vertex_weight.size();
+
+    weighted_graph g;
+    g.vertex_weight = std::move(vertex_weight);
+
+    // Bucket the end points of every edge by vertex, with repeats.
+    std::vector<cell_size_type> degree(n, 0u);
+    for (const auto& e: edges) {
+        arb_assert(e.first<n && e.second<n);
+        if (e.first!=e.second) {
+            ++degree[e.first];
+            ++degree[e.second];
+        }
+    }
+    auto offsets = algorithms::make_index(degree);
+    std::vector<cell_size_type> neighbours(offsets.back());
+    {
+        auto pos = offsets;
+        for (const auto& e: edges) {
+            if (e.first!=e.second) {
+                neighbours[pos[e.first]++] = e.second;
+                neighbours[pos[e.second]++] = e.first;
+            }
+        }
+    }
+
+    // Merge repeated neighbours, counting the repeats.
+    g.offsets.reserve(n+1);
+    for (cell_size_type v = 0; v<n; ++v) {
+        auto b = neighbours.begin()+offsets[v];
+        auto e = neighbours.begin()+offsets[v+1];
+        std::sort(b, e);
+        for (auto i = b; i!=e; ) {
+            auto j = std::find_if(i, e, [i](cell_size_type u) { return u!=*i; });
+            g.adjacency.push_back(*i);
+            g.edge_weight.push_back(j-i);
+            i = j;
+        }
+        g.offsets.push_back(g.adjacency.size());
+    }
+    return g;
+}
+
+std::vector<unsigned> partition_graph(
+    const weighted_graph& g,
+    unsigned k,
+    const graph_partition_options& options)
+{
+    arb_assert(k>0);
+    const cell_size_type n = g.size();
+
+    if (k==1 || n==0) {
+        return std::vector<unsigned>(n, 0u);
+    }
+    if (n<=k) {
+        std::vector<unsigned> part(n);
+        std::iota(part.begin(), part.end(), 0u);
+        return part;
+    }
+
+    // Without any vertex weight, balance the number of vertices.
+    if (total_weight(g)<=0) {
+        weighted_graph unit = g;
+        unit.vertex_weight.assign(n, 1.);
+        return partition_graph(unit, k, options);
+    }
+
+    std::mt19937_64 rng(options.seed);
+
+    // Coarsen. Level i holds the graph contracted from the graph of level
+    // i-1 (or g, for i=0), and the map from the vertices of that graph.
+    struct level {
+        weighted_graph graph;
+        std::vector<cell_size_type> map;
+    };
+    std::vector<level> levels;
+
+    const cell_size_type target = std::max<std::size_t>(std::size_t(options.coarsen_to)*k, k);
+    const double max_vertex_weight = 1.5*total_weight(g)/target;
+    for (;;) {
+        const auto& fine = levels.empty()? g: levels.back().graph;
+        if (fine.size()<=target) break;
+
+        cell_size_type nc = 0;
+        auto cmap = heavy_edge_matching(fine, max_vertex_weight, rng, nc);
+        if (nc>0.95*fine.size()) break;
+
+        auto coarse = contract(fine, cmap, nc);
+        levels.push_back({std::move(coarse), std::move(cmap)});
+    }
+
+    // Initial partition: the best of several grown partitions from
+    // different start vertices, each refined.
+    std::vector<unsigned> part;
+    {
+        const auto& coarsest = levels.empty()? g: levels.back().graph;
+        const double max_weight = max_part_weight(coarsest, k, options.imbalance);
+
+        double best_excess = 0, best_cut = 0;
+        const unsigned trials = std::max(options.initial_trials, 1u);
+        for (unsigned t = 0; t<trials; ++t) {
+            cell_size_type start = t? rng()%coarsest.size(): 0;
+            auto p = grow_partition(coarsest, k, start);
+            refine(coarsest, k, max_weight, options.refine_passes, rng, p);
+
+            const double excess = excess_weight(coarsest, k, max_weight, p);
+            const double cut = edge_cut(coarsest, p);
+            if (part.empty() || excess<best_excess || (excess==best_excess && cut<best_cut)) {
+                part = std::move(p);
+                best_excess = excess;
+                best_cut = cut;
+            }
+        }
+    }
+
+    // Uncoarsen.
+    for (auto i = levels.size(); i>0; --i) {
+        const auto& map = levels[i-1].map;
+        const auto& fine = i>1? levels[i-2].graph: g;
+
+        std::vector<unsigned> fine_part(fine.size());
+        for (cell_size_type v = 0; v<fine.size(); ++v) {
+            fine_part[v] = part[map[v]];
+        }
+        part = std::move(fine_part);
+        refine(fine, k, max_part_weight(fine, k, options.imbalance), options.refine_passes, rng, part);
+    }
+
+    return part;
+}
+
+double edge_cut(const weighted_graph& g, const std::vector<unsigned>& part) {
+    arb_assert(part.size()==g.size());
+
+    double cut = 0;
+    for (cell_size_type v = 0; v<g.size(); ++v) {
+        for (auto j = g.offsets[v]; j<g.offsets[v+1]; ++j) {
+            if (part[v]!=part[g.adjacency[j]]) cut += g.edge_weight[j];
+        }
+    }
+    // Every edge is counted from both ends.
+    return cut/2;
+}
+
+} // namespace arb
@@ -0,0 +1,50 @@
+#pragma once
+
+// Multilevel k-way partitioning of weighted graphs, used to place connected
+// cells on the same domain.
+
+#include <utility>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/load_balance.hpp>
+
+namespace arb {
+
+// Undirected graph with weighted vertices and edges, in compressed sparse
+// row form: the neighbours of vertex i are adjacency[offsets[i]] up to
+// adjacency[offsets[i+1]], with the edge weights in the same positions of
+// edge_weight. Every edge is stored once for each of its end points.
+struct weighted_graph {
+    std::vector<double> vertex_weight;
+    std::vector<cell_size_type> offsets = {0u};
+    std::vector<cell_size_type> adjacency;
+    std::vector<double> edge_weight;
+
+    cell_size_type size() const {
+        return vertex_weight.size();
+    }
+};
+
+// Build the graph with the given vertex weights from a list of directed
+// edges (u, v). The weight of the undirected edge between two vertices is
+// the number of directed edges between them. Self loops are ignored.
+weighted_graph make_weighted_graph(
+    std::vector<double> vertex_weight,
+    const std::vector<std::pair<cell_size_type, cell_size_type>>& edges);
+
+// Partition the vertices of g into k parts, such that the total weight of
+// the edges between parts is small and the vertex weight of every part is
+// at most (1+options.imbalance) times the average, where possible.
+// Returns the part of each vertex.
+//
+// Deterministic: the same graph and options give the same partition.
+std::vector<unsigned> partition_graph(
+    const weighted_graph& g,
+    unsigned k,
+    const graph_partition_options& options = {});
+
+// Total weight of the edges between vertices in different parts.
+double edge_cut(const weighted_graph& g, const std::vector<unsigned>& part);
+
+} // namespace arb
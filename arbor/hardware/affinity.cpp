@@ -1,4 +1,6 @@
 #include <cstdlib>
+#include <fstream>
+#include <string>
 #include <system_error>
 #include <vector>
 
@@ -33,6 +35,69 @@ std::vector<int> get_affinity() {
     return cores;
 }
 
+bool set_affinity(int cpu) {
+    if (cpu<0 || cpu>=CPU_SETSIZE) return false;
+
+    cpu_set_t cpu_set_mask;
+    CPU_ZERO(&cpu_set_mask);
+    CPU_SET(cpu, &cpu_set_mask);
+
+    return !sched_setaffinity(0, sizeof(cpu_set_t), &cpu_set_mask);
+}
+
+bool set_affinity(const std::vector<int>& cpus) {
+    cpu_set_t cpu_set_mask;
+    CPU_ZERO(&cpu_set_mask);
+    for (int cpu: cpus) {
+        if (cpu<0 || cpu>=CPU_SETSIZE) return false;
+        CPU_SET(cpu, &cpu_set_mask);
+    }
+
+    return !cpus.empty() && !sched_setaffinity(0, sizeof(cpu_set_t), &cpu_set_mask);
+}
+
+// Parse a sysfs cpu or node list, e.g. "0-3,8,10-11".
+static std::vector<int> parse_cpu_list(const std::string& s) {
+    std::vector<int> cpus;
+    std::size_t pos = 0;
+    while (pos<s.size()) {
+        auto end = s.find(',', pos);
+        if (end==std::string::npos) end = s.size();
+
+        auto range = s.substr(pos, end-pos);
+        auto dash = range.find('-');
+        int first = std::atoi(range.c_str());
+        int last = dash==std::string::npos? first: std::atoi(range.c_str()+dash+1);
+        for (int i = first; i<=last; ++i) {
+            cpus.push_back(i);
+        }
+        pos = end+1;
+    }
+    return cpus;
+}
+
+std::vector<int> get_numa_nodes(const std::vector<int>& cpus) {
+    std::vector<int> nodes(cpus.size(), 0);
+
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string node_list;
+    if (!(online >> node_list)) return nodes;
+
+    for (int node: parse_cpu_list(node_list)) {
+        std::ifstream f("/sys/devices/system/node/node"+std::to_string(node)+"/cpulist");
+        std::string list;
+        if (!(f >> list)) continue;
+
+        for (auto c: parse_cpu_list(list)) {
+            for (std::size_t i = 0; i<cpus.size(); ++i) {
+                if (cpus[i]==c) nodes[i] = node;
+            }
+        }
+    }
+
+    return nodes;
+}
+
 } // namespace hw
 } // namespace arb
 
@@ -46,6 +111,18 @@ std::vector<int> get_affinity() {
     return {};
 }
 
+bool set_affinity(int) {
+    return false;
+}
+
+bool set_affinity(const std::vector<int>&) {
+    return false;
+}
+
+std::vector<int> get_numa_nodes(const std::vector<int>& cpus) {
+    return std::vector<int>(cpus.size(), 0);
+}
+
 } // namespace hw
 } // namespace arb
 
@@ -17,5 +17,24 @@ namespace hw {
 // available cores.
 std::vector<int> get_affinity();
 
+// Bind the calling thread to the logical processor cpu.
+//
+// Returns false if the affinity could not be set, or if thread binding
+// is not supported on the platform.
+bool set_affinity(int cpu);
+
+// Bind the calling thread to the set of logical processors cpus, e.g. to
+// restore a set returned by get_affinity().
+//
+// Returns false if the affinity could not be set, or if thread binding
+// is not supported on the platform.
+bool set_affinity(const std::vector<int>& cpus);
+
+// The NUMA node of each logical processor in cpus.
+//
+// Processors for which the NUMA node can't be determined, e.g. on systems
+// without NUMA information, are reported as belonging to node 0.
+std::vector<int> get_numa_nodes(const std::vector<int>& cpus);
+
 } // namespace util
 } // namespace arb
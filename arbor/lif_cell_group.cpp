@@ -43,6 +43,28 @@ void lif_cell_group::clear_spikes() {
     spikes_.clear();
 }
 
+void lif_cell_group::checkpoint(checkpoint_writer& out) const {
+    std::vector<double> V_m;
+    V_m.reserve(cells_.size());
+    for (const auto& c: cells_) {
+        V_m.push_back(c.V_m);
+    }
+    out.write_range(V_m);
+    out.write_range(last_time_updated_);
+}
+
+void lif_cell_group::restore(checkpoint_reader& in) {
+    auto V_m = in.read_vector<double>();
+    if (V_m.size()!=cells_.size()) {
+        throw bad_checkpoint("number of LIF cells differs");
+    }
+    for (auto i: util::count_along(cells_)) {
+        cells_[i].V_m = V_m[i];
+    }
+    in.read_into(last_time_updated_);
+    clear_spikes();
+}
+
 // TODO: implement sampler
 void lif_cell_group::add_sampler(sampler_association_handle h, cell_member_predicate probe_ids,
                                     schedule sched, sampler_function fn, sampling_policy policy) {}
@@ -29,6 +29,9 @@ public:
     virtual const std::vector<spike>& spikes() const override;
     virtual void clear_spikes() override;
 
+    virtual void checkpoint(checkpoint_writer&) const override;
+    virtual void restore(checkpoint_reader&) override;
+
     // Sampler association methods below should be thread-safe, as they might be invoked
     // from a sampler call back called from a different cell group running on a different thread.
     virtual void add_sampler(sampler_association_handle, cell_member_predicate, schedule, sampler_function, sampling_policy) override;
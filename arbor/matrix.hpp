@@ -7,6 +7,8 @@
 #include <memory/memory.hpp>
 #include <util/span.hpp>
 
+#include "execution_context.hpp"
+
 namespace arb {
 
 /// Hines matrix
@@ -43,6 +45,21 @@ public:
         arb_assert(cell_index_[num_cells()] == index_type(parent_index_.size()));
     }
 
+    /// As above, with the execution resources that the back end state may
+    /// use to solve the matrix
+    matrix(const std::vector<index_type>& pi,
+           const std::vector<index_type>& ci,
+           const std::vector<value_type>& cv_capacitance,
+           const std::vector<value_type>& face_conductance,
+           const std::vector<value_type>& cv_area,
+           const execution_context& context):
+        parent_index_(pi.begin(), pi.end()),
+        cell_index_(ci.begin(), ci.end()),
+        state_(pi, ci, cv_capacitance, face_conductance, cv_area, context)
+    {
+        arb_assert(cell_index_[num_cells()] == index_type(parent_index_.size()));
+    }
+
     /// the dimension of the matrix (i.e. the number of rows or colums)
     std::size_t size() const {
         return parent_index_.size();
@@ -69,6 +86,12 @@ public:
         state_.assemble(dt_cell, voltage, current);
     }
 
+    /// Assemble the matrix for given dt, solve it, and overwrite the voltage
+    /// with the solution
+    void assemble_and_solve(const array& dt_cell, array& voltage, const array& current) {
+        state_.assemble_and_solve(dt_cell, voltage, current);
+    }
+
     /// Get a view of the solution
     typename State::const_view solution() const {
         return state_.solution();
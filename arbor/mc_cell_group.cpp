@@ -1,7 +1,9 @@
+#include <cstdint>
 #include <functional>
 #include <unordered_map>
 #include <vector>
 
+#include <arbor/arbexcept.hpp>
 #include <arbor/assert.hpp>
 #include <arbor/common_types.hpp>
 #include <arbor/sampling.hpp>
@@ -184,6 +186,25 @@ void mc_cell_group::advance(epoch ep, time_type dt, const event_lane_subrange& e
     }
 }
 
+void mc_cell_group::checkpoint(checkpoint_writer& out) const {
+    out.write<std::uint64_t>(binners_.size());
+    for (auto& b: binners_) {
+        b.checkpoint(out);
+    }
+    lowered_->checkpoint(out);
+}
+
+void mc_cell_group::restore(checkpoint_reader& in) {
+    if (in.read<std::uint64_t>()!=binners_.size()) {
+        throw bad_checkpoint("number of cells differs");
+    }
+    for (auto& b: binners_) {
+        b.restore(in);
+    }
+    lowered_->restore(in);
+    spikes_.clear();
+}
+
 void mc_cell_group::add_sampler(sampler_association_handle h, cell_member_predicate probe_ids,
                                 schedule sched, sampler_function fn, sampling_policy policy)
 {
@@ -50,6 +50,10 @@ public:
         spikes_.clear();
     }
 
+    void checkpoint(checkpoint_writer&) const override;
+
+    void restore(checkpoint_reader&) override;
+
     void add_sampler(sampler_association_handle h, cell_member_predicate probe_ids,
                      schedule sched, sampler_function fn, sampling_policy policy) override;
 
@@ -0,0 +1,274 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <arbor/common_types.hpp>
+#include <arbor/network_file.hpp>
+#include <arbor/recipe.hpp>
+
+#include "util/strprintf.hpp"
+
+namespace arb {
+
+using util::pprintf;
+
+namespace {
+    const char magic[8] = {'a', 'r', 'b', 'o', 'r', 'n', 'e', 't'};
+    constexpr std::uint32_t byte_order_mark = 0x01020304;
+    constexpr std::uint32_t format_version = 1;
+
+    struct file_header {
+        char magic[8];
+        std::uint32_t byte_order;
+        std::uint32_t version;
+        std::uint32_t num_cells;
+        std::uint32_t reserved;
+        std::uint64_t num_connections;
+    };
+
+    static_assert(sizeof(file_header)==32, "unexpected network file header size");
+
+    constexpr cell_size_type num_cell_kinds = 4;
+
+    // Offsets in bytes of the arrays that follow the header. The numbers of
+    // cells and connections may come from an untrusted header, so overflow
+    // of the offsets is flagged instead of wrapping around.
+    struct file_layout {
+        std::size_t kinds, sources, targets, offsets, records, end;
+        bool overflow = false;
+
+        file_layout(std::uint64_t n, std::uint64_t m) {
+            kinds = sizeof(file_header);
+            sources = add_mul(kinds, n, sizeof(std::uint32_t));
+            targets = add_mul(sources, n, sizeof(std::uint32_t));
+            offsets = add_mul(targets, n, sizeof(std::uint32_t));
+            offsets = add_mul(offsets, (8-offsets%8)%8, 1);
+            records = add_mul(offsets, n+1, sizeof(std::uint64_t));
+            end = add_mul(records, m, sizeof(network_connection));
+        }
+
+        // Returns a + k*size, or sets overflow if it is not representable.
+        std::size_t add_mul(std::size_t a, std::uint64_t k, std::size_t size) {
+            const std::uint64_t max = std::numeric_limits<std::size_t>::max();
+            if (overflow || k>(max-a)/size) {
+                overflow = true;
+                return 0;
+            }
+            return a + std::size_t(k)*size;
+        }
+    };
+
+    template <typename T>
+    void write_array(std::ofstream& f, const std::vector<T>& v) {
+        f.write(reinterpret_cast<const char*>(v.data()), v.size()*sizeof(T));
+    }
+}
+
+network_file_error::network_file_error(const std::string& path, const std::string& what):
+    arbor_exception(pprintf("network file {}: {}", path, what)),
+    path(path)
+{}
+
+void write_network_file(const std::string& path, const recipe& rec) {
+    std::ofstream f(path, std::ios::binary|std::ios::trunc);
+    if (!f) {
+        throw network_file_error(path, "unable to open for writing");
+    }
+
+    const cell_size_type n = rec.num_cells();
+    std::vector<std::uint32_t> kinds(n), sources(n), targets(n);
+    for (cell_gid_type gid = 0; gid<n; ++gid) {
+        kinds[gid] = std::uint32_t(rec.get_cell_kind(gid));
+        sources[gid] = rec.num_sources(gid);
+        targets[gid] = rec.num_targets(gid);
+    }
+
+    // The number of connections, and so the offsets, are only known once the
+    // records have been written: write the records in one pass over the
+    // cells, then go back to fill in the header and offsets.
+    file_layout layout(n, 0);
+    std::vector<std::uint64_t> offsets = {0u};
+    offsets.reserve(n+1);
+
+    f.seekp(layout.records);
+    std::vector<network_connection> records;
+    for (cell_gid_type gid = 0; gid<n; ++gid) {
+        records.clear();
+        for (const auto& c: rec.connections_on(gid)) {
+            if (c.dest.gid!=gid) {
+                throw network_file_error(path,
+                    pprintf("connection on gid {} has destination {}", gid, c.dest));
+            }
+            records.push_back({c.source.gid, c.source.index, c.dest.index, c.weight, c.delay});
+        }
+        write_array(f, records);
+        offsets.push_back(offsets.back()+records.size());
+    }
+
+    file_header header;
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.byte_order = byte_order_mark;
+    header.version = format_version;
+    header.num_cells = n;
+    header.reserved = 0;
+    header.num_connections = offsets.back();
+
+    f.seekp(0);
+    f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write_array(f, kinds);
+    write_array(f, sources);
+    write_array(f, targets);
+    f.write("\0\0\0\0\0\0\0", layout.offsets-layout.kinds-3*n*sizeof(std::uint32_t));
+    write_array(f, offsets);
+
+    if (!f.flush()) {
+        throw network_file_error(path, "write failed");
+    }
+}
+
+network_file::network_file(const std::string& path): path_(path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd<0) {
+        throw network_file_error(path, std::strerror(errno));
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st)) {
+        int err = errno;
+        ::close(fd);
+        throw network_file_error(path, std::strerror(err));
+    }
+    if (std::size_t(st.st_size)<sizeof(file_header)) {
+        ::close(fd);
+        throw network_file_error(path, "file too short for header");
+    }
+
+    map_size_ = st.st_size;
+    map_ = ::mmap(nullptr, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+    int err = errno;
+    ::close(fd);
+    if (map_==MAP_FAILED) {
+        map_ = nullptr;
+        throw network_file_error(path, std::strerror(err));
+    }
+
+    // Release the mapping if the contents of the file are invalid.
+    auto fail = [&](const std::string& what) {
+        ::munmap(map_, map_size_);
+        map_ = nullptr;
+        throw network_file_error(path, what);
+    };
+
+    const char* base = static_cast<const char*>(map_);
+    const auto& header = *reinterpret_cast<const file_header*>(base);
+
+    if (std::memcmp(header.magic, magic, sizeof(magic))) {
+        fail("not a network file");
+    }
+    if (header.byte_order!=byte_order_mark) {
+        fail("byte order differs from host");
+    }
+    if (header.version!=format_version) {
+        fail(pprintf("unsupported format version {}", header.version));
+    }
+
+    file_layout layout(header.num_cells, header.num_connections);
+    if (layout.overflow) {
+        fail(pprintf("size of {} cells and {} connections overflows",
+            header.num_cells, header.num_connections));
+    }
+    if (layout.end!=map_size_) {
+        fail(pprintf("expected {} bytes for {} cells and {} connections, file has {}",
+            layout.end, header.num_cells, header.num_connections, map_size_));
+    }
+
+    num_cells_ = header.num_cells;
+    num_connections_ = header.num_connections;
+    kinds_ = reinterpret_cast<const std::uint32_t*>(base+layout.kinds);
+    sources_ = reinterpret_cast<const std::uint32_t*>(base+layout.sources);
+    targets_ = reinterpret_cast<const std::uint32_t*>(base+layout.targets);
+    offsets_ = reinterpret_cast<const std::uint64_t*>(base+layout.offsets);
+    records_ = reinterpret_cast<const network_connection*>(base+layout.records);
+
+    // The kinds and offsets of each cell are checked as they are read, so
+    // that only the pages of the cells that are used are read from disk.
+    if (offsets_[0]!=0 || offsets_[num_cells_]!=num_connections_) {
+        fail("connection offsets do not match number of connections");
+    }
+}
+
+void network_file::check_gid(cell_gid_type gid) const {
+    if (gid>=num_cells_) {
+        throw network_file_error(path_, pprintf("gid {} out of range for {} cells", gid, num_cells_));
+    }
+}
+
+cell_kind network_file::kind(cell_gid_type gid) const {
+    check_gid(gid);
+    if (kinds_[gid]>=num_cell_kinds) {
+        throw network_file_error(path_, pprintf("invalid cell kind {} on gid {}", kinds_[gid], gid));
+    }
+    return cell_kind(kinds_[gid]);
+}
+
+cell_size_type network_file::num_sources(cell_gid_type gid) const {
+    check_gid(gid);
+    return sources_[gid];
+}
+
+cell_size_type network_file::num_targets(cell_gid_type gid) const {
+    check_gid(gid);
+    return targets_[gid];
+}
+
+network_file::connection_range network_file::connections_on(cell_gid_type gid) const {
+    check_gid(gid);
+    auto first = offsets_[gid];
+    auto last = offsets_[gid+1];
+    if (last<first || last>num_connections_) {
+        throw network_file_error(path_, pprintf("invalid connection offsets on gid {}", gid));
+    }
+    return {records_+first, records_+last};
+}
+
+network_file::~network_file() {
+    if (map_) {
+        ::munmap(map_, map_size_);
+    }
+}
+
+network_file::network_file(network_file&& other) noexcept {
+    *this = std::move(other);
+}
+
+network_file& network_file::operator=(network_file&& other) noexcept {
+    if (this!=&other) {
+        if (map_) {
+            ::munmap(map_, map_size_);
+        }
+        path_ = std::move(other.path_);
+        map_ = other.map_;
+        map_size_ = other.map_size_;
+        num_cells_ = other.num_cells_;
+        num_connections_ = other.num_connections_;
+        kinds_ = other.kinds_;
+        sources_ = other.sources_;
+        targets_ = other.targets_;
+        offsets_ = other.offsets_;
+        records_ = other.records_;
+        other.map_ = nullptr;
+    }
+    return *this;
+}
+
+} // namespace arb
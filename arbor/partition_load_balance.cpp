@@ -1,3 +1,12 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
 #include <arbor/domain_decomposition.hpp>
 #include <arbor/load_balance.hpp>
 #include <arbor/recipe.hpp>
@@ -7,54 +16,198 @@
 #include "cell_group_factory.hpp"
 #include "execution_context.hpp"
 #include "gpu_context.hpp"
+#include "graph_partition.hpp"
+#include "threading/threading.hpp"
 #include "util/maputil.hpp"
 #include "util/partition.hpp"
 #include "util/span.hpp"
+#include "util/strprintf.hpp"
 
 namespace arb {
 
-domain_decomposition partition_load_balance(
+// Divide n items into k contiguous parts, the first n%k of which have one
+// more item than the others.
+static std::vector<cell_gid_type> equal_divisions(cell_gid_type n, unsigned k) {
+    std::vector<cell_gid_type> divs(k+1, n);
+    divs[0] = 0;
+
+    const cell_gid_type B = n/k;
+    const cell_gid_type R = n - k*B;
+    for (unsigned j = 1; j<k; ++j) {
+        divs[j] = divs[j-1] + B + (j-1<R);
+    }
+    return divs;
+}
+
+// Clamp the divisions of n items into k parts so that each part is non-empty
+// if there are at least k items.
+static void clamp_divisions(std::vector<cell_gid_type>& divs, cell_gid_type n) {
+    const unsigned k = divs.size()-1;
+    const cell_gid_type min_size = n>=k? 1: 0;
+
+    divs[0] = 0;
+    for (unsigned j = 1; j<k; ++j) {
+        const cell_gid_type lo = divs[j-1] + min_size;
+        const cell_gid_type hi = n - (k-j)*min_size;
+        divs[j] = std::min(std::max(divs[j], lo), hi);
+    }
+    divs[k] = n;
+}
+
+// Index i of the division of prefix, the running sum of a sequence of
+// costs, closest to the target cost: the first at or after the target, or
+// the one before it if that is closer.
+static std::size_t closest_division(const std::vector<double>& prefix, double target) {
+    std::size_t i = std::lower_bound(prefix.begin(), prefix.end(), target) - prefix.begin();
+    if (i==prefix.size()) return i-1;
+    if (i>0 && target-prefix[i-1] < prefix[i]-target) --i;
+    return i;
+}
+
+// Divide a sequence of items with the given costs into k contiguous parts
+// of about equal total cost, returned as k+1 divisions.
+//
+// Each part is non-empty if there are at least k items. If all costs are
+// equal, the parts are given by equal_divisions.
+static std::vector<cell_gid_type> balanced_divisions(const std::vector<double>& cost, unsigned k) {
+    const cell_gid_type n = cost.size();
+
+    const bool uniform = std::all_of(cost.begin(), cost.end(),
+        [&cost](double c) { return c==cost.front(); });
+
+    if (uniform) {
+        return equal_divisions(n, k);
+    }
+
+    std::vector<double> prefix(n+1, 0.);
+    for (cell_gid_type i = 0; i<n; ++i) {
+        prefix[i+1] = prefix[i] + cost[i];
+    }
+    const double total = prefix[n];
+
+    std::vector<cell_gid_type> divs(k+1);
+    for (unsigned j = 1; j<k; ++j) {
+        divs[j] = closest_division(prefix, total*j/k);
+    }
+    clamp_divisions(divs, n);
+    return divs;
+}
+
+// Estimated cost of each of the cells gids, checked to be non-negative and
+// finite.
+template <typename Gids>
+static std::vector<double> estimate_cell_costs(
+    const Gids& gids,
+    const context& ctx,
+    const cell_cost_function& cost)
+{
+    std::vector<double> cell_costs(gids.size());
+    threading::parallel_for::apply(0, gids.size(), ctx->thread_pool.get(),
+        threading::loop_schedule::static_chunks, 4096,
+        [&](std::size_t i) {
+            auto gid = gids[i];
+            double c = cost(gid);
+            if (!(c>=0) || !std::isfinite(c)) {
+                throw arbor_exception(util::pprintf("invalid cost {} for cell {}", c, gid));
+            }
+            cell_costs[i] = c;
+        });
+    return cell_costs;
+}
+
+// The share of the cells of the model for which a domain estimates costs
+// and, in partition_graph_load_balance, builds connection graph edges.
+static util::span<cell_gid_type> cell_share(cell_gid_type num_cells, unsigned num_domains, unsigned domain_id) {
+    return util::make_span(
+        cell_gid_type(std::uint64_t(domain_id)*num_cells/num_domains),
+        cell_gid_type(std::uint64_t(domain_id+1)*num_cells/num_domains));
+}
+
+// Divide the cells of the model over the domains in contiguous blocks of
+// about equal total cost, returned as divisions of the gids.
+//
+// Each domain estimates the costs of its share of the cells, and finds the
+// divisions whose target costs fall in its share, from the total costs of
+// the shares of the domains before it. Only the share totals and the
+// divisions are exchanged.
+static std::vector<cell_gid_type> distributed_balanced_divisions(
     const recipe& rec,
     const context& ctx,
-    partition_hint_map hint_map)
+    const cell_cost_function& cost)
 {
-    const bool gpu_avail = ctx->gpu->has_gpu();
+    const auto& dist = *ctx->distributed;
+    const unsigned num_domains = dist.size();
+    const unsigned domain_id = dist.id();
+    const cell_gid_type num_cells = rec.num_cells();
 
-    struct partition_gid_domain {
-        partition_gid_domain(std::vector<cell_gid_type> divs):
-            gid_divisions(std::move(divs))
-        {}
+    const auto share = cell_share(num_cells, num_domains, domain_id);
+    const auto share_costs = estimate_cell_costs(share, ctx, cost);
 
-        int operator()(cell_gid_type gid) const {
-            auto gid_part = util::partition_view(gid_divisions);
-            return gid_part.index(gid);
-        }
+    // If all cells have the same cost, divide by number.
+    const double inf = std::numeric_limits<double>::infinity();
+    double min_cost = inf, max_cost = -inf;
+    for (auto c: share_costs) {
+        min_cost = std::min(min_cost, c);
+        max_cost = std::max(max_cost, c);
+    }
+    if (dist.min(min_cost)==dist.max(max_cost)) {
+        return equal_divisions(num_cells, num_domains);
+    }
 
-        const std::vector<cell_gid_type> gid_divisions;
-    };
+    // Running sum of the costs of the share, starting from the total cost
+    // of the shares before it. The ends of the shares are taken from the
+    // gathered totals, so that every domain sees the same share boundaries.
+    double share_total = 0;
+    for (auto c: share_costs) share_total += c;
+    auto totals = dist.all_gather(std::vector<double>{share_total});
 
-    using util::make_span;
+    std::vector<double> offsets(num_domains+1, 0.);
+    for (unsigned r = 0; r<num_domains && r<totals.size(); ++r) {
+        offsets[r+1] = offsets[r] + totals[r];
+    }
+    const double total = offsets[num_domains];
+    const double first = offsets[domain_id];
+    const double last = offsets[domain_id+1];
 
-    unsigned num_domains = ctx->distributed->size();
-    unsigned domain_id = ctx->distributed->id();
-    auto num_global_cells = rec.num_cells();
+    std::vector<double> prefix(share_costs.size()+1, first);
+    for (std::size_t i = 0; i<share_costs.size(); ++i) {
+        prefix[i+1] = prefix[i] + share_costs[i];
+    }
+    prefix.back() = last;
 
-    auto dom_size = [&](unsigned dom) -> cell_gid_type {
-        const cell_gid_type B = num_global_cells/num_domains;
-        const cell_gid_type R = num_global_cells - num_domains*B;
-        return B + (dom<R);
-    };
+    std::vector<cell_gid_type> local_divs;
+    for (unsigned j = 1; j<num_domains; ++j) {
+        const double target = total*j/num_domains;
+        if (target>first && target<=last) {
+            local_divs.push_back(share.front() + closest_division(prefix, target));
+        }
+    }
 
-    // Global load balance
+    // Exactly one domain finds each division, and the divisions are
+    // gathered in order of domain.
+    auto gathered = dist.gather_gids(local_divs).values();
 
-    std::vector<cell_gid_type> gid_divisions;
-    auto gid_part = make_partition(
-        gid_divisions, transform_view(make_span(num_domains), dom_size));
+    std::vector<cell_gid_type> divs(num_domains+1, num_cells);
+    for (unsigned j = 1; j<num_domains && j-1<gathered.size(); ++j) {
+        divs[j] = gathered[j-1];
+    }
+    clamp_divisions(divs, num_cells);
+    return divs;
+}
 
-    // Local load balance
+// Divide the cells on the local domain, given in ascending order of gid,
+// into cell groups. Cells without a cost function have the same cost.
+static std::vector<group_description> make_local_groups(
+    const recipe& rec,
+    const context& ctx,
+    const partition_hint_map& hint_map,
+    const std::vector<cell_gid_type>& local_gids,
+    const cell_cost_function& cost)
+{
+    const bool gpu_avail = ctx->gpu->has_gpu();
 
     std::unordered_map<cell_kind, std::vector<cell_gid_type>> kind_lists;
-    for (auto gid: make_span(gid_part[domain_id])) {
+    for (auto gid: local_gids) {
         kind_lists[rec.get_cell_kind(gid)].push_back(gid);
     }
 
@@ -94,33 +247,204 @@ domain_decomposition partition_load_balance(
             group_size = hint.gpu_group_size;
         }
 
-        std::vector<cell_gid_type> group_elements;
-        for (auto gid: kind_lists[k]) {
-            group_elements.push_back(gid);
-            if (group_elements.size()>=group_size) {
+        const auto& gids = kind_lists[k];
+        std::vector<double> kind_costs;
+        if (cost) {
+            kind_costs = estimate_cell_costs(gids, ctx, cost);
+        }
+
+        // If all cells of the kind have the same cost, the groups are
+        // group_size cells long, else the same number of groups are made with
+        // about equal cost.
+        const bool uniform = std::all_of(kind_costs.begin(), kind_costs.end(),
+            [&kind_costs](double c) { return c==kind_costs.front(); });
+
+        if (uniform) {
+            std::vector<cell_gid_type> group_elements;
+            for (auto gid: gids) {
+                group_elements.push_back(gid);
+                if (group_elements.size()>=group_size) {
+                    groups.push_back({k, std::move(group_elements), backend});
+                    group_elements.clear();
+                }
+            }
+            if (!group_elements.empty()) {
                 groups.push_back({k, std::move(group_elements), backend});
-                group_elements.clear();
             }
         }
-        if (!group_elements.empty()) {
-            groups.push_back({k, std::move(group_elements), backend});
+        else {
+            const unsigned num_groups = group_size==partition_hint::max_size?
+                1: (gids.size()+group_size-1)/group_size;
+            auto divs = balanced_divisions(kind_costs, num_groups);
+            for (auto r: util::partition_view(divs)) {
+                groups.push_back({k, std::vector<cell_gid_type>(gids.begin()+r.first, gids.begin()+r.second), backend});
+            }
         }
     }
 
-    // calculate the number of local cells
-    auto rng = gid_part[domain_id];
-    cell_size_type num_local_cells = rng.second - rng.first;
+    return groups;
+}
+
+domain_decomposition partition_load_balance(
+    const recipe& rec,
+    const context& ctx,
+    partition_hint_map hint_map,
+    cell_cost_function cost)
+{
+    struct partition_gid_domain {
+        partition_gid_domain(std::vector<cell_gid_type> divs):
+            gid_divisions(std::move(divs))
+        {}
+
+        int operator()(cell_gid_type gid) const {
+            auto gid_part = util::partition_view(gid_divisions);
+            return gid_part.index(gid);
+        }
+
+        const std::vector<cell_gid_type> gid_divisions;
+    };
+
+    using util::make_span;
+
+    unsigned num_domains = ctx->distributed->size();
+    unsigned domain_id = ctx->distributed->id();
+    auto num_global_cells = rec.num_cells();
+
+    // Global load balance
+
+    std::vector<cell_gid_type> gid_divisions = cost?
+        distributed_balanced_divisions(rec, ctx, cost):
+        equal_divisions(num_global_cells, num_domains);
+    auto gid_part = util::partition_view(gid_divisions);
+
+    // Local load balance
+
+    std::vector<cell_gid_type> local_gids;
+    for (auto gid: make_span(gid_part[domain_id])) {
+        local_gids.push_back(gid);
+    }
 
     domain_decomposition d;
     d.num_domains = num_domains;
     d.domain_id = domain_id;
-    d.num_local_cells = num_local_cells;
+    d.num_local_cells = local_gids.size();
     d.num_global_cells = num_global_cells;
-    d.groups = std::move(groups);
+    d.groups = make_local_groups(rec, ctx, hint_map, local_gids, cost);
     d.gid_domain = partition_gid_domain(std::move(gid_divisions));
 
     return d;
 }
 
-} // namespace arb
+// Cells whose incoming connections are sampled: the fraction f of cells
+// with the lowest hash of the gid.
+static bool sample_cell(cell_gid_type gid, double f, std::uint64_t seed) {
+    if (f>=1) return true;
+
+    // splitmix64 finalizer
+    std::uint64_t z = gid + seed + 0x9e3779b97f4a7c15ull;
+    z = (z^(z>>30))*0xbf58476d1ce4e5b9ull;
+    z = (z^(z>>27))*0x94d049bb133111ebull;
+    z ^= z>>31;
+    return (z>>11)*0x1.0p-53 < f;
+}
 
+domain_decomposition partition_graph_load_balance(
+    const recipe& rec,
+    const context& ctx,
+    partition_hint_map hint_map,
+    graph_partition_options options,
+    cell_cost_function cost)
+{
+    if (!(options.sample_fraction>0 && options.sample_fraction<=1)) {
+        throw arbor_exception(util::pprintf("graph partition: sample fraction {} not in (0, 1]", options.sample_fraction));
+    }
+    if (!(options.imbalance>=0)) {
+        throw arbor_exception(util::pprintf("graph partition: negative imbalance {}", options.imbalance));
+    }
+
+    unsigned num_domains = ctx->distributed->size();
+    unsigned domain_id = ctx->distributed->id();
+    const cell_gid_type num_global_cells = rec.num_cells();
+
+    // Global load balance
+
+    std::vector<int> domains(num_global_cells, 0);
+    if (num_domains>1) {
+        // Each domain builds the edges for an equal share of the cells: the
+        // targets of the sampled connections, which are gathered on all
+        // domains as flat (source, target) pairs. The costs of the cells,
+        // which weight the vertices of the graph, are estimated by share
+        // and gathered likewise.
+        const auto share = cell_share(num_global_cells, num_domains, domain_id);
+        const cell_gid_type lo = share.front();
+        const cell_gid_type hi = lo + share.size();
+
+        std::vector<double> cell_costs;
+        if (cost) {
+            cell_costs = ctx->distributed->all_gather(estimate_cell_costs(share, ctx, cost));
+        }
+        else {
+            cell_costs.assign(num_global_cells, 1.);
+        }
+
+        std::vector<std::vector<cell_gid_type>> sources(hi-lo);
+        threading::parallel_for::apply(lo, hi, ctx->thread_pool.get(),
+            threading::loop_schedule::guided, 1,
+            [&](cell_gid_type gid) {
+                if (!sample_cell(gid, options.sample_fraction, options.seed)) return;
+                for (const auto& c: rec.connections_on(gid)) {
+                    if (c.source.gid>=num_global_cells) {
+                        throw arbor_exception(util::pprintf(
+                            "graph partition: connection on cell {} from cell {} out of range", gid, c.source.gid));
+                    }
+                    sources[gid-lo].push_back(c.source.gid);
+                }
+            });
+
+        std::vector<cell_gid_type> local_edges;
+        for (auto gid: util::make_span(lo, hi)) {
+            for (auto src: sources[gid-lo]) {
+                local_edges.push_back(src);
+                local_edges.push_back(gid);
+            }
+        }
+        sources.clear();
+
+        auto global_edges = ctx->distributed->gather_gids(local_edges);
+        local_edges.clear();
+
+        const auto& flat = global_edges.values();
+        std::vector<std::pair<cell_size_type, cell_size_type>> edges;
+        edges.reserve(flat.size()/2);
+        for (std::size_t i = 0; i+1<flat.size(); i += 2) {
+            edges.emplace_back(flat[i], flat[i+1]);
+        }
+
+        auto g = make_weighted_graph(cell_costs, edges);
+        auto part = partition_graph(g, num_domains, options);
+        std::copy(part.begin(), part.end(), domains.begin());
+    }
+
+    // Local load balance
+
+    std::vector<cell_gid_type> local_gids;
+    for (cell_gid_type gid = 0; gid<num_global_cells; ++gid) {
+        if (domains[gid]==int(domain_id)) {
+            local_gids.push_back(gid);
+        }
+    }
+
+    domain_decomposition d;
+    d.num_domains = num_domains;
+    d.domain_id = domain_id;
+    d.num_local_cells = local_gids.size();
+    d.num_global_cells = num_global_cells;
+    d.groups = make_local_groups(rec, ctx, hint_map, local_gids, cost);
+
+    auto lookup = std::make_shared<const std::vector<int>>(std::move(domains));
+    d.gid_domain = [lookup](cell_gid_type gid) { return (*lookup)[gid]; };
+
+    return d;
+}
+
+} // namespace arb
@@ -1,11 +1,14 @@
+#include <atomic>
 #include <cstdio>
 #include <mutex>
 #include <ostream>
+#include <stdexcept>
 
 #include <arbor/context.hpp>
 #include <arbor/profile/profiler.hpp>
 
 #include "execution_context.hpp"
+#include "profile/profiler_macro.hpp"
 #include "threading/threading.hpp"
 #include "util/span.hpp"
 #include "util/rangeutil.hpp"
@@ -85,7 +88,11 @@ public:
 class profiler {
     std::vector<recorder> recorders_;
 
-    std::unordered_map<std::thread::id, std::size_t> thread_ids_;
+    // The recorder of a thread is found from its index in the task system.
+    // The profiler does not own the task system: the pointer is cleared by
+    // release() when the context made by make_context is destroyed, after
+    // which nothing is recorded until the profiler is initialized again.
+    std::atomic<const threading::task_system*> task_system_{nullptr};
 
     // Hash table that maps region names to a unique index.
     // The regions are assigned consecutive indexes in the order that they are
@@ -100,13 +107,23 @@ class profiler {
     // Used to protect name_index_, which is shared between all threads.
     std::mutex mutex_;
 
-    // Flag to indicate whether the profiler has been initialized with the task_system
-    bool init_ = false;
+    // Return the recorder of the calling thread, or nullptr if the profiler
+    // has no task system.
+    recorder* local_recorder() {
+        auto ts = task_system_.load(std::memory_order_acquire);
+        if (!ts) return nullptr;
+        const int i = ts->thread_index();
+        if (i<0) {
+            throw std::out_of_range("profiler: calling thread is not in the task system");
+        }
+        return &recorders_[i];
+    }
 
 public:
     profiler();
 
     void initialize(task_system_handle& ts);
+    void release(const threading::task_system* ts);
     void enter(region_id_type index);
     void enter(const char* name);
     void leave();
@@ -176,25 +193,27 @@ void recorder::clear() {
 profiler::profiler() {}
 
 void profiler::initialize(task_system_handle& ts) {
-    recorders_.resize(ts.get()->get_num_threads());
-    thread_ids_ = ts.get()->get_thread_ids();
-    init_ = true;
+    recorders_.resize(ts->get_num_threads());
+    task_system_.store(ts.get(), std::memory_order_release);
+}
+
+void profiler::release(const threading::task_system* ts) {
+    const threading::task_system* expected = ts;
+    task_system_.compare_exchange_strong(expected, nullptr);
 }
 
 void profiler::enter(region_id_type index) {
-    if (!init_) return;
-    recorders_[thread_ids_.at(std::this_thread::get_id())].enter(index);
+    if (auto r = local_recorder()) r->enter(index);
 }
 
 void profiler::enter(const char* name) {
-    if (!init_) return;
+    if (!task_system_.load(std::memory_order_acquire)) return;
     const auto index = region_index(name);
-    recorders_[thread_ids_.at(std::this_thread::get_id())].enter(index);
+    if (auto r = local_recorder()) r->enter(index);
 }
 
 void profiler::leave() {
-    if (!init_) return;
-    recorders_[thread_ids_.at(std::this_thread::get_id())].leave();
+    if (auto r = local_recorder()) r->leave();
 }
 
 region_id_type profiler::region_index(const char* name) {
@@ -347,6 +366,10 @@ void profiler_initialize(context& ctx) {
     profiler::get_global_profiler().initialize(ctx->thread_pool);
 }
 
+void profiler_release(const threading::task_system* ts) {
+    profiler::get_global_profiler().release(ts);
+}
+
 // Print profiler statistics to an ostream
 std::ostream& operator<<(std::ostream& o, const profile& prof) {
     char buf[80];
@@ -367,6 +390,7 @@ profile profiler_summary() {
 
 void profiler_leave() {}
 void profiler_enter(region_id_type) {}
+void profiler_release(const threading::task_system*) {}
 profile profiler_summary();
 void profiler_print(const profile& prof, float threshold) {};
 profile profiler_summary() {return profile();}
@@ -2,6 +2,17 @@
 
 #include <arbor/profile/profiler.hpp>
 
+namespace arb {
+namespace threading { class task_system; }
+namespace profile {
+
+// Stop profiling with the task system ts, if the profiler was initialized
+// with it. Called when the context returned by make_context is destroyed.
+void profiler_release(const threading::task_system* ts);
+
+} // namespace profile
+} // namespace arb
+
 #ifdef ARB_HAVE_PROFILING
 
     // enter a profiling region
@@ -1,4 +1,11 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <istream>
 #include <memory>
+#include <ostream>
 #include <set>
 #include <vector>
 
@@ -11,6 +18,7 @@
 
 #include "cell_group.hpp"
 #include "cell_group_factory.hpp"
+#include "checkpoint.hpp"
 #include "communication/communicator.hpp"
 #include "execution_context.hpp"
 #include "merge_events.hpp"
@@ -70,8 +78,26 @@ public:
 
     void set_binning_policy(binning_kind policy, time_type bin_interval);
 
+    void set_spike_exchange_policy(spike_exchange_policy policy) {
+        communicator_.set_exchange_policy(policy);
+    }
+
+    void set_spike_compression(bool compress) {
+        communicator_.set_compression(compress);
+    }
+
+    void set_pairwise_spike_gather(bool pairwise) {
+        communicator_.set_pairwise_gather(pairwise);
+    }
+
     void inject_events(const pse_vector& events);
 
+    void checkpoint(std::ostream& out);
+
+    void wait_checkpoint();
+
+    void restore(std::istream& in);
+
     spike_export_function global_export_callback_;
     spike_export_function local_export_callback_;
 
@@ -89,6 +115,9 @@ private:
 
     time_type t_ = 0.;
     time_type min_delay_;
+
+    // Number of epochs between exchanges of spikes with other domains.
+    unsigned exchange_epochs_ = 1;
     std::vector<cell_group_ptr> cell_groups_;
 
     // one set of event_generators for each local cell
@@ -105,24 +134,45 @@ private:
 
     // Pending events to be delivered.
     std::array<std::vector<pse_vector>, 2> event_lanes_;
+
+    // Events generated by spike exchange or injected, to be merged into the
+    // event lanes. Each list is kept sorted.
     std::vector<pse_vector> pending_events_;
 
+    // The checkpoint being written in the background, if any.
+    std::future<void> checkpoint_write_;
+
     // Sampler associations handles are managed by a helper class.
     util::handle_set<sampler_association_handle> sassoc_handles_;
 
+    // If the threads of the task system are bound to processors, the thread
+    // that constructs and updates each cell group, so that the memory of a
+    // cell group is first touched by, and stays local to, one core.
+    // Empty if threads are not bound.
+    std::vector<int> group_thread_;
+
     // Apply a functional to each cell group in parallel.
     template <typename L>
     void foreach_group(L&& fn) {
-        threading::parallel_for::apply(0, cell_groups_.size(), task_system_.get(),
-            [&, fn = std::forward<L>(fn)](int i) { fn(cell_groups_[i]); });
+        foreach_group_index(
+            [&, fn = std::forward<L>(fn)](cell_group_ptr& group, int) { fn(group); });
     }
 
     // Apply a functional to each cell group in parallel, supplying
     // the cell group pointer reference and index.
     template <typename L>
     void foreach_group_index(L&& fn) {
-        threading::parallel_for::apply(0, cell_groups_.size(), task_system_.get(),
-            [&, fn = std::forward<L>(fn)](int i) { fn(cell_groups_[i], i); });
+        if (group_thread_.empty()) {
+            threading::parallel_for::apply(0, cell_groups_.size(), task_system_.get(),
+                [&, fn = std::forward<L>(fn)](int i) { fn(cell_groups_[i], i); });
+            return;
+        }
+
+        threading::task_group g(task_system_.get());
+        for (std::size_t i = 0; i<cell_groups_.size(); ++i) {
+            g.run_on(group_thread_[i], [&fn, this, i] { fn(cell_groups_[i], i); });
+        }
+        g.wait();
     }
 };
 
@@ -141,6 +191,25 @@ simulation_state::simulation_state(
     // Cache the minimum delay of the network
     min_delay_ = communicator_.min_delay();
 
+    // Spikes are delivered to cells on the same domain every epoch, and sent
+    // to other domains every exchange_epochs_ epochs. A spike generated in
+    // the first of a batch of n epochs is exchanged in the epoch after the
+    // batch, and its events are delivered from the epoch after that, so n+1
+    // epochs of length min_delay_/2 must fit in the minimum delay between
+    // domains. The batch size is capped to bound the number of spikes held
+    // back, and the time before they reach the global spike callback.
+    //
+    // One interval is used for all pairs of domains, from the minimum delay
+    // between any two of them, rather than one per pair of domains: both
+    // exchange policies exchange spikes with a collective operation, in
+    // which every domain takes part at the same epochs.
+    {
+        constexpr unsigned max_exchange_epochs = 64;
+        const double remote_delay = communicator_.min_remote_delay();
+        const double n = std::floor(remote_delay/(min_delay_/2)) - 1;
+        exchange_epochs_ = n>1? unsigned(std::min<double>(n, max_exchange_epochs)): 1u;
+    }
+
     // Initialize empty buffers for pending events for each local cell
     pending_events_.resize(num_local_cells);
 
@@ -157,8 +226,17 @@ simulation_state::simulation_state(
         }
     }
 
+    // Assign contiguous blocks of cell groups to each thread if threads are bound.
+    const auto num_groups = decomp.groups.size();
+    if (!task_system_->bind_cpus().empty()) {
+        const std::size_t num_threads = task_system_->get_num_threads();
+        for (std::size_t i = 0; i<num_groups; ++i) {
+            group_thread_.push_back(i*num_threads/num_groups);
+        }
+    }
+
     // Generate the cell groups in parallel, with one task per cell group.
-    cell_groups_.resize(decomp.groups.size());
+    cell_groups_.resize(num_groups);
     foreach_group_index(
         [&](cell_group_ptr& group, int i) {
             const auto& group_info = decomp.groups[i];
@@ -226,28 +304,72 @@ time_type simulation_state::run(time_type tfinal, time_type dt) {
             });
     };
 
-    // task that performs spike exchange with the spikes generated in
-    // the previous integration period, generating the postsynaptic
-    // events that must be delivered at the start of the next
-    // integration period at the latest.
-    auto exchange = [&] () {
+    // Spikes generated since the last exchange with other domains, when
+    // that is not done every epoch.
+    std::vector<spike> unsent_spikes;
+    unsigned unsent_epochs = 0;
+    bool flush = false;
+
+    // The spikes generated on this domain in the previous integration
+    // period, and the exchange with other domains started for them, if any.
+    // The spikes are gathered, sorted, into the same vector every period,
+    // which is handed over as the send buffer when each period is exchanged.
+    std::vector<spike> local_spikes;
+    spike_exchange remote;
+    bool exchanging = false;
+
+    // Start the exchange of the spikes generated in the previous integration
+    // period as soon as they are available, so that they are in transit
+    // while the cells are updated.
+    auto start_exchange = [&] () {
         PE(communication_exchange_gatherlocal);
-        auto local_spikes = local_spikes_->previous().gather();
+        local_spikes_->previous().gather(local_spikes);
         PL();
-        auto global_spikes = communicator_.exchange(local_spikes);
 
         PE(communication_spikeio);
         if (local_export_callback_) {
             local_export_callback_(local_spikes);
         }
-        if (global_export_callback_) {
-            global_export_callback_(global_spikes.values());
-        }
         PL();
 
-        PE(communication_walkspikes);
-        communicator_.make_event_queues(global_spikes, pending_events_);
-        PL();
+        exchanging = false;
+        if (exchange_epochs_==1) {
+            remote = communicator_.start_exchange(std::move(local_spikes));
+            exchanging = true;
+        }
+        else {
+            unsent_spikes.insert(unsent_spikes.end(), local_spikes.begin(), local_spikes.end());
+            if (++unsent_epochs==exchange_epochs_ || flush) {
+                remote = communicator_.start_exchange(std::move(unsent_spikes));
+                unsent_spikes.clear();
+                unsent_epochs = 0;
+                exchanging = true;
+            }
+        }
+    };
+
+    // task that completes the spike exchange with the spikes generated in
+    // the previous integration period, generating the postsynaptic
+    // events that must be delivered at the start of the next
+    // integration period at the latest.
+    auto exchange = [&] () {
+        // When exchanges with other domains are batched, spikes for cells
+        // on this domain are delivered every integration period, and
+        // skipped when they are exchanged.
+        const bool batched = exchange_epochs_>1;
+        if (batched) {
+            communicator_.make_local_event_queues(local_spikes, pending_events_);
+        }
+
+        if (exchanging) {
+            communicator_.finish_exchange(remote, pending_events_, batched);
+
+            PE(communication_spikeio);
+            if (global_export_callback_) {
+                global_export_callback_(remote.spikes());
+            }
+            PL();
+        }
 
         const auto t0 = epoch_.tfinal;
         const auto t1 = std::min(tfinal, t0+t_interval);
@@ -264,12 +386,21 @@ time_type simulation_state::run(time_type tfinal, time_type dt) {
         // these buffers will store the new spikes generated in update_cells.
         local_spikes_->current().clear();
 
+        start_exchange();
+
         // run the tasks, overlapping if the threading model and number of
-        // available threads permits it.
-        threading::task_group g(task_system_.get());
-        g.run(exchange);
-        g.run(update_cells);
-        g.wait();
+        // available threads permits it. With one thread, the cells are
+        // updated first, while the spikes from other domains are in transit.
+        if (task_system_->get_num_threads()>1) {
+            threading::task_group g(task_system_.get());
+            g.run(exchange);
+            g.run(update_cells);
+            g.wait();
+        }
+        else {
+            update_cells();
+            exchange();
+        }
 
         t_ = tuntil;
 
@@ -279,8 +410,12 @@ time_type simulation_state::run(time_type tfinal, time_type dt) {
 
     // Run the exchange one last time to ensure that all spikes are output to file.
     local_spikes_->exchange();
+    flush = true;
+    start_exchange();
     exchange();
 
+    communicator_.reduce_num_spikes();
+
     return t_;
 }
 
@@ -356,11 +491,8 @@ void merge_cell_events(
 void simulation_state::setup_events(time_type t_from, time_type t_to, std::size_t epoch) {
     const auto n = communicator_.num_local_cells();
     threading::parallel_for::apply(0, n, task_system_.get(),
+        threading::loop_schedule::guided, 1,
         [&](cell_size_type i) {
-            PE(communication_enqueue_sort);
-            util::sort(pending_events_[i]);
-            PL();
-
             event_span pending = util::range_pointer_view(pending_events_[i]);
             event_span old_events = util::range_pointer_view(event_lanes(epoch)[i]);
 
@@ -405,6 +537,7 @@ void simulation_state::set_binning_policy(binning_kind policy, time_type bin_int
 void simulation_state::inject_events(const pse_vector& events) {
     // Push all events that are to be delivered to local cells into the
     // pending event list for the event's target cell.
+    std::vector<cell_size_type> touched;
     for (auto& e: events) {
         if (e.time<t_) {
             throw bad_event_time(e.time, t_);
@@ -412,8 +545,169 @@ void simulation_state::inject_events(const pse_vector& events) {
         // gid_to_local_ maps gid to index into local set of cells.
         if (auto lidx = util::value_by_key(gid_to_local_, e.target.gid)) {
             pending_events_[*lidx].push_back(e);
+            touched.push_back(*lidx);
         }
     }
+
+    // Restore the sort order of the pending event lists that were modified.
+    util::sort(touched);
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+    for (auto i: touched) {
+        util::sort(pending_events_[i]);
+    }
+}
+
+// A checkpoint is a header, followed by the length of the checkpoint data
+// and the data.
+//
+// The data holds the gids of the local cells, the simulation time and epoch,
+// the spike count, the event lanes and pending events of every cell, the
+// local spike buffers, and a block for each cell group written by the cell
+// group, prefixed by its kind.
+// The blocks are written and read in parallel.
+
+namespace {
+    constexpr char checkpoint_magic[8] = {'a', 'r', 'b', 'o', 'r', 'c', 'k', 'p'};
+    constexpr std::uint32_t checkpoint_version = 1;
+}
+
+void simulation_state::checkpoint(std::ostream& out) {
+    wait_checkpoint();
+
+    checkpoint_writer data;
+
+    std::vector<cell_gid_type> gids(gid_to_local_.size());
+    for (const auto& g: gid_to_local_) {
+        gids[g.second] = g.first;
+    }
+    data.write_range(gids);
+
+    data.write(t_);
+    data.write<std::uint64_t>(epoch_.id);
+    data.write(epoch_.tfinal);
+    data.write<std::uint64_t>(communicator_.num_spikes());
+
+    for (auto lanes: {&event_lanes_[0], &event_lanes_[1], &pending_events_}) {
+        for (const auto& lane: *lanes) {
+            data.write_range(lane);
+        }
+    }
+
+    // Spikes in the local buffers are sent again at the start of the next
+    // call to run().
+    for (auto buffer: {&local_spikes_->current(), &local_spikes_->previous()}) {
+        data.write_range(buffer->gather());
+    }
+
+    std::vector<checkpoint_writer> blocks(cell_groups_.size());
+    foreach_group_index(
+        [&](cell_group_ptr& group, int i) {
+            blocks[i].write(group->get_cell_kind());
+            group->checkpoint(blocks[i]);
+        });
+
+    data.write<std::uint64_t>(blocks.size());
+    for (const auto& b: blocks) {
+        data.write_block(b);
+    }
+
+    // Write the checkpoint while the simulation continues: out is only
+    // accessed by the writing thread until wait_checkpoint() returns.
+    checkpoint_write_ = std::async(std::launch::async,
+        [&out, payload = std::move(data.data())]() {
+            checkpoint_writer header;
+            header.write(checkpoint_magic);
+            header.write(checkpoint_version);
+            header.write<std::uint64_t>(payload.size());
+
+            out.write(header.data().data(), header.data().size());
+            out.write(payload.data(), payload.size());
+            if (!out.flush()) {
+                throw bad_checkpoint("unable to write checkpoint");
+            }
+        });
+}
+
+void simulation_state::wait_checkpoint() {
+    if (checkpoint_write_.valid()) {
+        checkpoint_write_.get();
+    }
+}
+
+void simulation_state::restore(std::istream& in) {
+    wait_checkpoint();
+
+    // Read the header and data.
+    char header[sizeof(checkpoint_magic)+sizeof(checkpoint_version)+sizeof(std::uint64_t)];
+    if (!in.read(header, sizeof(header))) {
+        throw bad_checkpoint("unable to read header");
+    }
+    checkpoint_reader h(header, header+sizeof(header));
+    auto magic = h.read<std::array<char, sizeof(checkpoint_magic)>>();
+    if (!std::equal(magic.begin(), magic.end(), checkpoint_magic)) {
+        throw bad_checkpoint("not an arbor checkpoint");
+    }
+    if (h.read<std::uint32_t>()!=checkpoint_version) {
+        throw bad_checkpoint("unsupported checkpoint version");
+    }
+    std::vector<char> buffer(h.read<std::uint64_t>());
+    if (!in.read(buffer.data(), buffer.size())) {
+        throw bad_checkpoint("unexpected end of checkpoint");
+    }
+    checkpoint_reader data(buffer.data(), buffer.data()+buffer.size());
+
+    auto gids = data.read_vector<cell_gid_type>();
+    if (gids.size()!=gid_to_local_.size()) {
+        throw bad_checkpoint("number of local cells differs");
+    }
+    for (auto i: util::count_along(gids)) {
+        auto lidx = util::value_by_key(gid_to_local_, gids[i]);
+        if (!lidx || *lidx!=i) {
+            throw bad_checkpoint(util::pprintf("local cell {} differs", i));
+        }
+    }
+
+    data.read(t_);
+    epoch_.id = data.read<std::uint64_t>();
+    data.read(epoch_.tfinal);
+    communicator_.set_num_spikes(data.read<std::uint64_t>());
+
+    for (auto lanes: {&event_lanes_[0], &event_lanes_[1], &pending_events_}) {
+        for (auto& lane: *lanes) {
+            lane = data.read_vector<spike_event>();
+        }
+    }
+
+    for (auto buffer: {&local_spikes_->current(), &local_spikes_->previous()}) {
+        buffer->clear();
+        buffer->insert(data.read_vector<spike>());
+    }
+
+    if (data.read<std::uint64_t>()!=cell_groups_.size()) {
+        throw bad_checkpoint("number of cell groups differs");
+    }
+    std::vector<checkpoint_reader> blocks;
+    for (std::size_t i = 0; i<cell_groups_.size(); ++i) {
+        blocks.push_back(data.read_block());
+    }
+    if (!data.done()) {
+        throw bad_checkpoint("unexpected data at end of checkpoint");
+    }
+
+    foreach_group_index(
+        [&](cell_group_ptr& group, int i) {
+            if (blocks[i].read<cell_kind>()!=group->get_cell_kind()) {
+                throw bad_checkpoint(util::pprintf("kind of cell group {} differs", i));
+            }
+            group->restore(blocks[i]);
+        });
+
+    for (auto& lane: event_generators_) {
+        for (auto& gen: lane) {
+            fast_forward(gen, t_);
+        }
+    }
+
 }
 
 // Simulation class implementations forward to implementation class.
@@ -459,6 +753,18 @@ void simulation::set_binning_policy(binning_kind policy, time_type bin_interval)
     impl_->set_binning_policy(policy, bin_interval);
 }
 
+void simulation::set_spike_exchange_policy(spike_exchange_policy policy) {
+    impl_->set_spike_exchange_policy(policy);
+}
+
+void simulation::set_spike_compression(bool compress) {
+    impl_->set_spike_compression(compress);
+}
+
+void simulation::set_pairwise_spike_gather(bool pairwise) {
+    impl_->set_pairwise_spike_gather(pairwise);
+}
+
 void simulation::set_global_spike_callback(spike_export_function export_callback) {
     impl_->global_export_callback_ = std::move(export_callback);
 }
@@ -471,6 +777,18 @@ void simulation::inject_events(const pse_vector& events) {
     impl_->inject_events(events);
 }
 
+void simulation::checkpoint(std::ostream& out) {
+    impl_->checkpoint(out);
+}
+
+void simulation::wait_checkpoint() {
+    impl_->wait_checkpoint();
+}
+
+void simulation::restore(std::istream& in) {
+    impl_->restore(in);
+}
+
 simulation::~simulation() = default;
 
 } // namespace arb
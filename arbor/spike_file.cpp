@@ -0,0 +1,367 @@
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <arbor/spike.hpp>
+#include <arbor/spike_file.hpp>
+
+#include "util/strprintf.hpp"
+
+namespace arb {
+
+using util::pprintf;
+
+namespace {
+    const char magic[8] = {'a', 'r', 'b', 'o', 'r', 's', 'p', 'k'};
+    const char index_magic[8] = {'a', 'r', 'b', 's', 'p', 'i', 'd', 'x'};
+    constexpr std::uint32_t byte_order_mark = 0x01020304;
+    constexpr std::uint32_t format_version = 1;
+
+    struct file_header {
+        char magic[8];
+        std::uint32_t byte_order;
+        std::uint32_t version;
+        std::uint32_t domain;
+        std::uint32_t reserved;
+    };
+
+    struct block_header {
+        std::uint64_t num_spikes;
+        float t_min;
+        float t_max;
+    };
+
+    struct file_trailer {
+        std::uint64_t num_blocks;
+        std::uint64_t num_spikes;
+        char magic[8];
+    };
+
+    static_assert(sizeof(file_header)==24, "unexpected spike file header size");
+    static_assert(sizeof(block_header)==16, "unexpected spike block header size");
+    static_assert(sizeof(file_trailer)==24, "unexpected spike file trailer size");
+
+    template <typename T>
+    void write_array(std::ofstream& f, const T* p, std::size_t n) {
+        f.write(reinterpret_cast<const char*>(p), n*sizeof(T));
+    }
+
+    template <typename T>
+    bool read_array(std::ifstream& f, T* p, std::size_t n) {
+        return bool(f.read(reinterpret_cast<char*>(p), n*sizeof(T)));
+    }
+}
+
+spike_file_error::spike_file_error(const std::string& path, const std::string& what):
+    arbor_exception(pprintf("spike file {}: {}", path, what)),
+    path(path)
+{}
+
+// The recorder fills the active buffer. When it is full, it waits for the
+// writer thread to finish with the other buffer, exchanges the two, and
+// hands the full buffer to the writer thread.
+
+struct spike_recorder::impl {
+    std::string path;
+    std::ofstream file;
+    std::size_t buffer_size;
+
+    // Accessed only by the recording thread.
+    std::vector<spike_record> active;
+    std::uint64_t num_spikes = 0;
+    bool closed = false;
+
+    // Guarded by mutex while the writer thread is running.
+    std::vector<spike_record> writing;
+    bool pending = false;           // writing holds spikes to be written.
+    bool stop = false;
+    std::exception_ptr error;
+
+    // Accessed only by the writer thread, until it is joined.
+    std::uint64_t offset = sizeof(file_header);
+    std::vector<spike_block_index> index;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread writer;
+
+    impl(const std::string& path, unsigned domain, std::size_t buffer_size):
+        path(path),
+        file(path, std::ios::binary|std::ios::trunc),
+        buffer_size(std::max<std::size_t>(buffer_size, 1))
+    {
+        if (!file) {
+            throw spike_file_error(path, "unable to open for writing");
+        }
+
+        file_header header;
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.byte_order = byte_order_mark;
+        header.version = format_version;
+        header.domain = domain;
+        header.reserved = 0;
+        write_array(file, &header, 1);
+
+        active.reserve(this->buffer_size);
+        writing.reserve(this->buffer_size);
+
+        writer = std::thread([this] { write_loop(); });
+    }
+
+    void write_loop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            cv.wait(lock, [this] { return pending || stop; });
+            if (!pending) {
+                return;
+            }
+
+            lock.unlock();
+            std::exception_ptr e;
+            try {
+                write_block(writing);
+            }
+            catch (...) {
+                e = std::current_exception();
+            }
+            lock.lock();
+
+            if (e && !error) {
+                error = e;
+            }
+            writing.clear();
+            pending = false;
+            cv.notify_all();
+        }
+    }
+
+    void write_block(const std::vector<spike_record>& spikes) {
+        block_header header;
+        header.num_spikes = spikes.size();
+        auto t = std::minmax_element(spikes.begin(), spikes.end(),
+            [](const spike_record& a, const spike_record& b) { return a.time<b.time; });
+        header.t_min = t.first->time;
+        header.t_max = t.second->time;
+
+        write_array(file, &header, 1);
+        write_array(file, spikes.data(), spikes.size());
+        if (!file) {
+            throw spike_file_error(path, "write failed");
+        }
+
+        index.push_back({offset, header.num_spikes, header.t_min, header.t_max});
+        offset += sizeof(block_header)+spikes.size()*sizeof(spike_record);
+    }
+
+    // Wait until the writer thread has finished with its buffer, reporting
+    // any error it encountered.
+    void wait(std::unique_lock<std::mutex>& lock) {
+        cv.wait(lock, [this] { return !pending; });
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    void hand_over() {
+        std::unique_lock<std::mutex> lock(mutex);
+        wait(lock);
+        std::swap(active, writing);
+        pending = true;
+        cv.notify_all();
+    }
+
+    void record(const std::vector<spike>& spikes) {
+        if (closed) {
+            throw spike_file_error(path, "recorder is closed");
+        }
+        for (const auto& s: spikes) {
+            active.push_back({s.source.gid, s.source.index, s.time});
+            if (active.size()==buffer_size) {
+                hand_over();
+            }
+        }
+        num_spikes += spikes.size();
+    }
+
+    void flush() {
+        if (closed) return;
+        if (!active.empty()) {
+            hand_over();
+        }
+        // The writer thread is idle until the next hand over.
+        std::unique_lock<std::mutex> lock(mutex);
+        wait(lock);
+        if (!file.flush()) {
+            throw spike_file_error(path, "write failed");
+        }
+    }
+
+    void close() {
+        if (closed) return;
+        closed = true;
+
+        // Stop the writer thread even if a block could not be written.
+        std::exception_ptr e;
+        try {
+            if (!active.empty()) {
+                hand_over();
+            }
+        }
+        catch (...) {
+            e = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+            cv.notify_all();
+        }
+        writer.join();
+        if (e || (e = error)) {
+            file.close();
+            std::rethrow_exception(e);
+        }
+
+        file_trailer trailer;
+        trailer.num_blocks = index.size();
+        trailer.num_spikes = num_spikes;
+        std::memcpy(trailer.magic, index_magic, sizeof(index_magic));
+
+        write_array(file, index.data(), index.size());
+        write_array(file, &trailer, 1);
+        file.close();
+        if (!file) {
+            throw spike_file_error(path, "write failed");
+        }
+    }
+};
+
+spike_recorder::spike_recorder(const std::string& path, unsigned domain, std::size_t buffer_size):
+    impl_(new impl(path, domain, buffer_size))
+{}
+
+spike_recorder::~spike_recorder() {
+    try {
+        impl_->close();
+    }
+    catch (...) {}
+}
+
+void spike_recorder::operator()(const std::vector<spike>& spikes) {
+    impl_->record(spikes);
+}
+
+void spike_recorder::flush() {
+    impl_->flush();
+}
+
+void spike_recorder::close() {
+    impl_->close();
+}
+
+std::uint64_t spike_recorder::num_spikes() const {
+    return impl_->num_spikes;
+}
+
+spike_file::spike_file(const std::string& path): path_(path) {
+    std::ifstream f(path, std::ios::binary|std::ios::ate);
+    if (!f) {
+        throw spike_file_error(path, "unable to open for reading");
+    }
+    const std::uint64_t size = f.tellg();
+    f.seekg(0);
+
+    file_header header;
+    if (size<sizeof(header) || !read_array(f, &header, 1)) {
+        throw spike_file_error(path, "file too short for header");
+    }
+    if (std::memcmp(header.magic, magic, sizeof(magic))) {
+        throw spike_file_error(path, "not a spike file");
+    }
+    if (header.byte_order!=byte_order_mark) {
+        throw spike_file_error(path, "byte order differs from host");
+    }
+    if (header.version!=format_version) {
+        throw spike_file_error(path, pprintf("unsupported format version {}", header.version));
+    }
+    domain_ = header.domain;
+
+    // Use the index of a file that was closed by the recorder.
+    file_trailer trailer;
+    if (size>=sizeof(header)+sizeof(trailer)) {
+        f.seekg(size-sizeof(trailer));
+        if (read_array(f, &trailer, 1) && !std::memcmp(trailer.magic, index_magic, sizeof(index_magic)) &&
+            trailer.num_blocks<=(size-sizeof(header)-sizeof(trailer))/sizeof(spike_block_index))
+        {
+            blocks_.resize(trailer.num_blocks);
+            f.seekg(size-sizeof(trailer)-blocks_.size()*sizeof(spike_block_index));
+            if (!read_array(f, blocks_.data(), blocks_.size())) {
+                throw spike_file_error(path, "unable to read index");
+            }
+            for (auto& b: blocks_) {
+                num_spikes_ += b.num_spikes;
+            }
+            if (num_spikes_!=trailer.num_spikes) {
+                throw spike_file_error(path,
+                    pprintf("index has {} spikes, expected {}", num_spikes_, trailer.num_spikes));
+            }
+            complete_ = true;
+            return;
+        }
+    }
+
+    // Otherwise read the block headers in turn, up to the last complete
+    // block.
+    f.clear();
+    std::uint64_t offset = sizeof(header);
+    block_header block;
+    while (offset+sizeof(block)<=size) {
+        f.seekg(offset);
+        if (!read_array(f, &block, 1)) break;
+
+        auto end = offset+sizeof(block);
+        if (block.num_spikes>(size-end)/sizeof(spike_record)) break;
+
+        blocks_.push_back({offset, block.num_spikes, block.t_min, block.t_max});
+        num_spikes_ += block.num_spikes;
+        offset = end+block.num_spikes*sizeof(spike_record);
+    }
+}
+
+std::vector<spike> spike_file::spikes() const {
+    return spikes(-terminal_time, terminal_time);
+}
+
+std::vector<spike> spike_file::spikes(time_type t0, time_type t1) const {
+    std::ifstream f(path_, std::ios::binary);
+    if (!f) {
+        throw spike_file_error(path_, "unable to open for reading");
+    }
+
+    std::vector<spike> spikes;
+    std::vector<spike_record> records;
+    for (const auto& b: blocks_) {
+        if (b.t_max<t0 || b.t_min>=t1) continue;
+
+        records.resize(b.num_spikes);
+        f.seekg(b.offset+sizeof(block_header));
+        if (!read_array(f, records.data(), records.size())) {
+            throw spike_file_error(path_, pprintf("unable to read block at offset {}", b.offset));
+        }
+        for (const auto& r: records) {
+            if (r.time>=t0 && r.time<t1) {
+                spikes.push_back({{r.gid, r.index}, r.time});
+            }
+        }
+    }
+    return spikes;
+}
+
+} // namespace arb
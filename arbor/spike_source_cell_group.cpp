@@ -62,6 +62,18 @@ void spike_source_cell_group::clear_spikes() {
     spikes_.clear();
 }
 
+void spike_source_cell_group::checkpoint(checkpoint_writer& out) const {
+    out.write(t_);
+}
+
+void spike_source_cell_group::restore(checkpoint_reader& in) {
+    in.read(t_);
+    clear_spikes();
+    for (auto& s: time_sequences_) {
+        fast_forward(s, t_);
+    }
+}
+
 void spike_source_cell_group::add_sampler(sampler_association_handle, cell_member_predicate, schedule, sampler_function, sampling_policy) {
     std::logic_error("A spike_source_cell group doen't support sampling of internal state!");
 }
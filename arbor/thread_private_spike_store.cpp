@@ -1,18 +1,50 @@
+#include <algorithm>
 #include <vector>
 
+#include <arbor/arbexcept.hpp>
 #include <arbor/common_types.hpp>
 #include <arbor/spike.hpp>
 
-#include "threading/enumerable_thread_specific.hpp"
 #include "threading/threading.hpp"
 #include "thread_private_spike_store.hpp"
+#include "util/padded_alloc.hpp"
 
 namespace arb {
 
+namespace {
+    constexpr std::size_t cache_line_size = 64;
+
+    bool spike_less(const spike& a, const spike& b) {
+        return a.source<b.source || (a.source==b.source && a.time<b.time);
+    }
+}
+
 struct local_spike_store_type {
-    threading::enumerable_thread_specific<std::vector<spike>> buffers_;
+    // Each buffer is on its own cache lines, so that threads that add spikes
+    // to their buffers do not write to cache lines shared with others.
+    struct alignas(cache_line_size) padded_buffer {
+        std::vector<spike> spikes;
+        // End of each sorted run of spikes added by insert().
+        std::vector<std::size_t> run_ends;
+    };
+
+    task_system_handle task_system_;
+    std::vector<padded_buffer, util::padded_allocator<padded_buffer>> buffers_;
 
-    local_spike_store_type(const task_system_handle& ts): buffers_(ts) {};
+    local_spike_store_type(const task_system_handle& ts):
+        task_system_(ts),
+        buffers_(ts->get_num_threads(), util::padded_allocator<padded_buffer>(cache_line_size))
+    {}
+
+    // The buffer of the calling thread, found from the thread's index in the
+    // task system, which is a thread local variable.
+    padded_buffer& local() {
+        const int i = task_system_->thread_index();
+        if (i<0) {
+            throw arbor_internal_error("thread_private_spike_store: calling thread is not in the task system");
+        }
+        return buffers_[i];
+    }
 };
 
 thread_private_spike_store::thread_private_spike_store(thread_private_spike_store&& t):
@@ -27,26 +59,76 @@ thread_private_spike_store::~thread_private_spike_store() {}
 
 std::vector<spike> thread_private_spike_store::gather() const {
     std::vector<spike> spikes;
-    unsigned num_spikes = 0u;
+    gather(spikes);
+    return spikes;
+}
+
+void thread_private_spike_store::gather(std::vector<spike>& spikes) const {
+    // The sorted runs of all buffers are merged with a heap of the next spike
+    // of each non-empty run, in one pass over the spikes. Spikes added to a
+    // buffer with get() after the last insert() form one more run.
+    using run = std::pair<const spike*, const spike*>;
+    std::vector<run> runs;
+    std::size_t num_spikes = 0;
     for (auto& b: impl_->buffers_) {
-        num_spikes += b.size();
+        const spike* data = b.spikes.data();
+        std::size_t begin = 0;
+        for (auto end: b.run_ends) {
+            end = std::min(end, b.spikes.size());
+            if (end>begin) runs.push_back({data+begin, data+end});
+            begin = end;
+        }
+        if (b.spikes.size()>begin) {
+            runs.push_back({data+begin, data+b.spikes.size()});
+        }
+        num_spikes += b.spikes.size();
     }
+
+    spikes.clear();
     spikes.reserve(num_spikes);
 
-    for (auto& b: impl_->buffers_) {
-        spikes.insert(spikes.begin(), b.begin(), b.end());
+    auto later = [](const run& a, const run& b) { return spike_less(*b.first, *a.first); };
+    std::make_heap(runs.begin(), runs.end(), later);
+    while (runs.size()>1) {
+        std::pop_heap(runs.begin(), runs.end(), later);
+        auto& r = runs.back();
+        spikes.push_back(*r.first++);
+        if (r.first==r.second) {
+            runs.pop_back();
+        }
+        else {
+            std::push_heap(runs.begin(), runs.end(), later);
+        }
+    }
+    if (!runs.empty()) {
+        spikes.insert(spikes.end(), runs.front().first, runs.front().second);
     }
-
-    return spikes;
 }
 
 std::vector<spike>& thread_private_spike_store::get() {
-    return impl_->buffers_.local();
+    return impl_->local().spikes;
 }
 
 void thread_private_spike_store::clear() {
     for (auto& b: impl_->buffers_) {
-        b.clear();
+        b.spikes.clear();
+        b.run_ends.clear();
     }
 }
+
+void thread_private_spike_store::insert(const std::vector<spike>& spikes) {
+    // Sort the new spikes here, in parallel with the other threads, and
+    // append them to the buffer as a run: the runs are merged once, in
+    // gather(), so that the cost of an insert does not grow with the number
+    // of spikes already in the buffer.
+    auto& b = impl_->local();
+    auto n = b.spikes.size();
+    b.spikes.insert(b.spikes.end(), spikes.begin(), spikes.end());
+    auto first = b.spikes.begin()+n;
+    if (!std::is_sorted(first, b.spikes.end(), spike_less)) {
+        std::sort(first, b.spikes.end(), spike_less);
+    }
+    b.run_ends.push_back(b.spikes.size());
+}
+
 } // namespace arb
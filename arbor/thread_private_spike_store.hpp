@@ -18,6 +18,10 @@ struct local_spike_store_type;
 /// The thread private buffer of the calling thread.
 /// The insert() and gather() methods add a vector of spikes to the buffer,
 /// and collate all of the buffers into a single vector respectively.
+///
+/// Each call to insert() appends a run of spikes to the buffer, sorted by
+/// source, and spikes with the same source by time, and gather() merges the
+/// runs of all buffers into a sorted vector.
 class thread_private_spike_store {
 public :
     thread_private_spike_store();
@@ -26,22 +30,24 @@ public :
     thread_private_spike_store(thread_private_spike_store&& t);
     thread_private_spike_store(const task_system_handle& ts);
 
-    /// Collate all of the individual buffers into a single vector of spikes.
-    /// Does not modify the buffer contents.
+    /// Collate all of the individual buffers into a single vector of spikes,
+    /// sorted by source and time. Does not modify the buffer contents.
     std::vector<spike> gather() const;
 
-    /// Return a reference to the thread private buffer of the calling thread
+    /// As above, replacing the contents of spikes, so that its storage can
+    /// be reused from one call to the next.
+    void gather(std::vector<spike>& spikes) const;
+
+    /// Return a reference to the thread private buffer of the calling thread.
+    /// Spikes added directly after the last call to insert() must be sorted.
     std::vector<spike>& get();
 
     /// Clear all of the thread private buffers
     void clear();
 
-    /// Append the passed spikes to the end of the thread private buffer of the
-    /// calling thread
-    void insert(const std::vector<spike>& spikes) {
-        auto& buff = get();
-        buff.insert(buff.end(), spikes.begin(), spikes.end());
-    }
+    /// Add the passed spikes to the thread private buffer of the calling
+    /// thread.
+    void insert(const std::vector<spike>& spikes);
 
 private :
     /// thread private storage for accumulating spikes
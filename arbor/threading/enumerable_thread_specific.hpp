@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdexcept>
 #include <vector>
 
 #include "threading.hpp"
@@ -7,32 +8,45 @@
 namespace arb {
 namespace threading {
 
+// One value of T for each thread of a task system.
+//
+// local() returns the value of the calling thread, which is found from the
+// index of the thread in the task system, and throws std::out_of_range if the
+// calling thread is not one of its threads.
 template <typename T>
 class enumerable_thread_specific {
-    std::unordered_map<std::thread::id, std::size_t> thread_ids_;
+    task_system_handle task_system_;
 
     using storage_class = std::vector<T>;
     storage_class data;
 
+    std::size_t local_index() const {
+        const int i = task_system_->thread_index();
+        if (i<0) {
+            throw std::out_of_range("enumerable_thread_specific: calling thread is not in the task system");
+        }
+        return i;
+    }
+
 public:
     using iterator = typename storage_class::iterator;
     using const_iterator = typename storage_class::const_iterator;
 
     enumerable_thread_specific(const task_system_handle& ts):
-        thread_ids_{ts->get_thread_ids()},
+        task_system_{ts},
         data{std::vector<T>(ts->get_num_threads())}
     {}
 
     enumerable_thread_specific(const T& init, const task_system_handle& ts):
-        thread_ids_{ts->get_thread_ids()},
+        task_system_{ts},
         data{std::vector<T>(ts->get_num_threads(), init)}
     {}
 
     T& local() {
-        return data[thread_ids_.at(std::this_thread::get_id())];
+        return data[local_index()];
     }
     const T& local() const {
-        return data[thread_ids_.at(std::this_thread::get_id())];
+        return data[local_index()];
     }
 
     auto size() const { return data.size(); }
@@ -1,10 +1,15 @@
+#include <algorithm>
 #include <cstdlib>
 #include <exception>
+#include <map>
 #include <regex>
 #include <string>
+#include <vector>
 
 #include <arbor/arbexcept.hpp>
+#include <arbor/context.hpp>
 #include <arbor/util/optional.hpp>
+#include <hardware/affinity.hpp>
 #include <hardware/node_info.hpp>
 
 #include "thread_info.hpp"
@@ -73,5 +78,72 @@ std::size_t num_threads_init() {
     return n? n: 1;
 }
 
+std::vector<int> thread_binding_cpus(
+    thread_binding binding,
+    unsigned nthreads,
+    const std::vector<int>& available,
+    const std::vector<int>& numa_nodes,
+    const std::vector<int>& cpu_list)
+{
+    std::vector<int> cpus;
+
+    switch (binding) {
+    case thread_binding::none:
+        break;
+    case thread_binding::compact:
+        if (available.empty()) break;
+        for (unsigned i = 0; i<nthreads; ++i) {
+            cpus.push_back(available[i%available.size()]);
+        }
+        break;
+    case thread_binding::scatter: {
+        if (available.empty()) break;
+
+        // Order the processors by taking one from each NUMA node in turn.
+        std::map<int, std::vector<int>> by_node;
+        for (std::size_t i = 0; i<available.size(); ++i) {
+            by_node[i<numa_nodes.size()? numa_nodes[i]: 0].push_back(available[i]);
+        }
+
+        std::vector<int> order;
+        for (std::size_t k = 0; order.size()<available.size(); ++k) {
+            for (auto& n: by_node) {
+                if (k<n.second.size()) order.push_back(n.second[k]);
+            }
+        }
+        for (unsigned i = 0; i<nthreads; ++i) {
+            cpus.push_back(order[i%order.size()]);
+        }
+        break;
+    }
+    case thread_binding::list:
+        if (cpu_list.size()<nthreads) {
+            throw arbor_exception(util::pprintf(
+                "thread binding list has {} processors for {} threads", cpu_list.size(), nthreads));
+        }
+        for (unsigned i = 0; i<nthreads; ++i) {
+            auto c = cpu_list[i];
+            if (!available.empty() && std::find(available.begin(), available.end(), c)==available.end()) {
+                throw arbor_exception(util::pprintf(
+                    "thread binding processor {} is not available", c));
+            }
+            cpus.push_back(c);
+        }
+        break;
+    }
+
+    return cpus;
+}
+
+std::vector<int> thread_binding_cpus(const proc_allocation& resources) {
+    if (resources.binding==thread_binding::none) return {};
+
+    // Query the available processors once, before any thread is bound.
+    static const auto available = hw::get_affinity();
+    return thread_binding_cpus(
+        resources.binding, resources.num_threads,
+        available, hw::get_numa_nodes(available), resources.bind_cpus);
+}
+
 } // namespace threading
 } // namespace arb
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <vector>
+
+#include <arbor/context.hpp>
 #include <arbor/util/optional.hpp>
 
 namespace arb {
@@ -22,5 +25,28 @@ util::optional<size_t> get_env_num_threads();
 
 size_t num_threads_init();
 
+// The logical processor to which each of nthreads threads is to be bound.
+//
+// Processors are chosen from the available list, with numa_nodes giving the
+// NUMA node of each available processor. Processors are reused round robin
+// if there are more threads than processors. For thread_binding::list, the
+// processors are taken from cpu_list.
+//
+// Returns an empty vector if threads are not to be bound, or if the
+// available processors are unknown.
+//
+// Throws arbor_exception:
+//      cpu_list has fewer entries than threads, or a processor not in
+//      the available list.
+std::vector<int> thread_binding_cpus(
+    thread_binding binding,
+    unsigned nthreads,
+    const std::vector<int>& available,
+    const std::vector<int>& numa_nodes,
+    const std::vector<int>& cpu_list);
+
+// As above, using the processors available to the calling thread.
+std::vector<int> thread_binding_cpus(const proc_allocation& resources);
+
 } // namespace threading
 } // namespace arb
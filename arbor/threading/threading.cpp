@@ -1,5 +1,9 @@
 #include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
 
+#include "hardware/affinity.hpp"
 #include "threading.hpp"
 #include "thread_info.hpp"
 
@@ -7,6 +11,136 @@ using namespace arb::threading::impl;
 using namespace arb::threading;
 using namespace arb;
 
+namespace {
+// The task_system and index of the calling thread, set when a worker
+// thread starts.
+thread_local const task_system* worker_owner = nullptr;
+thread_local int worker_index = -1;
+
+// Per-thread xorshift generator used to choose steal victims.
+unsigned next_random() {
+    thread_local std::uint32_t state =
+        static_cast<std::uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id())) | 1u;
+    state ^= state<<13;
+    state ^= state>>17;
+    state ^= state<<5;
+    return state;
+}
+
+void run_and_delete(task* t) {
+    std::unique_ptr<task> owned(t);
+    (*owned)();
+}
+
+// Task pool implementation.
+//
+// Free blocks are kept in singly linked lists threaded through the blocks.
+// Each thread has a cache of free blocks; the depot holds lists of
+// task_batch_size blocks that are shared between threads.
+
+struct free_block {
+    free_block* next;
+};
+
+constexpr std::size_t task_batch_size = 64;
+
+// A list of free blocks and its length.
+struct free_list {
+    free_block* head;
+    std::size_t size;
+};
+
+struct task_depot {
+    std::mutex mutex;
+    std::vector<free_list> lists;
+
+    // Return a list of free blocks, allocating a new batch if none is available.
+    free_list take() {
+        {
+            lock depot_lock{mutex};
+            if (!lists.empty()) {
+                auto l = lists.back();
+                lists.pop_back();
+                return l;
+            }
+        }
+
+        static_assert(sizeof(task)>=sizeof(free_block), "task too small for free list");
+        auto slab = static_cast<char*>(::operator new(task_batch_size*sizeof(task)));
+        free_block* head = nullptr;
+        for (auto i = task_batch_size; i>0; --i) {
+            auto b = reinterpret_cast<free_block*>(slab+(i-1)*sizeof(task));
+            b->next = head;
+            head = b;
+        }
+        return {head, task_batch_size};
+    }
+
+    void give(free_list l) {
+        lock depot_lock{mutex};
+        lists.push_back(l);
+    }
+};
+
+task_depot& global_task_depot() {
+    static task_depot depot;
+    return depot;
+}
+
+struct task_cache {
+    free_block* head = nullptr;
+    std::size_t size = 0;
+
+    void* allocate() {
+        if (!head) {
+            auto l = global_task_depot().take();
+            head = l.head;
+            size = l.size;
+        }
+        auto b = head;
+        head = b->next;
+        --size;
+        return b;
+    }
+
+    void deallocate(void* p) {
+        auto b = static_cast<free_block*>(p);
+        b->next = head;
+        head = b;
+
+        // Keep at most two batches locally; give one back to the depot.
+        if (++size==2*task_batch_size) {
+            auto last = head;
+            for (std::size_t i = 1; i<task_batch_size; ++i) {
+                last = last->next;
+            }
+            auto batch = head;
+            head = last->next;
+            last->next = nullptr;
+            size -= task_batch_size;
+            global_task_depot().give({batch, task_batch_size});
+        }
+    }
+
+    // Return cached blocks to the depot when the thread exits.
+    ~task_cache() {
+        if (head) {
+            global_task_depot().give({head, size});
+        }
+    }
+};
+
+thread_local task_cache local_task_cache;
+} // anonymous namespace
+
+void* arb::threading::impl::allocate_task() {
+    return local_task_cache.allocate();
+}
+
+void arb::threading::impl::deallocate_task(void* p) noexcept {
+    local_task_cache.deallocate(p);
+}
+
 task notification_queue::try_pop() {
     task tsk;
     lock q_lock{q_mutex_, std::try_to_lock};
@@ -35,7 +169,6 @@ bool notification_queue::try_push(task& tsk) {
         lock q_lock{q_mutex_, std::try_to_lock};
         if (!q_lock) return false;
         q_tasks_.push_back(std::move(tsk));
-        tsk = 0;
     }
     q_tasks_available_.notify_all();
     return true;
@@ -57,7 +190,117 @@ void notification_queue::quit() {
     q_tasks_available_.notify_all();
 }
 
+work_stealing_deque::work_stealing_deque(std::int64_t capacity) {
+    buffers_.emplace_back(new buffer(capacity));
+    buffer_.store(buffers_.back().get(), std::memory_order_relaxed);
+}
+
+work_stealing_deque::~work_stealing_deque() {
+    while (task* t = pop()) {
+        delete t;
+    }
+}
+
+void work_stealing_deque::push(task* t) {
+    auto b = bottom_.load(std::memory_order_relaxed);
+    auto top = top_.load(std::memory_order_acquire);
+    buffer* a = buffer_.load(std::memory_order_relaxed);
+
+    if (b-top>a->mask) {
+        // Full: copy the live range into a buffer of twice the capacity.
+        std::unique_ptr<buffer> grown(new buffer(2*a->capacity()));
+        for (auto i = top; i<b; ++i) {
+            grown->put(i, a->get(i));
+        }
+        a = grown.get();
+        buffers_.push_back(std::move(grown));
+        buffer_.store(a, std::memory_order_release);
+    }
+
+    a->put(b, t);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b+1, std::memory_order_relaxed);
+}
+
+task* work_stealing_deque::pop() {
+    auto b = bottom_.load(std::memory_order_relaxed)-1;
+    buffer* a = buffer_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto top = top_.load(std::memory_order_relaxed);
+
+    if (top>b) {
+        // Empty: restore bottom.
+        bottom_.store(b+1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    task* t = a->get(b);
+    if (top==b) {
+        // Last task: race against thieves for it.
+        if (!top_.compare_exchange_strong(top, top+1,
+                std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            t = nullptr;
+        }
+        bottom_.store(b+1, std::memory_order_relaxed);
+    }
+    return t;
+}
+
+task* work_stealing_deque::steal() {
+    auto top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto b = bottom_.load(std::memory_order_acquire);
+
+    if (top>=b) return nullptr;
+
+    buffer* a = buffer_.load(std::memory_order_acquire);
+    task* t = a->get(top);
+    if (!top_.compare_exchange_strong(top, top+1,
+            std::memory_order_seq_cst, std::memory_order_relaxed))
+    {
+        return nullptr;
+    }
+    return t;
+}
+
+bool work_stealing_deque::empty() const {
+    auto top = top_.load(std::memory_order_acquire);
+    auto b = bottom_.load(std::memory_order_acquire);
+    return b<=top;
+}
+
+task_mailbox::~task_mailbox() {
+    for (auto t: tasks_) delete t;
+}
+
+void task_mailbox::push(task* t) {
+    lock q_lock{mutex_};
+    tasks_.push_back(t);
+    ++size_;
+}
+
+task* task_mailbox::pop() {
+    if (empty()) return nullptr;
+
+    lock q_lock{mutex_};
+    if (tasks_.empty()) return nullptr;
+    task* t = tasks_.front();
+    tasks_.pop_front();
+    --size_;
+    return t;
+}
+
 void task_system::run_tasks_loop(int i){
+    worker_owner = this;
+    worker_index = i;
+
+    if (kind_==scheduler_kind::work_stealing) {
+        run_stealing_loop(i);
+        return;
+    }
+
     while (true) {
         task tsk;
         for (unsigned n = 0; n != count_; n++) {
@@ -71,6 +314,13 @@ void task_system::run_tasks_loop(int i){
 }
 
 void task_system::try_run_task() {
+    if (kind_==scheduler_kind::work_stealing) {
+        if (task* t = find_task(deque_index())) {
+            run_and_delete(t);
+        }
+        return;
+    }
+
     auto nthreads = get_num_threads();
     task tsk;
     for (int n = 0; n != nthreads; n++) {
@@ -84,27 +334,61 @@ void task_system::try_run_task() {
 
 task_system::task_system(): task_system(num_threads_init()) {}
 
-task_system::task_system(int nthreads): count_(nthreads), q_(nthreads) {
+task_system::task_system(int nthreads, scheduler_kind kind, std::vector<int> bind_cpus):
+    count_(nthreads),
+    kind_(kind),
+    q_(kind==scheduler_kind::notification_queues? nthreads: 0),
+    deques_(kind==scheduler_kind::work_stealing? nthreads: 0),
+    master_id_(std::this_thread::get_id()),
+    mailboxes_(kind==scheduler_kind::work_stealing? nthreads: 0),
+    bind_cpus_(std::move(bind_cpus))
+{
     if (nthreads <= 0)
         throw std::runtime_error("Non-positive number of threads in thread pool");
 
+    // Bind each thread, including the calling thread, to its processor.
+    auto bind = [this](unsigned i) {
+        if (!bind_cpus_.empty()) {
+            hw::set_affinity(bind_cpus_[i%bind_cpus_.size()]);
+        }
+    };
+
     // Main thread
-    auto tid = std::this_thread::get_id();
+    auto tid = master_id_;
     thread_ids_[tid] = 0;
+    if (!bind_cpus_.empty()) {
+        master_affinity_ = hw::get_affinity();
+    }
+    bind(0);
 
     for (unsigned i = 1; i < count_; i++) {
-        threads_.emplace_back([this, i]{run_tasks_loop(i);});
+        threads_.emplace_back([this, i, bind]{ bind(i); run_tasks_loop(i); });
         tid = threads_.back().get_id();
         thread_ids_[tid] = i;
     }
 }
 
 task_system::~task_system() {
+    {
+        lock park_lock{park_mutex_};
+        quit_ = true;
+    }
+    park_cv_.notify_all();
     for (auto& e: q_) e.quit();
     for (auto& e: threads_) e.join();
+
+    // Only the thread that was bound can be unbound.
+    if (!master_affinity_.empty() && std::this_thread::get_id()==master_id_) {
+        hw::set_affinity(master_affinity_);
+    }
 }
 
 void task_system::async(task tsk) {
+    if (kind_==scheduler_kind::work_stealing) {
+        push_stealing(new task(std::move(tsk)));
+        return;
+    }
+
     auto i = index_++;
 
     for (unsigned n = 0; n != count_; n++) {
@@ -113,6 +397,27 @@ void task_system::async(task tsk) {
     q_[i % count_].push(std::move(tsk));
 }
 
+void task_system::async(task tsk, int thread) {
+    thread = thread%count_;
+
+    if (kind_==scheduler_kind::notification_queues) {
+        // Threads try their own queue first.
+        q_[thread].push(std::move(tsk));
+        return;
+    }
+
+    mailboxes_[thread].push(new task(std::move(tsk)));
+
+    // Only the addressee can take the task, unless it is the master thread,
+    // so wake all parked workers.
+    ++wake_epoch_;
+    if (num_parked_) {
+        lock park_lock{park_mutex_};
+        if (thread) park_cv_.notify_all();
+        else park_cv_.notify_one();
+    }
+}
+
 int task_system::get_num_threads() const {
     return threads_.size() + 1;
 }
@@ -120,3 +425,93 @@ int task_system::get_num_threads() const {
 std::unordered_map<std::thread::id, std::size_t> task_system::get_thread_ids() const {
     return thread_ids_;
 };
+
+int task_system::thread_index() const {
+    if (worker_owner==this) return worker_index;
+    if (std::this_thread::get_id()==master_id_) return 0;
+    return -1;
+}
+
+// Work-stealing implementation.
+
+// Index of the deque owned by the calling thread, or -1 if it owns none.
+int task_system::deque_index() const {
+    return thread_index();
+}
+
+void task_system::push_stealing(task* t) {
+    auto i = deque_index();
+    if (i>=0) {
+        deques_[i].push(t);
+    }
+    else {
+        injected_.push(t);
+    }
+
+    // Wake a parked worker, if any. The epoch increment must be ordered
+    // after the push and before the test of num_parked_: see run_stealing_loop.
+    ++wake_epoch_;
+    if (num_parked_) {
+        lock park_lock{park_mutex_};
+        park_cv_.notify_one();
+    }
+}
+
+// Take a task from the deque of thread i, then from its mailbox, then from
+// the injection queue, and then try to steal from the other deques, starting
+// at a random victim. Finally, take tasks addressed to the master thread,
+// which runs tasks only while it waits on a task_group.
+task* task_system::find_task(int i) {
+    if (i>=0) {
+        if (task* t = deques_[i].pop()) return t;
+        if (task* t = mailboxes_[i].pop()) return t;
+    }
+
+    if (task* t = injected_.pop()) return t;
+
+    const unsigned start = next_random();
+    for (unsigned n = 0; n != count_; n++) {
+        const int victim = (start+n)%count_;
+        if (victim==i) continue;
+        if (task* t = deques_[victim].steal()) return t;
+    }
+
+    if (i!=0) {
+        if (task* t = mailboxes_[0].pop()) return t;
+    }
+    return nullptr;
+}
+
+// Test for tasks that thread i could take.
+bool task_system::has_visible_tasks(int i) const {
+    if (!injected_.empty() || !mailboxes_[i].empty() || !mailboxes_[0].empty()) return true;
+    for (auto& d: deques_) {
+        if (!d.empty()) return true;
+    }
+    return false;
+}
+
+void task_system::run_stealing_loop(int i) {
+    while (true) {
+        if (task* t = find_task(i)) {
+            run_and_delete(t);
+            continue;
+        }
+
+        // Park without spinning. The wake epoch is sampled before checking
+        // for tasks one last time: a task pushed after this check increments
+        // the epoch, which either stops the worker from waiting, or happens
+        // after the worker has registered in num_parked_, in which case the
+        // pusher will notify it.
+        const auto epoch = wake_epoch_.load();
+        if (has_visible_tasks(i)) continue;
+        if (quit_) break;
+
+        lock park_lock{park_mutex_};
+        ++num_parked_;
+        while (wake_epoch_.load()==epoch && !quit_) {
+            park_cv_.wait(park_lock);
+        }
+        --num_parked_;
+    }
+}
@@ -5,11 +5,14 @@
 #include <atomic>
 #include <condition_variable>
 #include <cstddef>
+#include <cstdint>
 #include <deque>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <type_traits>
 #include <vector>
 #include <unordered_map>
 #include <utility>
@@ -23,7 +26,159 @@ class task_group;
 using std::mutex;
 using lock = std::unique_lock<mutex>;
 using std::condition_variable;
-using task = std::function<void()>;
+
+namespace impl {
+// Fixed-size allocator for task objects.
+//
+// Each thread keeps a free list of task-sized blocks. Blocks freed by a
+// thread other than the one that allocated them are returned to the freeing
+// thread's list; lists that grow too long give batches of blocks back to a
+// shared depot, from which threads with empty lists take batches, so that
+// the global allocator is used only when the total number of tasks in flight
+// reaches a new maximum. Memory acquired by the pool is never released.
+void* allocate_task();
+void deallocate_task(void* p) noexcept;
+} // namespace impl
+
+// Tag for constructing the callable of a task in place.
+template <typename F>
+struct in_place_callable {};
+
+// A move-only nullary callable with inline storage.
+//
+// Callables of size up to inline_size bytes that are nothrow move
+// constructible are stored in the task itself, so that wrapping the lambdas
+// used by task_group and parallel_for does not allocate. Larger callables
+// are stored on the heap.
+//
+// Tasks created with new (e.g. those queued by task_system) are allocated
+// from per-thread pools: see impl::allocate_task.
+class task {
+public:
+    static constexpr std::size_t inline_size = 48;
+
+    task() = default;
+
+    template <
+        typename F,
+        typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, task>::value>::type
+    >
+    task(F&& f) {
+        emplace<typename std::decay<F>::type>(std::forward<F>(f));
+    }
+
+    template <typename F, typename... Args>
+    explicit task(in_place_callable<F>, Args&&... args) {
+        emplace<F>(std::forward<Args>(args)...);
+    }
+
+    task(task&& other) noexcept {
+        take(other);
+    }
+
+    task& operator=(task&& other) noexcept {
+        if (this!=&other) {
+            reset();
+            take(other);
+        }
+        return *this;
+    }
+
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+
+    ~task() { reset(); }
+
+    void operator()() { ops_->invoke(&storage_); }
+
+    explicit operator bool() const { return ops_; }
+
+    void reset() {
+        if (ops_) {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    static void* operator new(std::size_t) {
+        return impl::allocate_task();
+    }
+
+    static void operator delete(void* p) noexcept {
+        impl::deallocate_task(p);
+    }
+
+private:
+    using storage_type = typename std::aligned_storage<inline_size, alignof(std::max_align_t)>::type;
+
+    struct ops_table {
+        void (*invoke)(void*);
+        // Move construct the callable at the second argument into the first,
+        // and destroy the source.
+        void (*relocate)(void*, void*);
+        void (*destroy)(void*);
+    };
+
+    template <typename F>
+    struct inline_ops {
+        static void invoke(void* p) { (*static_cast<F*>(p))(); }
+        static void relocate(void* to, void* from) {
+            F* f = static_cast<F*>(from);
+            new (to) F(std::move(*f));
+            f->~F();
+        }
+        static void destroy(void* p) { static_cast<F*>(p)->~F(); }
+        static constexpr ops_table table = {invoke, relocate, destroy};
+    };
+
+    template <typename F>
+    struct heap_ops {
+        static void invoke(void* p) { (**static_cast<F**>(p))(); }
+        static void relocate(void* to, void* from) { *static_cast<F**>(to) = *static_cast<F**>(from); }
+        static void destroy(void* p) { delete *static_cast<F**>(p); }
+        static constexpr ops_table table = {invoke, relocate, destroy};
+    };
+
+    template <typename F>
+    using is_inline = std::integral_constant<bool,
+        sizeof(F)<=inline_size &&
+        alignof(F)<=alignof(storage_type) &&
+        std::is_nothrow_move_constructible<F>::value>;
+
+    template <typename F, typename... Args>
+    void emplace(Args&&... args) {
+        emplace_impl<F>(is_inline<F>{}, std::forward<Args>(args)...);
+    }
+
+    template <typename F, typename... Args>
+    void emplace_impl(std::true_type, Args&&... args) {
+        new (&storage_) F(std::forward<Args>(args)...);
+        ops_ = &inline_ops<F>::table;
+    }
+
+    template <typename F, typename... Args>
+    void emplace_impl(std::false_type, Args&&... args) {
+        new (&storage_) F*(new F(std::forward<Args>(args)...));
+        ops_ = &heap_ops<F>::table;
+    }
+
+    void take(task& other) noexcept {
+        if (other.ops_) {
+            other.ops_->relocate(&storage_, &other.storage_);
+            ops_ = other.ops_;
+            other.ops_ = nullptr;
+        }
+    }
+
+    const ops_table* ops_ = nullptr;
+    storage_type storage_;
+};
+
+template <typename F>
+constexpr task::ops_table task::inline_ops<F>::table;
+
+template <typename F>
+constexpr task::ops_table task::heap_ops<F>::table;
 
 namespace impl {
 class notification_queue {
@@ -50,12 +205,105 @@ public:
     // Finish popping all waiting tasks on queue then stop trying to pop new tasks
     void quit();
 };
+
+// Lock-free work-stealing deque, after Chase and Lev, with the memory
+// orderings of Le et al., "Correct and efficient work-stealing for weak
+// memory models" (PPoPP 2013).
+//
+// Only the owning thread may push() and pop(), which operate on the bottom
+// of the deque in LIFO order. Any thread may steal() from the top.
+// The deque stores owning pointers to heap-allocated tasks; tasks remaining
+// in the deque on destruction are deleted.
+class work_stealing_deque {
+private:
+    struct buffer {
+        std::int64_t mask;
+        std::unique_ptr<std::atomic<task*>[]> slots;
+
+        explicit buffer(std::int64_t capacity):
+            mask(capacity-1), slots(new std::atomic<task*>[capacity])
+        {}
+
+        std::int64_t capacity() const { return mask+1; }
+
+        task* get(std::int64_t i) const {
+            return slots[i&mask].load(std::memory_order_relaxed);
+        }
+        void put(std::int64_t i, task* t) {
+            slots[i&mask].store(t, std::memory_order_relaxed);
+        }
+    };
+
+    // Top and bottom are kept on separate cache lines: top is contended
+    // by thieves, bottom is written only by the owner.
+    alignas(64) std::atomic<std::int64_t> top_{0};
+    alignas(64) std::atomic<std::int64_t> bottom_{0};
+    std::atomic<buffer*> buffer_;
+
+    // Buffers replaced on growth may still be read by concurrent thieves,
+    // and so are kept alive until the deque is destroyed.
+    std::vector<std::unique_ptr<buffer>> buffers_;
+
+public:
+    explicit work_stealing_deque(std::int64_t capacity = 256);
+    ~work_stealing_deque();
+
+    work_stealing_deque(const work_stealing_deque&) = delete;
+    work_stealing_deque& operator=(const work_stealing_deque&) = delete;
+
+    // Owner only: push a task to the bottom of the deque.
+    void push(task* t);
+
+    // Owner only: pop the most recently pushed task; nullptr if empty.
+    task* pop();
+
+    // Any thread: take the oldest task; nullptr if empty or if the steal
+    // lost a race with another thread.
+    task* steal();
+
+    // Approximate test for emptiness, for use by idle workers.
+    bool empty() const;
+};
+
+// Mutex-protected FIFO of heap-allocated tasks, with a lock-free test for
+// emptiness. Tasks remaining on destruction are deleted.
+class task_mailbox {
+private:
+    std::deque<task*> tasks_;
+    mutex mutex_;
+    std::atomic<std::size_t> size_{0};
+
+public:
+    task_mailbox() = default;
+    ~task_mailbox();
+
+    void push(task* t);
+
+    // Returns nullptr if empty.
+    task* pop();
+
+    bool empty() const { return !size_.load(std::memory_order_relaxed); }
+};
 }// namespace impl
 
+// Strategy used by a task_system for distributing tasks over its threads.
+//
+//   notification_queues: tasks are dealt round robin into per-thread
+//                         mutex-protected FIFO queues.
+//   work_stealing:        each thread pushes tasks onto its own lock-free
+//                         deque; idle threads steal from randomly chosen
+//                         victims, and park when there is no work left.
+enum class scheduler_kind {
+    notification_queues,
+    work_stealing
+};
+
 class task_system {
 private:
     unsigned count_;
 
+    scheduler_kind kind_;
+
     std::vector<std::thread> threads_;
 
     // queue of tasks
@@ -67,10 +315,48 @@ private:
     // total number of tasks pushed in all queues
     std::atomic<unsigned> index_{0};
 
+    // Work-stealing state: one deque per thread, with the deque at index 0
+    // owned by the thread that constructed the task_system.
+    std::vector<impl::work_stealing_deque> deques_;
+    std::thread::id master_id_;
+
+    // Tasks submitted from threads that own no deque.
+    impl::task_mailbox injected_;
+
+    // Tasks addressed to a specific thread: see async(task, int).
+    std::vector<impl::task_mailbox> mailboxes_;
+
+    // Logical processor of each thread, if threads are bound.
+    std::vector<int> bind_cpus_;
+
+    // Affinity of the calling thread before it was bound, restored when
+    // the task system is destroyed.
+    std::vector<int> master_affinity_;
+
+    // Idle workers park on park_cv_. Every push increments wake_epoch_, so that
+    // a worker that saw no work at a given epoch can sleep only if the epoch
+    // is unchanged when it takes the park lock.
+    mutex park_mutex_;
+    condition_variable park_cv_;
+    std::atomic<std::uint64_t> wake_epoch_{0};
+    std::atomic<unsigned> num_parked_{0};
+    std::atomic<bool> quit_{false};
+
+    // Work-stealing implementation helpers.
+    int deque_index() const;
+    void push_stealing(task* t);
+    task* find_task(int i);
+    bool has_visible_tasks(int i) const;
+    void run_stealing_loop(int i);
+
 public:
     task_system();
     // Create nthreads-1 new c std threads
-    task_system(int nthreads);
+    // If bind_cpus is not empty, thread i (where thread 0 is the calling
+    // thread) is bound to logical processor bind_cpus[i].
+    task_system(int nthreads,
+                scheduler_kind kind = scheduler_kind::work_stealing,
+                std::vector<int> bind_cpus = {});
 
     // task_system is a singleton.
     task_system(const task_system&) = delete;
@@ -81,6 +367,13 @@ public:
     // Pushes tasks into notification queue.
     void async(task tsk);
 
+    // Pushes a task to be run by thread (thread modulo the number of threads),
+    // e.g. so that repeated tasks on the same data run on the same core.
+    // Tasks addressed to a worker thread are run only by that worker; tasks
+    // addressed to the master thread 0 are preferentially run by it, but may
+    // be run by any other idle thread.
+    void async(task tsk, int thread);
+
     // Runs tasks until quit is true.
     void run_tasks_loop(int i);
 
@@ -91,6 +384,22 @@ public:
     // Includes master thread.
     int get_num_threads() const;
 
+    // Index of the calling thread in [0, get_num_threads()), where 0 is the
+    // thread that constructed the task_system, or -1 if the calling thread
+    // is not one of its threads. Worker threads find their index in a
+    // thread local variable set when they start; any other thread falls back
+    // to the master slot 0 if it is the thread that constructed the
+    // task_system, which may be the master of more than one.
+    //
+    // Used by enumerable_thread_specific, thread_private_spike_store and
+    // the profiler to find per-thread state.
+    int thread_index() const;
+
+    scheduler_kind kind() const { return kind_; }
+
+    // Logical processor to which each thread is bound; empty if threads are not bound.
+    const std::vector<int>& bind_cpus() const { return bind_cpus_; }
+
     // Returns the thread_id map
     std::unordered_map<std::thread::id, std::size_t> get_thread_ids() const;
 };
@@ -157,20 +466,12 @@ public:
                 exception_status_(ex)
         {}
 
-        wrap(wrap&& other):
+        wrap(wrap&& other) noexcept(std::is_nothrow_move_constructible<F>::value):
                 f_(std::move(other.f_)),
                 counter_(other.counter_),
                 exception_status_(other.exception_status_)
         {}
 
-        // std::function is not guaranteed to not copy the contents on move construction,
-        // but the class is safe because we don't call operator() more than once on the same wrapped task.
-        wrap(const wrap& other):
-                f_(other.f_),
-                counter_(other.counter_),
-                exception_status_(other.exception_status_)
-        {}
-
         void operator()() {
             if (!exception_status_) {
                 try {
@@ -187,16 +488,22 @@ public:
     template <typename F>
     using callable = typename std::decay<F>::type;
 
-    template <typename F>
-    wrap<callable<F>> make_wrapped_function(F&& f, std::atomic<std::size_t>& c, exception_state& ex) {
-        return wrap<callable<F>>(std::forward<F>(f), c, ex);
+    template<typename F>
+    void run(F&& f) {
+        running_ = true;
+        ++in_flight_;
+        // Construct the wrapped callable directly in the task storage.
+        task_system_->async(task(in_place_callable<wrap<callable<F>>>{},
+            std::forward<F>(f), in_flight_, exception_status_));
     }
 
+    // Run f on the given thread of the task system: see task_system::async.
     template<typename F>
-    void run(F&& f) {
+    void run_on(int thread, F&& f) {
         running_ = true;
         ++in_flight_;
-        task_system_->async(make_wrapped_function(std::forward<F>(f), in_flight_, exception_status_));
+        task_system_->async(task(in_place_callable<wrap<callable<F>>>{},
+            std::forward<F>(f), in_flight_, exception_status_), thread);
     }
 
     // Wait till all tasks in this group are done.
@@ -219,7 +526,22 @@ public:
 ///////////////////////////////////////////////////////////////////////
 // algorithms
 ///////////////////////////////////////////////////////////////////////
+
+// Assignment of loop iterations to tasks in a chunked parallel_for.
+//
+//   static_chunks: the range is split into one contiguous block per task.
+//   dynamic:       tasks repeatedly claim the next grain_size iterations.
+//   guided:        as dynamic, but each claim takes a share of the remaining
+//                  iterations proportional to 1/num_threads, shrinking to
+//                  grain_size towards the end of the range.
+enum class loop_schedule {
+    static_chunks,
+    dynamic,
+    guided
+};
+
 struct parallel_for {
+    // Run f(i) for each i in [left, right), with one task per index.
     template <typename F>
     static void apply(int left, int right, task_system* ts, F f) {
         task_group g(ts);
@@ -228,6 +550,58 @@ struct parallel_for {
         }
         g.wait();
     }
+
+    // Run f(i) for each i in [left, right), with at most one task per thread.
+    // Each task calls f on contiguous chunks of at least grain_size indices,
+    // allocated according to sched. The number of tasks, and hence the
+    // scheduling overhead, is independent of the size of the range.
+    template <typename F>
+    static void apply(int left, int right, task_system* ts, loop_schedule sched, int grain_size, F f) {
+        const int n = right-left;
+        if (n<=0) return;
+
+        grain_size = std::max(grain_size, 1);
+        const int nchunks = (n-1)/grain_size+1;
+        const int ntasks = std::min(ts->get_num_threads(), nchunks);
+
+        if (ntasks==1) {
+            for (int i = left; i < right; ++i) f(i);
+            return;
+        }
+
+        task_group g(ts);
+        if (sched==loop_schedule::static_chunks) {
+            for (int k = 0; k < ntasks; ++k) {
+                const int b = left + (long long)n*k/ntasks;
+                const int e = left + (long long)n*(k+1)/ntasks;
+                g.run([&f, b, e] { for (int i = b; i < e; ++i) f(i); });
+            }
+            g.wait();
+            return;
+        }
+
+        std::atomic<int> next{left};
+        const bool guided = sched==loop_schedule::guided;
+
+        auto run_chunks = [&] {
+            while (true) {
+                int b = next.load(std::memory_order_relaxed);
+                int chunk;
+                do {
+                    if (b>=right) return;
+                    chunk = guided? std::max(grain_size, (right-b)/(2*ntasks)): grain_size;
+                    chunk = std::min(chunk, right-b);
+                } while (!next.compare_exchange_weak(b, b+chunk, std::memory_order_relaxed));
+
+                for (int i = b; i < b+chunk; ++i) f(i);
+            }
+        };
+
+        for (int k = 0; k < ntasks; ++k) {
+            g.run(run_chunks);
+        }
+        g.wait();
+    }
 };
 } // namespace threading
 
@@ -183,6 +183,8 @@ cl_options read_options(int argc, char** argv, bool allow_write) {
              "", "report-compartments", "Count compartments in cells before simulation", cmd, false);
         TCLAP::SwitchArg spike_output_arg(
             "f","spike-file-output","save spikes to file", cmd, false);
+        TCLAP::SwitchArg spike_binary_arg(
+            "","spike-file-binary","save spikes to binary spike files, with extension 'spk'", cmd, false);
         TCLAP::ValueArg<unsigned> dry_run_ranks_arg(
             "D","dry-run-ranks","number of ranks in dry run mode",
             false, defopts.dry_run_ranks, "positive integer", cmd);
@@ -230,6 +232,7 @@ cl_options read_options(int argc, char** argv, bool allow_write) {
                     // Parameters for spike output
                     update_option(options.spike_file_output, fopts, "spike_file_output");
                     if (options.spike_file_output) {
+                        update_option(options.spike_file_binary, fopts, "spike_file_binary");
                         update_option(options.single_file_per_rank, fopts, "single_file_per_rank");
                         update_option(options.over_write, fopts, "over_write");
                         update_option(options.output_path, fopts, "output_path");
@@ -269,6 +272,7 @@ cl_options read_options(int argc, char** argv, bool allow_write) {
         update_option(options.morph_rr, morph_rr_arg);
         update_option(options.report_compartments, report_compartments_arg);
         update_option(options.spike_file_output, spike_output_arg);
+        update_option(options.spike_file_binary, spike_binary_arg);
         update_option(options.dry_run_ranks, dry_run_ranks_arg);
 
         if (options.trace_format!="csv" && options.trace_format!="json") {
@@ -47,6 +47,7 @@ struct cl_options {
 
     // Parameters for spike output.
     bool spike_file_output = false;
+    bool spike_file_binary = false; // Write with arb::spike_recorder.
     bool single_file_per_rank = false;
     bool over_write = true;
     std::string output_path = "./";
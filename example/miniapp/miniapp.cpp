@@ -13,6 +13,7 @@
 #include <arbor/sampling.hpp>
 #include <arbor/schedule.hpp>
 #include <arbor/simulation.hpp>
+#include <arbor/spike_file.hpp>
 #include <arbor/util/any.hpp>
 #include <arbor/version.hpp>
 
@@ -120,13 +121,30 @@ int main(int argc, char** argv) {
 
         // Initialize the spike exporting interface
         std::fstream spike_out;
+        std::unique_ptr<spike_recorder> spike_rec;
         if (options.spike_file_output) {
             using std::ios_base;
 
+            auto extension = options.spike_file_binary? "spk": options.file_extension;
             aux::path p = options.output_path;
-            p /= aux::strsub("%_%.%", options.file_name, rank, options.file_extension);
+            p /= aux::strsub("%_%.%", options.file_name, rank, extension);
 
-            if (options.single_file_per_rank) {
+            if (options.spike_file_binary) {
+                // Binary spike files are written in the background, and
+                // converted to text with spiketext.
+                if (!options.over_write && aux::exists(p)) {
+                    throw std::runtime_error(aux::strsub("file % already exists", p));
+                }
+                if (options.single_file_per_rank) {
+                    spike_rec.reset(new spike_recorder(p.native(), rank));
+                    sim.set_local_spike_callback(spike_rec->callback());
+                }
+                else if (rank==0) {
+                    spike_rec.reset(new spike_recorder(p.native()));
+                    sim.set_global_spike_callback(spike_rec->callback());
+                }
+            }
+            else if (options.single_file_per_rank) {
                 spike_out = aux::open_or_throw(p, ios_base::out, !options.over_write);
                 sim.set_local_spike_callback(aux::spike_emitter(spike_out));
             }
@@ -140,6 +158,9 @@ int main(int argc, char** argv) {
 
         // run model
         sim.run(options.tfinal, options.dt);
+        if (spike_rec) {
+            spike_rec->close();
+        }
 
         meters.checkpoint("model-simulate", context);
 
@@ -45,6 +45,13 @@ struct bad_probe_id: arbor_exception {
     cell_member_type probe_id;
 };
 
+struct bad_connection_target: arbor_exception {
+    bad_connection_target(cell_member_type target, cell_gid_type first, cell_gid_type last);
+    cell_member_type target;
+    cell_gid_type first;
+    cell_gid_type last;
+};
+
 // Simulation errors:
 
 struct bad_event_time: arbor_exception {
@@ -53,6 +60,10 @@ struct bad_event_time: arbor_exception {
     time_type sim_time;
 };
 
+struct bad_checkpoint: arbor_exception {
+    explicit bad_checkpoint(const std::string& what);
+};
+
 // Mechanism catalogue errors:
 
 struct no_such_mechanism: arbor_exception {
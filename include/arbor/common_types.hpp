@@ -111,6 +111,13 @@ enum class binning_kind {
     following, // => round times down to previous event if within binning interval.
 };
 
+// Enumeration for the policy used to exchange spikes between domains.
+
+enum class spike_exchange_policy {
+    gather,         // => every spike is sent to every domain.
+    point_to_point, // => spikes are sent only to domains with connections from their source.
+};
+
 std::ostream& operator<<(std::ostream& o, cell_member_type m);
 std::ostream& operator<<(std::ostream& o, cell_kind k);
 std::ostream& operator<<(std::ostream& o, backend_kind k);
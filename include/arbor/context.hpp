@@ -1,6 +1,9 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace arb {
 
@@ -24,9 +27,42 @@ struct dry_run_info {
             num_cells_per_rank(cells_per_rank) {}
 };
 
+/// Shared state of a set of ranks that run in the threads of one process,
+/// for testing and benchmarking distributed models without MPI.
+struct thread_ranks_state;
+using thread_ranks = std::shared_ptr<thread_ranks_state>;
+
+/// Create the shared state for num_ranks in-process ranks.
+thread_ranks make_thread_ranks(unsigned num_ranks);
+
+/// Requested in-process rank: rank `rank` of the ranks that share `ranks`.
+/// Each rank must be created, and its collective operations called, from
+/// a separate thread.
+struct thread_rank_info {
+    thread_ranks ranks;
+    unsigned rank;
+    thread_rank_info(thread_ranks r, unsigned i):
+            ranks(std::move(r)),
+            rank(i) {}
+};
+
 /// Determine available local domain resources.
 local_resources get_local_resources();
 
+/// Policy for binding the threads of the thread pool to logical processors.
+enum class thread_binding {
+    /// Threads are not bound, and may migrate between processors.
+    none,
+    /// Thread i is bound to the i-th processor available to the process,
+    /// so that consecutive threads share a NUMA node where possible.
+    compact,
+    /// Threads are dealt round robin over the NUMA nodes of the
+    /// processors available to the process.
+    scatter,
+    /// Thread i is bound to proc_allocation::bind_cpus[i].
+    list
+};
+
 /// A subset of local computation resources to use in a computation.
 struct proc_allocation {
     unsigned num_threads;
@@ -37,6 +73,13 @@ struct proc_allocation {
     // see CUDA documenation for cudaSetDevice and cudaDeviceGetAttribute 
     int gpu_id;
 
+    // Binding of threads to logical processors. Thread 0 is the thread that
+    // creates the context, which is bound along with the worker threads.
+    thread_binding binding = thread_binding::none;
+
+    // Logical processor ids used by thread_binding::list, one for each thread.
+    std::vector<int> bind_cpus;
+
     // By default a proc_allocation will take all available threads and the
     // GPU with id 0, if available.
     proc_allocation() {
@@ -85,7 +128,8 @@ context make_context();
 context make_context(const proc_allocation& resources);
 
 // Distributed context that uses MPI communicator comm, and local resources
-// described by resources. Or dry run context that uses dry_run_info.
+// described by resources. Or dry run context that uses dry_run_info, or
+// in-process rank context that uses thread_rank_info.
 template <typename Comm>
 context make_context(const proc_allocation& resources, Comm comm);
 
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+#include <arbor/common_types.hpp>
 #include <arbor/context.hpp>
 #include <arbor/domain_decomposition.hpp>
 #include <arbor/recipe.hpp>
@@ -16,9 +21,54 @@ struct partition_hint {
 
 using partition_hint_map = std::unordered_map<cell_kind, partition_hint>;
 
+// Estimated cost of simulating cell gid, e.g. measured in a previous run.
+using cell_cost_function = std::function<double(cell_gid_type)>;
+
+// Partition cells over domains, and cells of each kind on a domain over cell
+// groups, in contiguous blocks of gids: of about equal estimated cost if
+// cost is supplied, else of equal numbers of cells. Each domain evaluates
+// cost only for an equal share of the cells and for its own cells.
 domain_decomposition partition_load_balance(
     const recipe& rec,
     const context& ctx,
-    partition_hint_map hint_map = {});
+    partition_hint_map hint_map = {},
+    cell_cost_function cost = {});
+
+// Parameters of the multilevel graph partitioner used by
+// partition_graph_load_balance.
+struct graph_partition_options {
+    // Fraction of cells, chosen by gid, whose incoming connections are used
+    // to build the connection graph. 1 uses every connection.
+    double sample_fraction = 1;
+
+    // Allowed excess of the estimated cost of a domain over the average,
+    // as a fraction of the average.
+    double imbalance = 0.05;
+
+    // The graph is coarsened until it has no more than this many vertices
+    // per domain.
+    unsigned coarsen_to = 20;
+
+    // Number of partitions of the coarsest graph tried, of which the one
+    // with the smallest cut is kept.
+    unsigned initial_trials = 4;
+
+    // Maximum number of refinement passes at each level.
+    unsigned refine_passes = 10;
+
+    // Seed for the randomized matching used in coarsening.
+    std::uint64_t seed = 0;
+};
+
+// Partition cells over domains so that few connections cross domains, with
+// about equal estimated cost on each domain. The gids on a domain are in
+// general not contiguous. Cells on a domain are grouped as by
+// partition_load_balance.
+domain_decomposition partition_graph_load_balance(
+    const recipe& rec,
+    const context& ctx,
+    partition_hint_map hint_map = {},
+    graph_partition_options options = {},
+    cell_cost_function cost = {});
 
 } // namespace arb
@@ -64,6 +64,24 @@ struct cell_probe_address {
     probe_kind kind;
 };
 
+// Numbering of the control volumes (CVs) of a cell in its discretization.
+//
+// segment:      CVs are numbered segment by segment, in segment order.
+// depth_first:  Segments are numbered in a depth-first traversal of the
+//               segment tree, visiting the subtrees of a segment in
+//               increasing order of size. This keeps the CVs of each subtree
+//               contiguous, and minimizes the total distance between the
+//               indices of CVs and their parents.
+//
+// The CVs of a segment are contiguous in either case. The choice affects the
+// memory layout of the cell state, and the results of a simulation only up to
+// rounding.
+
+enum class cv_ordering {
+    segment,
+    depth_first
+};
+
 // Global parameter type for cell descriptions.
 
 struct mc_cell_global_properties {
@@ -90,6 +108,17 @@ struct mc_cell_global_properties {
 
     double temperature_K = constant::hh_squid_temp; // [K]
     double init_membrane_potential_mV = -65; // [mV]
+
+    cv_ordering cv_order = cv_ordering::segment;
+
+    // If >0, each cell is integrated with its own time step, chosen after
+    // each step so that the estimated local error of the membrane voltage
+    // in the next step is about this tolerance. Steps are at least
+    // adaptive_dt_min_ms, and at most the dt of simulation::run. Cells with
+    // events to deliver restart with the smallest step. Not supported on
+    // the GPU back end, which throws bad_global_property.
+    double adaptive_dt_tolerance_mV = 0;
+    double adaptive_dt_min_ms = 1e-3;   // [ms]
 };
 
 /// high-level abstract representation of a cell and its segments
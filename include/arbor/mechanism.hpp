@@ -67,6 +67,12 @@ public:
     virtual void deliver_events() {};
     virtual void write_ions() = 0;
 
+    // Checkpointing: a copy of the state and parameter values of an
+    // instantiated mechanism, which can be set on an instance of the same
+    // mechanism with the same layout.
+    virtual std::vector<fvm_value_type> get_state() const { return {}; }
+    virtual void set_state(const std::vector<fvm_value_type>&) {}
+
     virtual ~mechanism() = default;
 
     // Per-cell group identifier for an instantiated mechanism.
@@ -0,0 +1,174 @@
+#pragma once
+
+// Binary network description files.
+//
+// A network file holds the cell kind and the number of sources and targets
+// of every cell in a model, and the connections on every cell in compressed
+// sparse row form, grouped by target cell. The file is memory mapped for
+// reading, so that a recipe can serve the connections of a cell without
+// parsing, and only the parts of the file for local cells are read from disk:
+// the cell kind and connection offsets of a cell are checked when they are
+// read, not when the file is opened.
+//
+// Layout, with all values in the byte order of the host that wrote the file,
+// which must match that of the reader:
+//
+//   header         char magic[8] = "arbornet"
+//                  uint32 byte order mark 0x01020304
+//                  uint32 format version (1)
+//                  uint32 number of cells n
+//                  uint32 zero
+//                  uint64 number of connections m
+//   kinds          uint32[n], the cell_kind of each cell
+//   sources        uint32[n], the number of sources of each cell
+//   targets        uint32[n], the number of targets of each cell
+//   (zero padding to a multiple of 8 bytes)
+//   offsets        uint64[n+1], where the connections on cell gid are
+//                  records offsets[gid] to offsets[gid+1]
+//   records        network_connection[m]
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/common_types.hpp>
+#include <arbor/recipe.hpp>
+
+namespace arb {
+
+struct network_file_error: arbor_exception {
+    network_file_error(const std::string& path, const std::string& what);
+    std::string path;
+};
+
+// A connection record: the target cell is the cell whose connections
+// include the record.
+struct network_connection {
+    cell_gid_type source_gid;
+    cell_lid_type source_index;
+    cell_lid_type target;
+    float weight;
+    float delay;
+};
+
+static_assert(sizeof(network_connection)==20, "network_connection must be packed");
+
+// Write the cells and connections of rec to a network file at path.
+// The connections of each cell are stored in the order returned by
+// rec.connections_on, which must all have the cell as their destination.
+void write_network_file(const std::string& path, const recipe& rec);
+
+// A read-only, memory mapped network file.
+class network_file {
+public:
+    using connection_range = std::pair<const network_connection*, const network_connection*>;
+
+    // Map the file at path, checking its header and that the file is large
+    // enough to hold the number of cells and connections it claims.
+    // Throws network_file_error if not.
+    explicit network_file(const std::string& path);
+    ~network_file();
+
+    network_file(network_file&&) noexcept;
+    network_file& operator=(network_file&&) noexcept;
+
+    cell_size_type num_cells() const { return num_cells_; }
+    std::uint64_t num_connections() const { return num_connections_; }
+
+    // The accessors of cell gid throw network_file_error if gid is not
+    // less than num_cells().
+
+    // Throws network_file_error if the kind of gid is invalid.
+    cell_kind kind(cell_gid_type gid) const;
+
+    cell_size_type num_sources(cell_gid_type gid) const;
+    cell_size_type num_targets(cell_gid_type gid) const;
+
+    // The records of the connections on cell gid, in the mapped file.
+    // Throws network_file_error if the offsets of gid are invalid.
+    connection_range connections_on(cell_gid_type gid) const;
+
+private:
+    std::string path_;
+    void* map_ = nullptr;
+    std::size_t map_size_ = 0;
+
+    cell_size_type num_cells_ = 0;
+    std::uint64_t num_connections_ = 0;
+    const std::uint32_t* kinds_ = nullptr;
+    const std::uint32_t* sources_ = nullptr;
+    const std::uint32_t* targets_ = nullptr;
+    const std::uint64_t* offsets_ = nullptr;
+    const network_connection* records_ = nullptr;
+
+    void check_gid(cell_gid_type gid) const;
+};
+
+// A recipe whose cells and connections are read from a network file.
+//
+// The cell kinds, numbers of sources and targets, and connections come from
+// the file; cell descriptions, and optionally probes, event generators and
+// global properties, are provided by a derived class. A derived class that
+// changes the connections must override append_connections_on, which reads
+// the records of a range of cells in place, as well as connections_on.
+class file_recipe: public recipe {
+public:
+    explicit file_recipe(const std::string& path):
+        file_(std::make_shared<network_file>(path))
+    {}
+
+    cell_size_type num_cells() const override {
+        return file_->num_cells();
+    }
+
+    cell_kind get_cell_kind(cell_gid_type gid) const override {
+        return file_->kind(gid);
+    }
+
+    cell_size_type num_sources(cell_gid_type gid) const override {
+        return file_->num_sources(gid);
+    }
+
+    cell_size_type num_targets(cell_gid_type gid) const override {
+        return file_->num_targets(gid);
+    }
+
+    std::vector<cell_connection> connections_on(cell_gid_type gid) const override {
+        auto r = file_->connections_on(gid);
+        std::vector<cell_connection> conns;
+        conns.reserve(r.second-r.first);
+        for (auto c = r.first; c!=r.second; ++c) {
+            conns.push_back({{c->source_gid, c->source_index}, {gid, c->target}, c->weight, c->delay});
+        }
+        return conns;
+    }
+
+    void append_connections_on(cell_gid_type first, cell_gid_type last, std::vector<cell_connection>& conns) const override {
+        if (first>=last) return;
+
+        // The connections on consecutive cells are contiguous in the file.
+        auto begin = file_->connections_on(first).first;
+        auto end = file_->connections_on(last-1).second;
+        conns.reserve(conns.size()+(end-begin));
+        for (auto gid = first; gid<last; ++gid) {
+            auto r = file_->connections_on(gid);
+            for (auto c = r.first; c!=r.second; ++c) {
+                conns.push_back({{c->source_gid, c->source_index}, {gid, c->target}, c->weight, c->delay});
+            }
+        }
+    }
+
+    // The mapped file, from which the connection records can be read in
+    // place.
+    const network_file& network() const {
+        return *file_;
+    }
+
+private:
+    std::shared_ptr<const network_file> file_;
+};
+
+} // namespace arb
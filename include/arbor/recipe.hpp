@@ -66,6 +66,18 @@ public:
         return {};
     }
 
+    // Append the connections on the cells with gid in [first, last) to conns.
+    // Recipes that can generate the connections on many cells at once more
+    // cheaply than one cell at a time can override this; by default it calls
+    // connections_on for each cell. The simulation gets the connections on
+    // local cells only through this function.
+    virtual void append_connections_on(cell_gid_type first, cell_gid_type last, std::vector<cell_connection>& conns) const {
+        for (auto gid = first; gid<last; ++gid) {
+            auto c = connections_on(gid);
+            conns.insert(conns.end(), c.begin(), c.end());
+        }
+    }
+
     virtual probe_info get_probe(cell_member_type probe_id) const {
         throw bad_probe_id(probe_id);
     }
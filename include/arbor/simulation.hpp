@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <iosfwd>
 #include <memory>
 #include <unordered_map>
 #include <vector>
@@ -44,6 +45,26 @@ public:
     // Set event binning policy on all our groups.
     void set_binning_policy(binning_kind policy, time_type bin_interval);
 
+    // Set the policy used to exchange spikes between domains. This is a
+    // collective operation, and must be called on all domains.
+    // With spike_exchange_policy::point_to_point each domain receives only
+    // the spikes from sources with connections on that domain, so the global
+    // spike callback is passed only those spikes.
+    void set_spike_exchange_policy(spike_exchange_policy policy);
+
+    // Exchange spikes in a packed format, of less than half the size, with
+    // spike_exchange_policy::gather. Spike times are sent unchanged. Must be
+    // set to the same value on all domains.
+    void set_spike_compression(bool compress);
+
+    // Gather spikes with spike_exchange_policy::gather with point to point
+    // messages between every pair of domains, so that the events of the
+    // spikes of each domain are generated as soon as they arrive, instead of
+    // with one non-blocking collective. Each domain sends and receives a
+    // message from every other domain in each exchange, so this only pays
+    // off with few domains. Must be set to the same value on all domains.
+    void set_pairwise_spike_gather(bool pairwise);
+
     // Register a callback that will perform a export of the global
     // spike vector.
     void set_global_spike_callback(spike_export_function = spike_export_function{});
@@ -57,6 +78,22 @@ public:
     // are to be delivered at or after the current simulation time.
     void inject_events(const pse_vector& events);
 
+    // Write the state of the simulation on this domain to out, between calls
+    // to run. The state is copied before checkpoint returns, and written to
+    // out in the background while the simulation continues, so out must stay
+    // valid until wait_checkpoint returns.
+    void checkpoint(std::ostream& out);
+
+    // Wait until the last checkpoint has been written. Throws bad_checkpoint
+    // if it could not be written.
+    void wait_checkpoint();
+
+    // Restore the state of the simulation on this domain from a checkpoint
+    // written by a simulation of the same model and domain decomposition,
+    // with any number of threads.
+    // Samplers, spike callbacks and the binning policy are not restored.
+    void restore(std::istream& in);
+
     ~simulation();
 
 private:
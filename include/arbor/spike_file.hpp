@@ -0,0 +1,131 @@
+#pragma once
+
+// Binary spike files.
+//
+// A spike_recorder collects spikes passed to it by a simulation spike
+// callback into a buffer, and when the buffer is full hands it to a
+// background thread that writes it to file as a block, while spikes are
+// collected in a second buffer. The simulation is only held up when a
+// buffer fills before the previous one has been written.
+//
+// Layout, with all values in the byte order of the host that wrote the file,
+// which must match that of the reader:
+//
+//   header         char magic[8] = "arborspk"
+//                  uint32 byte order mark 0x01020304
+//                  uint32 format version (1)
+//                  uint32 domain that recorded the spikes
+//                  uint32 zero
+//   blocks         uint64 number of spikes n
+//                  float earliest and latest spike time in the block
+//                  spike_record[n], in the order they were recorded
+//   index          spike_block_index[b], one for each block
+//   trailer        uint64 number of blocks b
+//                  uint64 total number of spikes
+//                  char magic[8] = "arbspidx"
+//
+// The index and trailer are written when the recorder is closed; the blocks
+// of a file without them, for example if the simulation did not finish, are
+// found by reading the block headers in turn.
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/common_types.hpp>
+#include <arbor/simulation.hpp>
+#include <arbor/spike.hpp>
+
+namespace arb {
+
+struct spike_file_error: arbor_exception {
+    spike_file_error(const std::string& path, const std::string& what);
+    std::string path;
+};
+
+struct spike_record {
+    cell_gid_type gid;
+    cell_lid_type index;
+    float time;
+};
+
+static_assert(sizeof(spike_record)==12, "spike_record must be packed");
+
+struct spike_block_index {
+    std::uint64_t offset;      // Offset in bytes of the block in the file.
+    std::uint64_t num_spikes;
+    float t_min;
+    float t_max;
+};
+
+static_assert(sizeof(spike_block_index)==24, "spike_block_index must be packed");
+
+class spike_recorder {
+public:
+    // Create or truncate the file at path, and start the writer thread.
+    // Each buffer holds up to buffer_size spikes.
+    explicit spike_recorder(const std::string& path, unsigned domain = 0, std::size_t buffer_size = 1<<16);
+
+    // Close the file, if it has not been closed. Errors are ignored: call
+    // close() to see them.
+    ~spike_recorder();
+
+    spike_recorder(const spike_recorder&) = delete;
+    spike_recorder& operator=(const spike_recorder&) = delete;
+
+    // Record spikes. Throws spike_file_error if a previous buffer could not
+    // be written.
+    void operator()(const std::vector<spike>& spikes);
+
+    // A spike callback for simulation::set_global_spike_callback or
+    // simulation::set_local_spike_callback, that records spikes with this
+    // recorder, which must outlive the callback.
+    spike_export_function callback() {
+        return [this](const std::vector<spike>& spikes) { (*this)(spikes); };
+    }
+
+    // Write all recorded spikes, and wait until they have been written.
+    void flush();
+
+    // Write all recorded spikes and the index, and close the file.
+    void close();
+
+    std::uint64_t num_spikes() const;
+
+private:
+    struct impl;
+    std::unique_ptr<impl> impl_;
+};
+
+// A spike file opened for reading.
+class spike_file {
+public:
+    // Open the file at path, and read its header and index.
+    explicit spike_file(const std::string& path);
+
+    unsigned domain() const { return domain_; }
+    std::uint64_t num_spikes() const { return num_spikes_; }
+
+    // Whether the file was closed by the recorder, with an index.
+    bool complete() const { return complete_; }
+
+    const std::vector<spike_block_index>& blocks() const { return blocks_; }
+
+    // All spikes in the file, in the order they were recorded.
+    std::vector<spike> spikes() const;
+
+    // The spikes with times in [t0, t1), in the order they were recorded.
+    // Only the blocks with spikes in the interval are read.
+    std::vector<spike> spikes(time_type t0, time_type t1) const;
+
+private:
+    std::string path_;
+    unsigned domain_ = 0;
+    std::uint64_t num_spikes_ = 0;
+    bool complete_ = false;
+    std::vector<spike_block_index> blocks_;
+};
+
+} // namespace arb
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/spike.hpp>
+#include <arbor/spike_file.hpp>
+#include <arbor/util/optional.hpp>
+#include <aux/spike_emitter.hpp>
+#include <aux/tinyopt.hpp>
+
+using arb::util::optional;
+
+const char* usage_str =
+"[OPTION]... FILE...\n"
+"\n"
+"  -o, --output=FILE  Write spikes to FILE instead of standard output.\n"
+"  --from=T           Only write spikes at or after time T ms.\n"
+"  --to=T             Only write spikes before time T ms.\n"
+"  -s, --sort         Sort the spikes of all files by time and gid.\n"
+"  -i, --info         Describe each file instead of writing spikes.\n"
+"  -h, --help         Emit this message and exit.\n"
+"\n"
+"Convert binary spike files written by arb::spike_recorder to text, with\n"
+"one line per spike holding the gid of the source cell and the spike time,\n"
+"in the format of the miniapp text spike output. The spikes of each FILE\n"
+"are written in turn, in the order they were recorded, unless --sort is\n"
+"given.\n";
+
+int main(int argc, char** argv) {
+    // options
+    optional<std::string> output_file;
+    arb::time_type t0 = -arb::terminal_time;
+    arb::time_type t1 = arb::terminal_time;
+    bool sort = false;
+    bool info = false;
+    std::vector<std::string> files;
+
+    try {
+        auto arg = argv+1;
+        while (*arg) {
+            if (auto o = to::parse_opt<std::string>(arg, 'o', "output")) {
+                output_file = *o;
+            }
+            else if (auto o = to::parse_opt<arb::time_type>(arg, 0, "from")) {
+                t0 = *o;
+            }
+            else if (auto o = to::parse_opt<arb::time_type>(arg, 0, "to")) {
+                t1 = *o;
+            }
+            else if (to::parse_opt(arg, 's', "sort")) {
+                sort = true;
+            }
+            else if (to::parse_opt(arg, 'i', "info")) {
+                info = true;
+            }
+            else if (to::parse_opt(arg, 'h', "help")) {
+                std::cout << "Usage: " << argv[0] << " " << usage_str;
+                return 0;
+            }
+            else if (**arg!='-') {
+                files.push_back(*arg++);
+            }
+            else {
+                throw to::parse_opt_error(*arg, "unrecognized option");
+            }
+        }
+
+        if (files.empty()) {
+            throw to::parse_opt_error("missing spike file");
+        }
+
+        std::ofstream file_out;
+        if (output_file) {
+            file_out.open(*output_file);
+            if (!file_out) {
+                throw std::runtime_error("unable to open "+*output_file);
+            }
+        }
+        std::ostream& out = output_file? file_out: std::cout;
+
+        if (info) {
+            for (const auto& f: files) {
+                arb::spike_file file(f);
+                out << f << ": domain " << file.domain()
+                    << ", " << file.num_spikes() << " spikes in "
+                    << file.blocks().size() << " blocks"
+                    << (file.complete()? "": ", not closed") << "\n";
+            }
+            return 0;
+        }
+
+        aux::spike_emitter emit(out);
+        std::vector<arb::spike> spikes;
+        for (const auto& f: files) {
+            auto s = arb::spike_file(f).spikes(t0, t1);
+            if (sort) {
+                spikes.insert(spikes.end(), s.begin(), s.end());
+            }
+            else {
+                emit(s);
+            }
+        }
+
+        if (sort) {
+            std::sort(spikes.begin(), spikes.end(),
+                [](const arb::spike& a, const arb::spike& b) {
+                    return a.time<b.time || (a.time==b.time && a.source<b.source);
+                });
+            emit(spikes);
+        }
+
+        if (!out.flush()) {
+            throw std::runtime_error("write failed");
+        }
+    }
+    catch (to::parse_opt_error& e) {
+        std::cerr << argv[0] << ": " << e.what() << "\n";
+        std::cerr << "Try '" << argv[0] << " --help' for more information.\n";
+        std::exit(2);
+    }
+    catch (std::exception& e) {
+        std::cerr << "caught exception: " << e.what() << "\n";
+        std::exit(1);
+    }
+}
@@ -0,0 +1,109 @@
+// Compare the Hines matrix solve of the multicore back end for cells
+// discretized with CVs in segment order and in depth-first order.
+//
+// A cell group of ncells cells with morphologies generated by the lmorpho
+// L-system models is discretized, and the matrix assembled and solved.
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include <arbor/mc_cell.hpp>
+#include <arbor/morphology.hpp>
+
+#include "backends/multicore/fvm.hpp"
+#include "backends/multicore/matrix_state.hpp"
+#include "benchmark/benchmark.h"
+#include "fvm_layout.hpp"
+#include "util/span.hpp"
+
+#include "lsystem.hpp"
+#include "lsys_models.hpp"
+
+using namespace arb;
+
+using value_type = fvm_value_type;
+using index_type = fvm_index_type;
+using array = multicore::array;
+using matrix_state = multicore::matrix_state<value_type, index_type>;
+
+// Morphologies of a model, discretized with CVs of at most 10 µm.
+std::vector<mc_cell> make_cells(unsigned ncells, const lsys_param& model) {
+    lsys_generator g(42);
+    std::vector<mc_cell> cells;
+    for (auto i: util::make_span(ncells)) {
+        (void)i;
+        auto morph = generate_morphology(model, g);
+        morph.segment(10);
+        cells.push_back(make_mc_cell(morph, true));
+    }
+    return cells;
+}
+
+const lsys_param& model(int i) {
+    return i? alpha_motoneuron_lsys: purkinje_lsys;
+}
+
+template <typename F>
+void run(benchmark::State& state, cv_ordering order, F&& step) {
+    auto D = fvm_discretize(make_cells(state.range(1), model(state.range(0))), order);
+    matrix_state s(D.parent_cv, D.cell_cv_bounds, D.cv_capacitance, D.face_conductance, D.cv_area);
+
+    array dt(D.ncell, 0.025);
+    array voltage(D.ncomp, -65.);
+    array current(D.ncomp, 0.1);
+
+    // Mean distance between the indices of a CV and its parent.
+    double distance = 0;
+    for (auto i: util::make_span(D.ncomp)) {
+        distance += std::abs(index_type(i)-D.parent_cv[i]);
+    }
+    state.counters["parent_distance"] = distance/D.ncomp;
+    state.counters["cvs"] = D.ncomp;
+
+    while (state.KeepRunning()) {
+        step(s, dt, voltage, current);
+        benchmark::ClobberMemory();
+    }
+}
+
+void solve(matrix_state& s, const array& dt, array& voltage, const array& current) {
+    s.assemble(dt, voltage, current);
+    s.solve();
+    std::copy(s.solution().begin(), s.solution().end(), voltage.begin());
+}
+
+void assemble_and_solve(matrix_state& s, const array& dt, array& voltage, const array& current) {
+    s.assemble_and_solve(dt, voltage, current);
+}
+
+void segment_order(benchmark::State& state) {
+    run(state, cv_ordering::segment, solve);
+}
+
+void segment_order_fused(benchmark::State& state) {
+    run(state, cv_ordering::segment, assemble_and_solve);
+}
+
+void depth_first(benchmark::State& state) {
+    run(state, cv_ordering::depth_first, solve);
+}
+
+void depth_first_fused(benchmark::State& state) {
+    run(state, cv_ordering::depth_first, assemble_and_solve);
+}
+
+void run_custom_arguments(benchmark::internal::Benchmark* b) {
+    for (auto model: {0, 1}) {
+        for (auto ncells: {1, 16, 256}) {
+            b->Args({model, ncells});
+        }
+    }
+}
+
+BENCHMARK(segment_order)->Apply(run_custom_arguments);
+BENCHMARK(segment_order_fused)->Apply(run_custom_arguments);
+BENCHMARK(depth_first)->Apply(run_custom_arguments);
+BENCHMARK(depth_first_fused)->Apply(run_custom_arguments);
+
+BENCHMARK_MAIN();
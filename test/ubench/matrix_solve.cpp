@@ -0,0 +1,147 @@
+// Compare the flat and interleaved Hines matrix solvers of the multicore
+// back end, with assembly, solve and copy of the solution to the voltage
+// performed in turn, or fused in one call.
+//
+// A cell group of ncells cells with branched morphologies of about ncv CVs
+// is assembled and solved. The cells either all have the same morphology,
+// or each has a different random morphology.
+//
+// The fused flat solver is also run with a number of threads, with which the
+// matrices of large cells are decomposed into subtrees solved in parallel.
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <arbor/context.hpp>
+
+#include "backends/multicore/fvm.hpp"
+#include "backends/multicore/matrix_state.hpp"
+#include "backends/multicore/matrix_state_interleaved.hpp"
+#include "benchmark/benchmark.h"
+#include "execution_context.hpp"
+#include "util/span.hpp"
+
+using namespace arb;
+
+using value_type = fvm_value_type;
+using index_type = fvm_index_type;
+using array = multicore::array;
+
+struct cell_group_matrix {
+    std::vector<index_type> p;
+    std::vector<index_type> cell_cv_divs = {0};
+    std::vector<value_type> cv_capacitance, face_conductance, cv_area;
+    array dt, voltage, current;
+
+    cell_group_matrix(unsigned ncells, unsigned ncv, bool same_morphology) {
+        std::mt19937 gen(42);
+        std::uniform_int_distribution<unsigned> size(ncv/2, ncv+ncv/2);
+        std::uniform_real_distribution<value_type> value(0.5, 2.);
+
+        for (auto c: util::make_span(ncells)) {
+            if (same_morphology) gen.seed(42);
+            (void)c;
+            index_type first = cell_cv_divs.back();
+            index_type n = size(gen);
+
+            // Unbranched sections of 8 CVs, attached to a random earlier CV.
+            p.push_back(first);
+            for (auto i: util::make_span(1, n)) {
+                p.push_back(i%8? first+i-1: first+std::uniform_int_distribution<index_type>(0, i-1)(gen));
+            }
+            cell_cv_divs.push_back(first+n);
+        }
+
+        auto n = p.size();
+        for (auto i: util::make_span(n)) {
+            (void)i;
+            cv_capacitance.push_back(value(gen));
+            face_conductance.push_back(value(gen));
+            cv_area.push_back(value(gen));
+        }
+        dt = array(ncells, 0.025);
+        voltage = array(n, -65.);
+        current = array(n, 0.1);
+    }
+};
+
+template <typename State>
+void solve(benchmark::State& state) {
+    cell_group_matrix m(state.range(0), state.range(1), state.range(2));
+    State s(m.p, m.cell_cv_divs, m.cv_capacitance, m.face_conductance, m.cv_area);
+
+    while (state.KeepRunning()) {
+        s.assemble(m.dt, m.voltage, m.current);
+        s.solve();
+        std::copy(s.solution().begin(), s.solution().end(), m.voltage.begin());
+        benchmark::ClobberMemory();
+    }
+}
+
+template <typename State>
+void assemble_and_solve(benchmark::State& state) {
+    cell_group_matrix m(state.range(0), state.range(1), state.range(2));
+    State s(m.p, m.cell_cv_divs, m.cv_capacitance, m.face_conductance, m.cv_area);
+
+    while (state.KeepRunning()) {
+        s.assemble_and_solve(m.dt, m.voltage, m.current);
+        benchmark::ClobberMemory();
+    }
+}
+
+void flat(benchmark::State& state) {
+    solve<multicore::matrix_state<value_type, index_type>>(state);
+}
+
+void flat_fused(benchmark::State& state) {
+    assemble_and_solve<multicore::matrix_state<value_type, index_type>>(state);
+}
+
+void interleaved(benchmark::State& state) {
+    solve<multicore::matrix_state_interleaved<value_type, index_type>>(state);
+}
+
+void interleaved_fused(benchmark::State& state) {
+    assemble_and_solve<multicore::matrix_state_interleaved<value_type, index_type>>(state);
+}
+
+void flat_fused_threads(benchmark::State& state) {
+    cell_group_matrix m(state.range(0), state.range(1), false);
+    execution_context context(proc_allocation(state.range(2), -1));
+    multicore::matrix_state<value_type, index_type> s(
+        m.p, m.cell_cv_divs, m.cv_capacitance, m.face_conductance, m.cv_area, context);
+
+    while (state.KeepRunning()) {
+        s.assemble_and_solve(m.dt, m.voltage, m.current);
+        benchmark::ClobberMemory();
+    }
+}
+
+void run_custom_arguments(benchmark::internal::Benchmark* b) {
+    for (auto ncells: {1, 4, 16, 64, 256, 1024}) {
+        for (auto ncv: {16, 128, 1024}) {
+            for (auto same_morphology: {0, 1}) {
+                b->Args({ncells, ncv, same_morphology});
+            }
+        }
+    }
+}
+
+void run_thread_arguments(benchmark::internal::Benchmark* b) {
+    for (auto ncells: {1, 4}) {
+        for (auto ncv: {16384, 65536, 262144}) {
+            for (auto nthreads: {1, 2, 4, 8}) {
+                b->Args({ncells, ncv, nthreads});
+            }
+        }
+    }
+}
+
+BENCHMARK(flat)->Apply(run_custom_arguments);
+BENCHMARK(flat_fused)->Apply(run_custom_arguments);
+BENCHMARK(interleaved)->Apply(run_custom_arguments);
+BENCHMARK(interleaved_fused)->Apply(run_custom_arguments);
+BENCHMARK(flat_fused_threads)->Apply(run_thread_arguments)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -1,18 +1,22 @@
-// Test performance of vectorization for mechanism implementations.
+// Test performance of the task system.
 //
-// Start with pas (passive dendrite) mechanism
+// Compares the notification queue and work-stealing schedulers on balanced
+// and imbalanced workloads.
 
 #include <chrono>
 #include <iostream>
 #include <thread>
+#include <vector>
 
 #include <arbor/version.hpp>
 
 #include "threading/threading.hpp"
+#include "threading/thread_info.hpp"
 
 #include <benchmark/benchmark.h>
 
 using namespace arb;
+using threading::scheduler_kind;
 
 void run(unsigned long us_per_task, unsigned tasks, threading::task_system* ts) {
     auto duration = std::chrono::microseconds(us_per_task);
@@ -33,11 +37,77 @@ void task_test(benchmark::State& state) {
     }
 }
 
+// Busy wait, so that the cost of a task is CPU time, not sleep.
+void spin_for(std::chrono::nanoseconds d) {
+    using clock = std::chrono::steady_clock;
+    auto until = clock::now()+d;
+    while (clock::now()<until);
+}
+
+// Imbalanced workload, modelled on cell groups of very different cost:
+// one task in every 16 is 64 times more expensive than the others, and the
+// expensive tasks are clustered at the start of the range, so that a
+// round-robin deal of tasks to threads leaves some threads with most of the
+// work. Each task spawns a nested parallel_for, as a cell group that uses
+// the thread pool internally would.
+void imbalanced_test(benchmark::State& state) {
+    const auto kind = static_cast<scheduler_kind>(state.range(0));
+    const unsigned ns_per_task = state.range(1);
+    threading::task_system ts(threading::num_threads_init(), kind);
+
+    const unsigned num_tasks = 1024;
+    const unsigned num_heavy = num_tasks/16;
+    const unsigned num_nested = 4;
+
+    auto cost = [&](unsigned i) {
+        return std::chrono::nanoseconds(i<num_heavy? 64*ns_per_task: ns_per_task);
+    };
+
+    while (state.KeepRunning()) {
+        threading::parallel_for::apply(0, num_tasks, &ts,
+            [&](unsigned i) {
+                threading::parallel_for::apply(0, num_nested, &ts,
+                    [&](unsigned) { spin_for(cost(i)/num_nested); });
+            });
+    }
+}
+
+// Many tiny tasks: measures scheduling overhead and queue contention.
+void overhead_test(benchmark::State& state) {
+    const auto kind = static_cast<scheduler_kind>(state.range(0));
+    const unsigned num_tasks = state.range(1);
+    threading::task_system ts(threading::num_threads_init(), kind);
+
+    std::vector<unsigned> v(num_tasks);
+    while (state.KeepRunning()) {
+        threading::parallel_for::apply(0, num_tasks, &ts, [&](unsigned i) { v[i] = i; });
+        benchmark::ClobberMemory();
+    }
+}
+
 void us_per_task(benchmark::internal::Benchmark *b) {
     for (auto ncomps: {100, 250, 500, 1000, 10000}) {
         b->Args({ncomps});
     }
 }
 
+void kind_ns_per_task(benchmark::internal::Benchmark *b) {
+    for (auto kind: {scheduler_kind::notification_queues, scheduler_kind::work_stealing}) {
+        for (auto ns: {1000, 10000, 100000}) {
+            b->Args({static_cast<int>(kind), ns});
+        }
+    }
+}
+
+void kind_num_tasks(benchmark::internal::Benchmark *b) {
+    for (auto kind: {scheduler_kind::notification_queues, scheduler_kind::work_stealing}) {
+        for (auto n: {1000, 100000}) {
+            b->Args({static_cast<int>(kind), n});
+        }
+    }
+}
+
 BENCHMARK(task_test)->Apply(us_per_task);
+BENCHMARK(imbalanced_test)->Apply(kind_ns_per_task)->UseRealTime();
+BENCHMARK(overhead_test)->Apply(kind_num_tasks)->UseRealTime();
 BENCHMARK_MAIN();
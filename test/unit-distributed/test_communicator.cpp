@@ -2,6 +2,7 @@
 #include "test.hpp"
 
 #include <stdexcept>
+#include <limits>
 #include <vector>
 
 #include <arbor/domain_decomposition.hpp>
@@ -140,6 +141,54 @@ TEST(communicator, gather_spikes_variant) {
     }
 }
 
+// Test non-blocking spike gather, with a collective and with pairwise
+// messages: the spikes of every domain are returned once, and finish() gives
+// the same result as gather_spikes.
+TEST(communicator, start_gather_spikes) {
+    const auto num_domains = g_context->distributed->size();
+    const auto rank = g_context->distributed->id();
+
+    // Domain i generates 3*i spikes.
+    auto make_local = [](int rank, int value) {
+        std::vector<spike> spikes;
+        for (auto i=0; i<3*rank; ++i) {
+            spikes.push_back(gen_spike(3*rank*(rank-1)/2+i, value));
+        }
+        return spikes;
+    };
+    const auto local = make_local(rank, rank);
+    const auto expected = g_context->distributed->gather_spikes(local);
+
+    for (bool pairwise: {false, true}) {
+        SCOPED_TRACE(pairwise? "pairwise": "collective");
+
+        auto request = g_context->distributed->start_gather_spikes(local, pairwise);
+        EXPECT_EQ(unsigned(num_domains), request.size());
+
+        // Start the next gather before the first is complete.
+        auto next_request = g_context->distributed->start_gather_spikes(make_local(rank, rank+1), pairwise);
+
+        std::vector<int> seen(num_domains);
+        for (int dom = request.next(); dom>=0; dom = request.next()) {
+            ASSERT_LT(dom, num_domains);
+            ++seen[dom];
+            auto values = request.values(dom);
+            EXPECT_EQ(make_local(dom, dom), std::vector<spike>(values.first, values.second));
+        }
+        EXPECT_EQ(std::vector<int>(num_domains, 1), seen);
+
+        const auto& gathered = request.finish();
+        EXPECT_EQ(expected.partition(), gathered.partition());
+        EXPECT_EQ(expected.values(), gathered.values());
+
+        const auto& next_gathered = next_request.finish();
+        EXPECT_EQ(expected.partition(), next_gathered.partition());
+        for (auto i=0u; i<next_gathered.size(); ++i) {
+            EXPECT_EQ(get_value(expected.values()[i])+1, get_value(next_gathered.values()[i]));
+        }
+    }
+}
+
 namespace {
     // Population of cable and rss cells with ring connection topology.
     // Even gid are rss, and odd gid are cable cells.
@@ -292,18 +341,27 @@ test_ring(const domain_decomposition& D, communicator& C, F&& f) {
     // of source gid.
     std::reverse(local_spikes.begin(), local_spikes.end());
 
-    // gather the global set of spikes
-    auto global_spikes = C.exchange(local_spikes);
-    if (global_spikes.size()!=g_context->distributed->sum(local_spikes.size())) {
+    // gather the global set of spikes, and generate the events
+    std::vector<arb::pse_vector> queues(C.num_local_cells());
+    std::vector<spike> global_spikes;
+    if (C.compression()) {
+        auto global_packed = C.exchange_packed(local_spikes);
+        global_spikes = unpack_spikes(global_packed);
+        C.make_event_queues(global_packed, queues);
+    }
+    else {
+        auto gathered = C.exchange(local_spikes);
+        global_spikes = gathered.values();
+        C.make_event_queues(gathered, queues);
+    }
+
+    const bool gather = C.exchange_policy()==spike_exchange_policy::gather;
+    if (gather && global_spikes.size()!=g_context->distributed->sum(local_spikes.size())) {
         return ::testing::AssertionFailure() << "the number of gathered spikes "
             << global_spikes.size() << " doesn't match the expected "
             << g_context->distributed->sum(local_spikes.size());
     }
 
-    // generate the events
-    std::vector<arb::pse_vector> queues(C.num_local_cells());
-    C.make_event_queues(global_spikes, queues);
-
     // Assert that all the correct events were generated.
     // Iterate over each local gid, and testing whether an event is expected for
     // that gid. If so, look up the event queue of the cell_group of gid, and
@@ -323,6 +381,13 @@ test_ring(const domain_decomposition& D, communicator& C, F&& f) {
         }
     }
 
+    // Every source in the ring has one target, so with point to point
+    // exchange each domain receives exactly one spike per expected event.
+    if (!gather && (int)global_spikes.size()!=expected_count) {
+        return ::testing::AssertionFailure() << "the number of received spikes "
+            << global_spikes.size() << " doesn't match the expected " << expected_count;
+    }
+
     // Assert that only the expected events were produced. The preceding test
     // showed that all expected events were generated, so this only requires
     // that the number of generated events is as expected.
@@ -354,6 +419,38 @@ TEST(communicator, ring)
     const auto D = partition_load_balance(R, g_context);
     auto C = communicator(R, D, *g_context);
 
+    // Each domain has connections with delay 1 from itself and the
+    // preceding domain.
+    unsigned I = g_context->distributed->id();
+    const auto no_delay = std::numeric_limits<time_type>::max();
+    for (unsigned dom: make_span(N)) {
+        bool connected = dom==I || dom==(I+N-1)%N;
+        EXPECT_EQ(connected? 1.f: no_delay, C.min_delay_from(dom));
+    }
+    EXPECT_EQ(N>1? 1.f: no_delay, C.min_remote_delay());
+
+    // every cell fires
+    EXPECT_TRUE(test_ring(D, C, [](cell_gid_type g){return true;}));
+    // last cell in each domain fires
+    EXPECT_TRUE(test_ring(D, C, [n_local](cell_gid_type g){return (g+1)%n_local == 0u;}));
+    // even-numbered cells fire
+    EXPECT_TRUE(test_ring(D, C, [](cell_gid_type g){return g%2==0;}));
+    // odd-numbered cells fire
+    EXPECT_TRUE(test_ring(D, C, [](cell_gid_type g){return g%2==1;}));
+}
+
+TEST(communicator, ring_point_to_point)
+{
+    unsigned N = g_context->distributed->size();
+
+    unsigned n_local = 10u;
+    unsigned n_global = n_local*N;
+
+    auto R = ring_recipe(n_global);
+    const auto D = partition_load_balance(R, g_context);
+    auto C = communicator(R, D, *g_context);
+    C.set_exchange_policy(spike_exchange_policy::point_to_point);
+
     // every cell fires
     EXPECT_TRUE(test_ring(D, C, [](cell_gid_type g){return true;}));
     // last cell in each domain fires
@@ -362,6 +459,43 @@ TEST(communicator, ring)
     EXPECT_TRUE(test_ring(D, C, [](cell_gid_type g){return g%2==0;}));
     // odd-numbered cells fire
     EXPECT_TRUE(test_ring(D, C, [](cell_gid_type g){return g%2==1;}));
+    // no cells fire
+    EXPECT_TRUE(test_ring(D, C, [](cell_gid_type g){return false;}));
+
+    // the global spike count is maintained by point to point exchange,
+    // once the local counts are reduced
+    C.reset();
+    test_ring(D, C, [](cell_gid_type g){return true;});
+    EXPECT_EQ(0u, C.num_spikes());
+    C.reduce_num_spikes();
+    EXPECT_EQ(n_global, C.num_spikes());
+}
+
+TEST(communicator, ring_packed)
+{
+    unsigned N = g_context->distributed->size();
+
+    unsigned n_local = 10u;
+    unsigned n_global = n_local*N;
+
+    auto R = ring_recipe(n_global);
+    const auto D = partition_load_balance(R, g_context);
+    auto C = communicator(R, D, *g_context);
+    C.set_compression(true);
+    EXPECT_TRUE(C.compression());
+
+    // every cell fires
+    EXPECT_TRUE(test_ring(D, C, [](cell_gid_type g){return true;}));
+    // last cell in each domain fires
+    EXPECT_TRUE(test_ring(D, C, [n_local](cell_gid_type g){return (g+1)%n_local == 0u;}));
+    // even-numbered cells fire
+    EXPECT_TRUE(test_ring(D, C, [](cell_gid_type g){return g%2==0;}));
+    // no cells fire
+    EXPECT_TRUE(test_ring(D, C, [](cell_gid_type g){return false;}));
+
+    C.reset();
+    test_ring(D, C, [](cell_gid_type g){return true;});
+    EXPECT_EQ(n_global, C.num_spikes());
 }
 
 template <typename F>
@@ -430,6 +564,13 @@ test_all2all(const domain_decomposition& D, communicator& C, F&& f) {
             " does not match expected count " << expected_count;
     }
 
+    // Assert that the events in each queue are sorted.
+    for (auto& q: queues) {
+        if (!std::is_sorted(q.begin(), q.end())) {
+            return ::testing::AssertionFailure() << "event queue is not sorted";
+        }
+    }
+
     return ::testing::AssertionSuccess();
 }
 
@@ -458,3 +599,96 @@ TEST(communicator, all2all)
     // odd-numbered cells fire
     EXPECT_TRUE(test_all2all(D, C, [](cell_gid_type g){return g%2==1;}));
 }
+
+TEST(communicator, all2all_point_to_point)
+{
+    unsigned N = g_context->distributed->size();
+
+    unsigned n_local = 10u;
+    unsigned n_global = n_local*N;
+
+    auto R = all2all_recipe(n_global);
+    const auto D = partition_load_balance(R, g_context);
+    auto C = communicator(R, D, *g_context);
+    C.set_exchange_policy(spike_exchange_policy::point_to_point);
+
+    // every cell fires
+    EXPECT_TRUE(test_all2all(D, C, [](cell_gid_type g){return true;}));
+    // only cell 0 fires
+    EXPECT_TRUE(test_all2all(D, C, [](cell_gid_type g){return g==0u;}));
+    // even-numbered cells fire
+    EXPECT_TRUE(test_all2all(D, C, [](cell_gid_type g){return g%2==0;}));
+    // odd-numbered cells fire
+    EXPECT_TRUE(test_all2all(D, C, [](cell_gid_type g){return g%2==1;}));
+}
+
+// Events generated by an exchange with start_exchange and finish_exchange
+// are the same as those generated by exchange and make_event_queues.
+TEST(communicator, nonblocking_exchange)
+{
+    using util::transform_view;
+    using util::assign_from;
+    using util::filter;
+
+    unsigned N = g_context->distributed->size();
+    unsigned n_global = 10u*N;
+
+    auto R = all2all_recipe(n_global);
+    const auto D = partition_load_balance(R, g_context);
+    auto C = communicator(R, D, *g_context);
+
+    auto gids = get_gids(D);
+    std::vector<spike> local_spikes = assign_from(
+        transform_view(filter(gids, [](cell_gid_type g) { return g%3==0; }), make_spike));
+    std::reverse(local_spikes.begin(), local_spikes.end());
+
+    auto test_exchange = [&]() {
+        std::vector<pse_vector> expected(C.num_local_cells());
+        std::vector<spike> expected_spikes;
+        if (C.compression()) {
+            auto packed = C.exchange_packed(local_spikes);
+            expected_spikes = unpack_spikes(packed);
+            C.make_event_queues(packed, expected);
+        }
+        else {
+            auto gathered = C.exchange(local_spikes);
+            expected_spikes = gathered.values();
+            C.make_event_queues(gathered, expected);
+        }
+
+        C.reset();
+        std::vector<pse_vector> queues(C.num_local_cells());
+        auto ex = C.start_exchange(local_spikes);
+        C.finish_exchange(ex, queues);
+
+        EXPECT_EQ(expected, queues);
+        EXPECT_EQ(expected_spikes, ex.spikes());
+        C.reduce_num_spikes();
+        EXPECT_EQ((n_global+2)/3, C.num_spikes());
+    };
+
+    {
+        SCOPED_TRACE("gather");
+        test_exchange();
+    }
+    {
+        SCOPED_TRACE("packed");
+        C.set_compression(true);
+        test_exchange();
+        C.set_compression(false);
+    }
+    {
+        SCOPED_TRACE("pairwise");
+        C.set_pairwise_gather(true);
+        test_exchange();
+        C.set_compression(true);
+        test_exchange();
+        C.set_compression(false);
+        C.set_pairwise_gather(false);
+    }
+    {
+        SCOPED_TRACE("point to point");
+        C.set_exchange_policy(spike_exchange_policy::point_to_point);
+        test_exchange();
+    }
+}
@@ -3,6 +3,7 @@
 #include <cstdio>
 #include <fstream>
 #include <iostream>
+#include <set>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -67,6 +68,40 @@ namespace {
     private:
         cell_size_type size_;
     };
+
+    // Cable cells in num_clusters clusters, where cell gid is in cluster
+    // gid%num_clusters, and every cell has a connection from every other cell
+    // in its cluster.
+    class cluster_recipe: public recipe {
+    public:
+        cluster_recipe(cell_size_type s, cell_size_type num_clusters):
+            size_(s), num_clusters_(num_clusters)
+        {}
+
+        cell_size_type num_cells() const override {
+            return size_;
+        }
+
+        util::unique_any get_cell_description(cell_gid_type) const override {
+            return {};
+        }
+
+        cell_kind get_cell_kind(cell_gid_type) const override {
+            return cell_kind::cable1d_neuron;
+        }
+
+        std::vector<cell_connection> connections_on(cell_gid_type gid) const override {
+            std::vector<cell_connection> cons;
+            for (cell_gid_type src = gid%num_clusters_; src<size_; src += num_clusters_) {
+                if (src!=gid) cons.push_back({{src, 0}, {gid, 0}, 1.f, 1.f});
+            }
+            return cons;
+        }
+
+    private:
+        cell_size_type size_;
+        cell_size_type num_clusters_;
+    };
 }
 
 TEST(domain_decomposition, homogeneous_population_mc) {
@@ -217,3 +252,39 @@ TEST(domain_decomposition, heterogeneous_population) {
     }
 }
 
+
+TEST(domain_decomposition, graph_partition) {
+    // One cluster of 8 cells per domain, interleaved by gid: every cluster
+    // is expected to be placed on a domain of its own.
+    proc_allocation resources{1, -1};
+#ifdef ARB_TEST_MPI
+    auto ctx = make_context(resources, MPI_COMM_WORLD);
+#else
+    auto ctx = make_context(resources);
+#endif
+
+    const unsigned N = arb::num_ranks(ctx);
+    const unsigned I = arb::rank(ctx);
+
+    const unsigned n_local = 8;
+    const unsigned n_global = n_local*N;
+    const auto D = partition_graph_load_balance(cluster_recipe(n_global, N), ctx);
+
+    EXPECT_EQ(D.num_global_cells, n_global);
+    EXPECT_EQ(D.num_local_cells, n_local);
+
+    std::set<int> cluster_domains;
+    for (unsigned c = 0; c<N; ++c) {
+        cluster_domains.insert(D.gid_domain(c));
+    }
+    EXPECT_EQ(N, cluster_domains.size());
+
+    for (unsigned gid = 0; gid<n_global; ++gid) {
+        EXPECT_EQ(D.gid_domain(gid%N), D.gid_domain(gid));
+    }
+    for (auto& grp: D.groups) {
+        for (auto gid: grp.gids) {
+            EXPECT_EQ(I, (unsigned)D.gid_domain(gid));
+        }
+    }
+}
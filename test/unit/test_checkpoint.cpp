@@ -0,0 +1,233 @@
+#include "../gtest.h"
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/context.hpp>
+#include <arbor/domain_decomposition.hpp>
+#include <arbor/event_generator.hpp>
+#include <arbor/lif_cell.hpp>
+#include <arbor/load_balance.hpp>
+#include <arbor/mc_cell.hpp>
+#include <arbor/recipe.hpp>
+#include <arbor/schedule.hpp>
+#include <arbor/simulation.hpp>
+#include <arbor/spike.hpp>
+#include <arbor/spike_source_cell.hpp>
+
+#include "../common_cells.hpp"
+
+using namespace arb;
+
+namespace {
+    // A regularly spiking cell (gid 0), driving a ring of LIF cells, and
+    // multicompartment cells that receive Poisson distributed events and
+    // spikes from the first cell, and connect to the LIF cells.
+    class mixed_recipe: public recipe {
+    public:
+        mixed_recipe(cell_size_type n_lif, cell_size_type n_mc):
+            n_lif_(n_lif), n_mc_(n_mc)
+        {}
+
+        cell_size_type num_cells() const override {
+            return 1+n_lif_+n_mc_;
+        }
+
+        cell_kind get_cell_kind(cell_gid_type gid) const override {
+            return gid==0? cell_kind::spike_source:
+                   gid<=n_lif_? cell_kind::lif_neuron:
+                   cell_kind::cable1d_neuron;
+        }
+
+        util::unique_any get_cell_description(cell_gid_type gid) const override {
+            switch (get_cell_kind(gid)) {
+            case cell_kind::spike_source:
+                return spike_source_cell{regular_schedule(0., 7.)};
+            case cell_kind::lif_neuron:
+                return lif_cell();
+            default:
+                auto c = make_cell_ball_and_stick(false);
+                c.add_synapse({0, 0.5}, "expsyn");
+                c.add_detector({0, 0}, -10);
+                return c;
+            }
+        }
+
+        std::vector<cell_connection> connections_on(cell_gid_type gid) const override {
+            std::vector<cell_connection> conns;
+            if (gid==0) {
+                return conns;
+            }
+            if (gid<=n_lif_) {
+                conns.push_back(cell_connection({gid==1? n_lif_: gid-1, 0}, {gid, 0}, 1000.f, 2.f));
+                if (gid==1) {
+                    conns.push_back(cell_connection({0, 0}, {gid, 0}, 1000.f, 1.5f));
+                }
+                if (n_mc_) {
+                    conns.push_back(cell_connection({n_lif_+1+gid%n_mc_, 0}, {gid, 0}, 1000.f, 3.f));
+                }
+            }
+            else {
+                conns.push_back(cell_connection({0, 0}, {gid, 0}, 0.2f, 2.5f));
+            }
+            return conns;
+        }
+
+        std::vector<event_generator> event_generators(cell_gid_type gid) const override {
+            if (get_cell_kind(gid)!=cell_kind::cable1d_neuron) {
+                return {};
+            }
+            return {poisson_generator({gid, 0}, 0.1f, 0., 1., std::minstd_rand(gid))};
+        }
+
+        cell_size_type num_sources(cell_gid_type gid) const override { return 1; }
+        cell_size_type num_targets(cell_gid_type gid) const override { return gid? 1: 0; }
+        cell_size_type num_probes(cell_gid_type) const override { return 0; }
+
+    private:
+        cell_size_type n_lif_, n_mc_;
+    };
+
+    void record_spikes(simulation& sim, std::vector<spike>& spikes) {
+        sim.set_global_spike_callback(
+            [&spikes](const std::vector<spike>& s) {
+                spikes.insert(spikes.end(), s.begin(), s.end());
+            });
+    }
+
+    bool same_spikes(std::vector<spike> a, std::vector<spike> b) {
+        auto less = [](const spike& a, const spike& b) {
+            return a.time<b.time || (a.time==b.time && a.source<b.source);
+        };
+        std::sort(a.begin(), a.end(), less);
+        std::sort(b.begin(), b.end(), less);
+        return a==b;
+    }
+}
+
+TEST(checkpoint, restore) {
+    // A simulation restored from a checkpoint produces the same spikes as
+    // the simulation that wrote the checkpoint.
+    const time_type dt = 0.025;
+    mixed_recipe rec(6, 3);
+    auto ctx = make_context();
+    auto decomp = partition_load_balance(rec, ctx);
+
+    simulation sim(rec, decomp, ctx);
+    std::vector<spike> before;
+    record_spikes(sim, before);
+    sim.run(21, dt);
+
+    std::stringstream s;
+    sim.checkpoint(s);
+    std::vector<spike> expected;
+    record_spikes(sim, expected);
+    sim.run(60, dt);
+    sim.wait_checkpoint();
+
+    // Sanity check: all kinds of cells generate spikes after the checkpoint.
+    ASSERT_FALSE(before.empty());
+    for (cell_gid_type gid: {0u, 1u, 7u}) {
+        EXPECT_TRUE(std::any_of(expected.begin(), expected.end(),
+            [gid](const spike& s) { return s.source.gid==gid; })) << "gid " << gid;
+    }
+
+    simulation restored(rec, decomp, ctx);
+    std::vector<spike> spikes;
+    record_spikes(restored, spikes);
+    restored.restore(s);
+    restored.run(60, dt);
+
+    EXPECT_TRUE(same_spikes(expected, spikes));
+    EXPECT_EQ(sim.num_spikes(), restored.num_spikes());
+
+    // A checkpoint can be restored more than once, and restoring replaces
+    // the state of a simulation that has already run.
+    spikes.clear();
+    s.seekg(0);
+    restored.restore(s);
+    restored.run(60, dt);
+    EXPECT_TRUE(same_spikes(expected, spikes));
+}
+
+TEST(checkpoint, thread_count) {
+    // A checkpoint can be restored with a different number of threads. The
+    // multicompartment cells are in one cell group, which is integrated in
+    // blocks of cells.
+    const time_type dt = 0.025;
+    mixed_recipe rec(4, 40);
+
+    partition_hint_map hints;
+    hints[cell_kind::cable1d_neuron].cpu_group_size = partition_hint::max_size;
+
+    auto run = [&](unsigned write_threads, unsigned read_threads) {
+        auto ctx = make_context(proc_allocation(write_threads, -1));
+        auto decomp = partition_load_balance(rec, ctx, hints);
+
+        simulation sim(rec, decomp, ctx);
+        sim.run(21, dt);
+        std::stringstream s;
+        sim.checkpoint(s);
+        std::vector<spike> expected;
+        record_spikes(sim, expected);
+        sim.run(50, dt);
+        sim.wait_checkpoint();
+
+        auto read_ctx = make_context(proc_allocation(read_threads, -1));
+        simulation restored(rec, partition_load_balance(rec, read_ctx, hints), read_ctx);
+        std::vector<spike> spikes;
+        record_spikes(restored, spikes);
+        restored.restore(s);
+        restored.run(50, dt);
+
+        EXPECT_FALSE(expected.empty());
+        EXPECT_TRUE(same_spikes(expected, spikes));
+    };
+
+    run(1, 4);
+    run(4, 1);
+}
+
+TEST(checkpoint, errors) {
+    mixed_recipe rec(6, 3);
+    auto ctx = make_context();
+    simulation sim(rec, partition_load_balance(rec, ctx), ctx);
+    sim.run(5, 0.025);
+
+    std::stringstream s;
+    sim.checkpoint(s);
+    sim.wait_checkpoint();
+    const std::string data = s.str();
+
+    // Not a checkpoint.
+    {
+        std::stringstream in("this is not a checkpoint, but it is long enough for a header");
+        EXPECT_THROW(sim.restore(in), bad_checkpoint);
+    }
+
+    // Truncated checkpoint.
+    {
+        std::stringstream in(data.substr(0, data.size()-1));
+        EXPECT_THROW(sim.restore(in), bad_checkpoint);
+    }
+
+    // Checkpoint of a different model.
+    {
+        mixed_recipe other(7, 3);
+        simulation other_sim(other, partition_load_balance(other, ctx), ctx);
+        std::stringstream in(data);
+        EXPECT_THROW(other_sim.restore(in), bad_checkpoint);
+    }
+
+    // Failure to write a checkpoint is reported by wait_checkpoint.
+    {
+        std::stringstream out;
+        out.setstate(std::ios::badbit);
+        sim.checkpoint(out);
+        EXPECT_THROW(sim.wait_checkpoint(), bad_checkpoint);
+    }
+}
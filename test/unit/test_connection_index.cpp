@@ -0,0 +1,76 @@
+#include "../gtest.h"
+
+#include <vector>
+
+#include <arbor/common_types.hpp>
+
+#include "communication/connection_index.hpp"
+#include "connection.hpp"
+#include "util/span.hpp"
+
+using namespace arb;
+
+TEST(connection_index, empty) {
+    std::vector<connection> cons;
+    connection_index index(cons);
+
+    EXPECT_EQ(0u, index.size());
+    auto r = index.lookup({0, 0});
+    EXPECT_EQ(r.first, r.second);
+
+    connection_index default_index;
+    r = default_index.lookup({0, 0});
+    EXPECT_EQ(r.first, r.second);
+}
+
+TEST(connection_index, lookup) {
+    // Sources (gid, index) with a variable number of connections each,
+    // in source order; gids are not contiguous.
+    std::vector<cell_member_type> sources = {
+        {0, 0}, {0, 1}, {3, 0}, {7, 2}, {1000, 0}, {1u<<20, 5}
+    };
+
+    std::vector<connection> cons;
+    std::vector<std::pair<cell_size_type, cell_size_type>> expected;
+    for (auto i: util::make_span(sources.size())) {
+        cell_size_type first = cons.size();
+        for (auto j: util::make_span(i+1)) {
+            cons.emplace_back(sources[i], cell_member_type{cell_gid_type(j), 0}, 1.f, 1.);
+        }
+        expected.push_back({first, cell_size_type(cons.size())});
+    }
+
+    connection_index index(cons);
+    EXPECT_EQ(sources.size(), index.size());
+
+    for (auto i: util::make_span(sources.size())) {
+        EXPECT_EQ(expected[i], index.lookup(sources[i]));
+    }
+
+    // Sources without connections give an empty range.
+    for (cell_member_type s: {cell_member_type{0, 2}, {1, 0}, {3, 1}, {999, 0}, {1u<<21, 5}}) {
+        auto r = index.lookup(s);
+        EXPECT_EQ(r.first, r.second);
+    }
+}
+
+TEST(connection_index, many) {
+    // Enough sources to exercise collisions and probing.
+    const cell_gid_type n = 10000;
+    std::vector<connection> cons;
+    for (cell_gid_type gid = 0; gid<n; ++gid) {
+        cons.emplace_back(cell_member_type{3*gid, 0}, cell_member_type{gid, 0}, 1.f, 1.);
+    }
+
+    connection_index index(cons);
+    EXPECT_EQ(n, index.size());
+
+    for (cell_gid_type gid = 0; gid<n; ++gid) {
+        auto r = index.lookup({3*gid, 0});
+        EXPECT_EQ(gid, r.first);
+        EXPECT_EQ(gid+1, r.second);
+
+        auto none = index.lookup({3*gid+1, 0});
+        EXPECT_EQ(none.first, none.second);
+    }
+}
@@ -1,7 +1,12 @@
 #include "../gtest.h"
 
+#include <algorithm>
+#include <limits>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 
+#include <arbor/arbexcept.hpp>
 #include <arbor/context.hpp>
 #include <arbor/domain_decomposition.hpp>
 #include <arbor/load_balance.hpp>
@@ -54,6 +59,90 @@ namespace {
     private:
         cell_size_type size_;
     };
+
+    // Cell costs where the first num_heavy cells cost heavy_cost and the
+    // others cost 1.
+    cell_cost_function heavy_cells(cell_gid_type num_heavy, double heavy_cost) {
+        return [=](cell_gid_type gid) { return gid<num_heavy? heavy_cost: 1.; };
+    }
+
+    // Divisions of the gids over domains of the decompositions made by
+    // partition_load_balance on each of num_domains thread ranks.
+    std::vector<std::vector<cell_gid_type>> thread_rank_divisions(
+        const recipe& rec, unsigned num_domains, cell_cost_function cost)
+    {
+        auto ranks = make_thread_ranks(num_domains);
+        std::vector<domain_decomposition> decomps(num_domains);
+
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i<num_domains; ++i) {
+            threads.emplace_back([&, i]() {
+                proc_allocation resources(1, -1);
+                auto ctx = make_context(resources, thread_rank_info(ranks, i));
+                decomps[i] = partition_load_balance(rec, ctx, {}, cost);
+            });
+        }
+        for (auto& t: threads) t.join();
+
+        std::vector<std::vector<cell_gid_type>> divs;
+        for (unsigned i = 0; i<num_domains; ++i) {
+            const auto& D = decomps[i];
+            EXPECT_EQ(rec.num_cells(), D.num_global_cells);
+            EXPECT_EQ(int(i), D.domain_id);
+
+            std::vector<cell_gid_type> d = {0};
+            for (cell_gid_type gid = 1; gid<rec.num_cells(); ++gid) {
+                if (D.gid_domain(gid)!=D.gid_domain(gid-1)) d.push_back(gid);
+            }
+            d.push_back(rec.num_cells());
+            EXPECT_EQ(d[i+1]-d[i], D.num_local_cells);
+            divs.push_back(d);
+        }
+        return divs;
+    }
+
+    // Cable cells in num_clusters clusters, where cell gid is in cluster
+    // gid%num_clusters, and every cell has a connection from every other cell
+    // in its cluster, and one from the next cluster.
+    class cluster_recipe: public recipe {
+    public:
+        cluster_recipe(cell_size_type s, cell_size_type num_clusters):
+            size_(s), num_clusters_(num_clusters)
+        {}
+
+        cell_size_type num_cells() const override {
+            return size_;
+        }
+
+        util::unique_any get_cell_description(cell_gid_type) const override {
+            return {};
+        }
+
+        cell_kind get_cell_kind(cell_gid_type) const override {
+            return cell_kind::cable1d_neuron;
+        }
+
+        std::vector<cell_connection> connections_on(cell_gid_type gid) const override {
+            std::vector<cell_connection> cons;
+            for (cell_gid_type src = gid%num_clusters_; src<size_; src += num_clusters_) {
+                if (src!=gid) cons.push_back({{src, 0}, {gid, 0}, 1.f, 1.f});
+            }
+            cons.push_back({{(gid+1)%size_, 0}, {gid, 0}, 1.f, 1.f});
+            return cons;
+        }
+
+    private:
+        cell_size_type size_;
+        cell_size_type num_clusters_;
+    };
+
+    std::vector<std::vector<cell_gid_type>> group_gids(const domain_decomposition& D) {
+        std::vector<std::vector<cell_gid_type>> gids;
+        for (auto& g: D.groups) {
+            gids.push_back(g.gids);
+        }
+        return gids;
+    }
 }
 
 // test assumes one domain
@@ -251,3 +340,164 @@ TEST(domain_decomposition, hints) {
     EXPECT_EQ(expected_c1d_groups, c1d_groups);
     EXPECT_EQ(expected_ss_groups, ss_groups);
 }
+
+TEST(domain_decomposition, cell_cost) {
+    // Groups of cells with non-uniform cost are balanced by cost, not by
+    // number of cells: 12 cells, where cells 0 and 1 cost 10, and the others
+    // cost 1, in groups of about 4 cells.
+
+    proc_allocation resources;
+    resources.gpu_id = -1;
+    auto ctx = make_context(resources);
+
+    partition_hint_map hints;
+    hints[cell_kind::cable1d_neuron].cpu_group_size = 4;
+
+    {
+        auto D = partition_load_balance(homo_recipe(12, dummy_cell{}), ctx, hints, heavy_cells(2, 10.));
+
+        std::vector<std::vector<cell_gid_type>> expected =
+            {{0}, {1}, {2, 3, 4, 5, 6, 7, 8, 9, 10, 11}};
+        EXPECT_EQ(expected, group_gids(D));
+    }
+
+    {
+        auto D = partition_load_balance(homo_recipe(12, dummy_cell{}), ctx, hints,
+            [](cell_gid_type gid) { return gid<10? 1.: 10.; });
+
+        std::vector<std::vector<cell_gid_type>> expected =
+            {{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}, {10}, {11}};
+        EXPECT_EQ(expected, group_gids(D));
+    }
+
+    {
+        // Uniform costs give groups of the hinted size.
+        auto D = partition_load_balance(homo_recipe(10, dummy_cell{}), ctx, hints,
+            [](cell_gid_type) { return 3.; });
+
+        std::vector<std::vector<cell_gid_type>> expected =
+            {{0, 1, 2, 3}, {4, 5, 6, 7}, {8, 9}};
+        EXPECT_EQ(expected, group_gids(D));
+    }
+
+    EXPECT_THROW(partition_load_balance(homo_recipe(12, dummy_cell{}), ctx, {}, heavy_cells(2, -1.)), arbor_exception);
+    EXPECT_THROW(partition_load_balance(homo_recipe(12, dummy_cell{}), ctx, {}, heavy_cells(2, std::numeric_limits<double>::infinity())), arbor_exception);
+}
+
+TEST(domain_decomposition, cell_cost_domains) {
+    // Cells are divided over domains by cost. Each domain estimates the costs
+    // of a share of the cells, and finds the divisions in its share.
+
+    homo_recipe rec(12, dummy_cell{});
+
+    {
+        // Cells 0-3 cost 5, and the others cost 1, for a total cost of 28
+        // over 3 domains. The divisions closest to costs 28/3 and 56/3 are
+        // before cells 2 and 4, both in the share of domain 0.
+        std::vector<cell_gid_type> expected = {0, 2, 4, 12};
+        for (auto& divs: thread_rank_divisions(rec, 3, heavy_cells(4, 5.))) {
+            EXPECT_EQ(expected, divs);
+        }
+    }
+
+    {
+        // Cell i costs i+1, for a total cost of 78 over 4 domains. The
+        // divisions closest to costs 19.5, 39 and 58.5 are before cells 6,
+        // 8 and 10, in the shares of domains 1, 2 and 3.
+        std::vector<cell_gid_type> expected = {0, 6, 8, 10, 12};
+        auto cost = [](cell_gid_type gid) { return gid+1.; };
+        for (auto& divs: thread_rank_divisions(rec, 4, cost)) {
+            EXPECT_EQ(expected, divs);
+        }
+    }
+
+    {
+        // Without a cost function, or with equal costs, domains have equal
+        // numbers of cells.
+        std::vector<cell_gid_type> expected = {0, 3, 6, 9, 12};
+        for (auto& divs: thread_rank_divisions(rec, 4, {})) {
+            EXPECT_EQ(expected, divs);
+        }
+        for (auto& divs: thread_rank_divisions(rec, 4, [](cell_gid_type) { return 2.; })) {
+            EXPECT_EQ(expected, divs);
+        }
+    }
+}
+
+TEST(domain_decomposition, graph_partition) {
+    // 4 clusters of 16 cells, interleaved by gid, over 4 domains: each
+    // cluster should be placed on its own domain, which a partition into
+    // contiguous ranges of gids can not do.
+
+    const unsigned num_domains = 4;
+    const unsigned num_cells = 64;
+
+    partition_hint_map hints;
+    hints[cell_kind::cable1d_neuron].cpu_group_size = 3;
+
+    auto ranks = make_thread_ranks(num_domains);
+    std::vector<domain_decomposition> decomps(num_domains);
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i<num_domains; ++i) {
+        threads.emplace_back([&, i]() {
+            proc_allocation resources(1, -1);
+            auto ctx = make_context(resources, thread_rank_info(ranks, i));
+            decomps[i] = partition_graph_load_balance(cluster_recipe(num_cells, num_domains), ctx, hints);
+        });
+    }
+    for (auto& t: threads) t.join();
+
+    std::vector<int> cluster_domain(num_domains);
+    for (unsigned c = 0; c<num_domains; ++c) {
+        cluster_domain[c] = decomps[0].gid_domain(c);
+    }
+    std::sort(cluster_domain.begin(), cluster_domain.end());
+    EXPECT_EQ((std::vector<int>{0, 1, 2, 3}), cluster_domain);
+
+    for (unsigned i = 0; i<num_domains; ++i) {
+        const auto& D = decomps[i];
+        EXPECT_EQ(int(num_domains), D.num_domains);
+        EXPECT_EQ(int(i), D.domain_id);
+        EXPECT_EQ(num_cells, D.num_global_cells);
+        EXPECT_EQ(num_cells/num_domains, D.num_local_cells);
+
+        std::vector<cell_gid_type> local_gids;
+        for (auto& g: D.groups) {
+            EXPECT_LE(g.gids.size(), 3u);
+            local_gids.insert(local_gids.end(), g.gids.begin(), g.gids.end());
+        }
+        EXPECT_TRUE(std::is_sorted(local_gids.begin(), local_gids.end()));
+        EXPECT_EQ(D.num_local_cells, local_gids.size());
+
+        for (cell_gid_type gid = 0; gid<num_cells; ++gid) {
+            // All domains agree, and cells in a cluster are on one domain.
+            EXPECT_EQ(decomps[0].gid_domain(gid), D.gid_domain(gid));
+            EXPECT_EQ(D.gid_domain(gid%num_domains), D.gid_domain(gid));
+        }
+        for (auto gid: local_gids) {
+            EXPECT_EQ(int(i), D.gid_domain(gid));
+        }
+    }
+}
+
+TEST(domain_decomposition, graph_partition_local) {
+    // On one domain, the decomposition is the same as partition_load_balance.
+    proc_allocation resources;
+    resources.gpu_id = -1;
+    auto ctx = make_context(resources);
+
+    partition_hint_map hints;
+    hints[cell_kind::cable1d_neuron].cpu_group_size = 4;
+
+    homo_recipe rec(12, dummy_cell{});
+    auto D = partition_graph_load_balance(rec, ctx, hints, {}, heavy_cells(2, 10.));
+    auto E = partition_load_balance(rec, ctx, hints, heavy_cells(2, 10.));
+
+    EXPECT_EQ(12u, D.num_local_cells);
+    EXPECT_EQ(group_gids(E), group_gids(D));
+
+    graph_partition_options opts;
+    opts.sample_fraction = 0;
+    EXPECT_THROW(partition_graph_load_balance(rec, ctx, hints, opts), arbor_exception);
+}
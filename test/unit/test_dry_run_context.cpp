@@ -3,6 +3,7 @@
 
 #include "../gtest.h"
 
+#include <communication/packed_spikes.hpp>
 #include <distributed_context.hpp>
 #include <arbor/spike.hpp>
 
@@ -97,3 +98,77 @@ TEST(dry_run_context, gather_spikes)
     EXPECT_EQ(part[3], spikes.size()*3);
     EXPECT_EQ(part[4], spikes.size()*4);
 }
+
+TEST(dry_run_context, all_to_all_spikes)
+{
+    distributed_context_handle ctx = arb::make_dry_run_context(4, 4);
+    using svec = std::vector<arb::spike>;
+
+    // Rank 0 sends spikes from cell 0 to rank 1, and from cells 2 and 3 to
+    // rank 3; it sends nothing to itself or rank 2.
+    svec spikes = {
+        {{0u,0u}, 1.f},
+        {{2u,0u}, 2.f},
+        {{3u,0u}, 3.f},
+    };
+    std::vector<unsigned> partition = {0, 0, 1, 1, 3};
+
+    // Rank j behaves like rank 0 with gids shifted by 4*j, so rank 0
+    // receives cells 6 and 7 from rank 1, and cell 12 from rank 3.
+    svec received_spikes = {
+        {{6u,0u}, 2.f},
+        {{7u,0u}, 3.f},
+        {{12u,0u}, 1.f},
+    };
+
+    auto s = ctx->all_to_all_spikes(spikes, partition);
+
+    EXPECT_EQ(received_spikes, s.values());
+    EXPECT_EQ((std::vector<unsigned>{0, 0, 2, 2, 3}), s.partition());
+}
+
+TEST(dry_run_context, gather_packed_spikes)
+{
+    distributed_context_handle ctx = arb::make_dry_run_context(4, 4);
+    using svec = std::vector<arb::spike>;
+
+    svec spikes = {
+        {{0u,3u}, 42.f},
+        {{1u,2u}, 42.f},
+        {{2u,1u}, 42.f},
+        {{3u,0u}, 42.f},
+    };
+
+    std::vector<char> packed;
+    arb::pack_spikes(spikes, packed);
+
+    auto s = ctx->gather_packed_spikes(packed);
+    auto& part = s.partition();
+
+    // Each rank has the same packed spikes with the gids shifted by the
+    // number of cells per rank.
+    EXPECT_EQ(part.size(), 5u);
+    for (unsigned i = 0; i < 4; ++i) {
+        auto rank_spikes = arb::unpack_spikes(s.values().data()+part[i], s.values().data()+part[i+1]);
+        ASSERT_EQ(spikes.size(), rank_spikes.size());
+        for (unsigned j = 0; j < spikes.size(); ++j) {
+            EXPECT_EQ(spikes[j].source.gid+4*i, rank_spikes[j].source.gid);
+            EXPECT_EQ(spikes[j].source.index, rank_spikes[j].source.index);
+            EXPECT_EQ(spikes[j].time, rank_spikes[j].time);
+        }
+    }
+}
+
+TEST(dry_run_context, gather_gids)
+{
+    distributed_context_handle ctx = arb::make_dry_run_context(4, 4);
+
+    // Gids are shifted by the number of cells per rank, modulo the number
+    // of cells in the model.
+    std::vector<arb::cell_gid_type> gids = {0, 3, 15};
+
+    auto g = ctx->gather_gids(gids);
+
+    EXPECT_EQ((std::vector<arb::cell_gid_type>{0, 3, 15, 4, 7, 3, 8, 11, 7, 12, 15, 11}), g.values());
+    EXPECT_EQ((std::vector<unsigned>{0, 3, 6, 9, 12}), g.partition());
+}
@@ -209,6 +209,88 @@ TEST(fvm_layout, topology) {
     }
 }
 
+TEST(fvm_layout, cv_ordering) {
+    // Cell with a soma and three dendrite segments, where the smaller subtree
+    // of the soma is that of the last segment:
+    //
+    //     segment 1: parent soma, 4 compartments, passive
+    //     segment 2: parent soma, 2 compartments, HH
+    //     segment 3: parent segment 1, 3 compartments, passive
+    //
+    // Expected CV layouts, segment indices in paren:
+    //
+    // Segment order:
+    //
+    // CV: |  0     | 1 | 2 | 3 | 4 |  5  | 6 |  7  | 8 | 9 |
+    //     [soma (0)][ segment (1) ][ seg (2) ][ segment (3) ]
+    //
+    // Depth-first order:
+    //
+    // CV: |  0     |  1  | 2 | 3 | 4 | 5 | 6 |  7  | 8 | 9 |
+    //     [soma (0)][ seg (2) ][ segment (1) ][ segment (3) ]
+
+    mc_cell cell;
+    cell.add_soma(6)->add_mechanism("hh");
+
+    auto s1 = cell.add_cable(0, section_kind::dendrite, 0.5, 0.5, 200);
+    s1->add_mechanism("pas");
+    s1->set_compartments(4);
+
+    auto s2 = cell.add_cable(0, section_kind::dendrite, 0.4, 0.4, 100);
+    s2->add_mechanism("hh");
+    s2->set_compartments(2);
+
+    auto s3 = cell.add_cable(1, section_kind::dendrite, 0.3, 0.3, 150);
+    s3->add_mechanism("pas");
+    s3->set_compartments(3);
+
+    cell.add_synapse({3, 0.5}, "expsyn");
+    cell.add_synapse({2, 0.5}, "expsyn");
+
+    std::vector<mc_cell> cells{cell};
+    fvm_discretization S = fvm_discretize(cells, cv_ordering::segment);
+    fvm_discretization D = fvm_discretize(cells, cv_ordering::depth_first);
+
+    using ivec = std::vector<fvm_index_type>;
+    using ipair = std::pair<fvm_index_type, fvm_index_type>;
+
+    EXPECT_EQ(ivec({0,0,1,2,3,0,5,4,7,8}), S.parent_cv);
+    EXPECT_EQ(ivec({0,0,1,0,3,4,5,6,7,8}), D.parent_cv);
+
+    EXPECT_EQ(ipair(3,7), D.segments[1].cv_range());
+    EXPECT_EQ(ipair(1,3), D.segments[2].cv_range());
+    EXPECT_EQ(ipair(7,10), D.segments[3].cv_range());
+    EXPECT_EQ(0, D.segments[2].parent_cv);
+    EXPECT_EQ(6, D.segments[3].parent_cv);
+
+    // The depth-first layout is a permutation of the segment order layout.
+
+    ASSERT_EQ(S.ncomp, D.ncomp);
+    for (auto i: count_along(S.segments)) {
+        auto s_cvs = S.segments[i].cv_range();
+        auto d_cvs = D.segments[i].cv_range();
+        ASSERT_EQ(s_cvs.second-s_cvs.first, d_cvs.second-d_cvs.first);
+
+        for (auto k: make_span(s_cvs.second-s_cvs.first)) {
+            EXPECT_EQ(S.cv_area[s_cvs.first+k], D.cv_area[d_cvs.first+k]);
+            EXPECT_EQ(S.cv_capacitance[s_cvs.first+k], D.cv_capacitance[d_cvs.first+k]);
+            EXPECT_EQ(S.face_conductance[s_cvs.first+k], D.face_conductance[d_cvs.first+k]);
+        }
+    }
+
+    // Mechanism and ion CVs are in increasing order; synapse targets
+    // correspond to the original ordering.
+
+    fvm_mechanism_data M = fvm_build_mechanism_data(global_default_catalogue(), cells, D);
+
+    EXPECT_EQ(ivec({0,1,2}), M.mechanisms.at("hh").cv);
+    EXPECT_EQ(ivec({0,3,4,5,6,7,8,9}), M.mechanisms.at("pas").cv);
+    EXPECT_EQ(ivec({0,1,2}), M.ions.at(ionKind::na).cv);
+
+    EXPECT_EQ(ivec({1,8}), M.mechanisms.at("expsyn").cv);
+    EXPECT_EQ(ivec({1,0}), M.mechanisms.at("expsyn").target);
+}
+
 TEST(fvm_layout, area) {
     std::vector<mc_cell> cells = two_cell_system();
     check_two_cell_system(cells);
@@ -17,9 +17,13 @@
 
 #include "algorithms.hpp"
 #include "backends/multicore/fvm.hpp"
+#ifdef ARB_GPU_ENABLED
+#include "backends/gpu/fvm.hpp"
+#endif
 #include "backends/multicore/mechanism.hpp"
 #include "execution_context.hpp"
 #include "fvm_lowered_cell.hpp"
+#include "fvm_lowered_cell_blocks.hpp"
 #include "fvm_lowered_cell_impl.hpp"
 #include "sampler_map.hpp"
 #include "util/meta.hpp"
@@ -243,6 +247,267 @@ TEST(fvm_lowered, stimulus) {
     EXPECT_DOUBLE_EQ(-0.3, J[tip_cv]*A[tip_cv]*unit_factor);
 }
 
+TEST(fvm_lowered, blocks) {
+    // Cells integrated in blocks give the same spikes and samples as when
+    // integrated together.
+    using namespace arb;
+
+    execution_context context;
+
+    const unsigned ncell = 11;
+    std::vector<mc_cell> cells;
+    for (unsigned i = 0; i<ncell; ++i) {
+        cells.push_back(i%2? make_cell_ball_and_3stick(false): make_cell_ball_and_stick(false));
+        cells.back().add_synapse({0, 0.5}, "expsyn");
+        cells.back().add_detector({0, 0}, -10);
+    }
+
+    cable1d_recipe rec(cells);
+    std::vector<cell_gid_type> gids;
+    for (unsigned i = 0; i<ncell; ++i) {
+        gids.push_back(i);
+        rec.add_probe(i, 0, cell_probe_address{{1, 0.5}, cell_probe_address::membrane_voltage});
+    }
+
+    auto make_block = [context]() { return fvm_lowered_cell_ptr(new fvm_cell(context)); };
+    fvm_lowered_cell_blocks blocked(context, make_block, 3);
+    fvm_cell single(context);
+
+    // Events on every other cell, strong enough to generate spikes, and
+    // samples of every cell.
+    auto run = [&](fvm_lowered_cell& lowered) {
+        std::vector<target_handle> targets;
+        probe_association_map<probe_handle> probe_map;
+        lowered.initialize(gids, rec, targets, probe_map);
+
+        std::vector<deliverable_event> events;
+        for (unsigned i = 0; i<ncell; i += 2) {
+            events.push_back(deliverable_event(1+0.5*i, targets[i], 0.2f));
+        }
+
+        std::vector<sample_event> samples;
+        sample_size_type n = 0;
+        for (time_type t: {2., 5., 8.}) {
+            for (unsigned i = 0; i<ncell; ++i) {
+                samples.push_back(sample_event{t, i, {probe_map.at({i, 0}).handle, n++}});
+            }
+        }
+
+        auto result = lowered.integrate(15, 0.025, events, samples);
+
+        std::vector<threshold_crossing> crossings(result.crossings.begin(), result.crossings.end());
+        util::sort_by(crossings, [](const threshold_crossing& c) { return c.index; });
+        std::vector<fvm_value_type> values(result.sample_value.begin(), result.sample_value.end());
+        return std::make_pair(crossings, values);
+    };
+
+    auto expected = run(single);
+    auto result = run(blocked);
+
+    EXPECT_EQ(3u, blocked.num_blocks());
+    EXPECT_EQ(15, blocked.time());
+    EXPECT_EQ(6u, expected.first.size());
+    EXPECT_EQ(expected.first, result.first);
+    EXPECT_EQ(3*ncell, result.second.size());
+    EXPECT_EQ(expected.second, result.second);
+}
+
+TEST(fvm_lowered, cv_ordering) {
+    // Cells discretized with depth-first CV ordering give the same spikes
+    // and samples, up to rounding, as with segment order.
+    using namespace arb;
+
+    execution_context context;
+
+    // Ball and 3-stick cells, with an extra short dendrite on the soma that
+    // is numbered first in depth-first order.
+    const unsigned ncell = 3;
+    std::vector<mc_cell> cells;
+    for (unsigned i = 0; i<ncell; ++i) {
+        cells.push_back(make_cell_ball_and_3stick());
+        auto s = cells.back().add_cable(0, section_kind::dendrite, 0.4, 0.4, 50);
+        s->add_mechanism("pas");
+        s->set_compartments(2);
+
+        cells.back().add_synapse({3, 0.5}, "expsyn");
+        cells.back().add_detector({0, 0}, -10);
+    }
+
+    struct ordered_recipe: cable1d_recipe {
+        ordered_recipe(const std::vector<mc_cell>& cells, cv_ordering order):
+            cable1d_recipe(cells)
+        {
+            cell_gprop_.cv_order = order;
+        }
+    };
+
+    std::vector<cell_gid_type> gids = {0, 1, 2};
+
+    auto run = [&](cv_ordering order) {
+        ordered_recipe rec(cells, order);
+        for (unsigned i = 0; i<ncell; ++i) {
+            rec.add_probe(i, 0, cell_probe_address{{2, 0.5}, cell_probe_address::membrane_voltage});
+            rec.add_probe(i, 0, cell_probe_address{{4, 0.9}, cell_probe_address::membrane_current});
+        }
+
+        fvm_cell lowered(context);
+        std::vector<target_handle> targets;
+        probe_association_map<probe_handle> probe_map;
+        lowered.initialize(gids, rec, targets, probe_map);
+
+        std::vector<deliverable_event> events;
+        for (unsigned i = 0; i<ncell; ++i) {
+            events.push_back(deliverable_event(1+i, targets[i], 0.01f*(i+1)));
+        }
+
+        std::vector<sample_event> samples;
+        sample_size_type n = 0;
+        for (time_type t: {2., 5., 8.}) {
+            for (unsigned i = 0; i<ncell; ++i) {
+                for (unsigned j = 0; j<2; ++j) {
+                    samples.push_back(sample_event{t, i, {probe_map.at({i, j}).handle, n++}});
+                }
+            }
+        }
+
+        auto result = lowered.integrate(10, 0.025, events, samples);
+
+        std::vector<threshold_crossing> crossings(result.crossings.begin(), result.crossings.end());
+        std::vector<fvm_value_type> values(result.sample_value.begin(), result.sample_value.end());
+        return std::make_pair(crossings, values);
+    };
+
+    auto expected = run(cv_ordering::segment);
+    auto result = run(cv_ordering::depth_first);
+
+    EXPECT_FALSE(expected.first.empty());
+    ASSERT_EQ(expected.first.size(), result.first.size());
+    for (auto i: util::count_along(expected.first)) {
+        EXPECT_EQ(expected.first[i].index, result.first[i].index);
+        EXPECT_NEAR(expected.first[i].time, result.first[i].time, 1e-9);
+    }
+
+    ASSERT_EQ(6*ncell, result.second.size());
+    for (auto i: util::count_along(expected.second)) {
+        EXPECT_NEAR(expected.second[i], result.second[i], 1e-9);
+    }
+}
+
+TEST(fvm_lowered, adaptive_dt) {
+    // Cells integrated with adaptive time steps of at most 0.5 ms spike and
+    // sample close to cells integrated with a fixed 1 µs step, and meet the
+    // epoch boundaries. A cell without events settles at the largest step.
+    using namespace arb;
+
+    execution_context context;
+
+    // Cell 0 spikes after an event at 2 ms, cell 1 after an event at 3 ms,
+    // and cell 2 receives no events.
+    const unsigned ncell = 3;
+    std::vector<mc_cell> cells;
+    for (unsigned i = 0; i<ncell; ++i) {
+        cells.push_back(make_cell_ball_and_3stick(false));
+        cells.back().add_synapse({1, 0.5}, "expsyn");
+        cells.back().add_detector({0, 0}, -10);
+    }
+
+    struct adaptive_recipe: cable1d_recipe {
+        adaptive_recipe(const std::vector<mc_cell>& cells, double tolerance, double dt_min = 1e-3):
+            cable1d_recipe(cells)
+        {
+            cell_gprop_.adaptive_dt_tolerance_mV = tolerance;
+            cell_gprop_.adaptive_dt_min_ms = dt_min;
+        }
+    };
+
+    std::vector<cell_gid_type> gids = {0, 1, 2};
+    const std::vector<time_type> sample_times = {1, 2.5, 3, 4, 6, 10, 19};
+
+    struct result_type {
+        std::vector<threshold_crossing> crossings;
+        std::vector<fvm_value_type> sample_time;
+        std::vector<fvm_value_type> sample_value;
+        fvm_value_type dt_step_quiet;
+    };
+
+    auto run = [&](double tolerance, time_type dt) {
+        adaptive_recipe rec(cells, tolerance);
+        for (unsigned i = 0; i<ncell; ++i) {
+            rec.add_probe(i, 0, cell_probe_address{{0, 0.5}, cell_probe_address::membrane_voltage});
+        }
+
+        fvm_cell lowered(context);
+        std::vector<target_handle> targets;
+        probe_association_map<probe_handle> probe_map;
+        lowered.initialize(gids, rec, targets, probe_map);
+
+        std::vector<deliverable_event> events = {
+            deliverable_event(2, targets[0], 0.1f),
+            deliverable_event(3, targets[1], 0.01f)
+        };
+
+        // Integrate over two epochs, split after the spikes.
+        result_type r;
+        for (auto epoch: {std::make_pair(0., 7.3), std::make_pair(7.3, 20.)}) {
+            std::vector<sample_event> samples;
+            sample_size_type n = 0;
+            for (auto t: sample_times) {
+                if (t<epoch.first || t>=epoch.second) continue;
+                for (unsigned i = 0; i<ncell; ++i) {
+                    samples.push_back(sample_event{t, i, {probe_map.at({i, 0}).handle, n++}});
+                }
+            }
+
+            auto result = lowered.integrate(epoch.second, dt, epoch.first? std::vector<deliverable_event>{}: events, samples);
+
+            EXPECT_EQ(epoch.second, lowered.time());
+            auto time_bounds = (lowered.*private_state_ptr)->time_bounds();
+            EXPECT_EQ(epoch.second, time_bounds.first);
+            EXPECT_EQ(epoch.second, time_bounds.second);
+
+            util::append(r.crossings, result.crossings);
+            util::append(r.sample_time, util::subrange_view(result.sample_time, 0, n));
+            util::append(r.sample_value, util::subrange_view(result.sample_value, 0, n));
+        }
+        r.dt_step_quiet = (lowered.*private_state_ptr)->dt_step[2];
+        return r;
+    };
+
+    auto expected = run(0, 0.001);
+    auto result = run(0.01, 0.5);
+
+    ASSERT_EQ(2u, expected.crossings.size());
+    ASSERT_EQ(2u, result.crossings.size());
+    util::sort_by(expected.crossings, [](threshold_crossing c) { return c.index; });
+    util::sort_by(result.crossings, [](threshold_crossing c) { return c.index; });
+    for (auto i: util::count_along(expected.crossings)) {
+        EXPECT_EQ(expected.crossings[i].index, result.crossings[i].index);
+        EXPECT_NEAR(expected.crossings[i].time, result.crossings[i].time, 0.01);
+    }
+
+    // Adaptive steps end at sample times.
+    ASSERT_EQ(ncell*sample_times.size(), result.sample_value.size());
+    for (auto i: util::count_along(result.sample_value)) {
+        EXPECT_EQ(sample_times[i/ncell], result.sample_time[i]);
+        EXPECT_NEAR(expected.sample_value[i], result.sample_value[i], 2.);
+    }
+
+    EXPECT_EQ(0.5, result.dt_step_quiet);
+
+    // The smallest adaptive step must be positive.
+    adaptive_recipe rec(cells, 0.01, 0);
+    fvm_cell lowered(context);
+    std::vector<target_handle> targets;
+    probe_association_map<probe_handle> probe_map;
+    EXPECT_THROW(lowered.initialize(gids, rec, targets, probe_map), bad_global_property);
+
+#ifdef ARB_GPU_ENABLED
+    // The GPU back end does not support adaptive time steps.
+    fvm_lowered_cell_impl<gpu::backend> lowered_gpu(context);
+    EXPECT_THROW(lowered_gpu.initialize(gids, adaptive_recipe(cells, 0.01), targets, probe_map), bad_global_property);
+#endif
+}
+
 // Test derived mechanism behaviour.
 
 TEST(fvm_lowered, derived_mechs) {
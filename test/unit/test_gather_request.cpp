@@ -0,0 +1,123 @@
+#include "../gtest.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "communication/gather_request.hpp"
+#include "communication/gathered_vector.hpp"
+
+using namespace arb;
+
+namespace {
+    // Delivers the values of each domain in a given order, recording
+    // the number of values received and whether it has been destroyed.
+    struct ordered_receiver: gather_request<int>::receiver {
+        ordered_receiver(std::vector<int> order, int& received, bool& destroyed):
+            order(std::move(order)), received(received), destroyed(destroyed)
+        {}
+
+        int receive(std::vector<int>& values) override {
+            int dom = order[received++];
+            values.assign(dom, dom);
+            return dom;
+        }
+
+        // The first num_ready domains arrive without waiting.
+        bool ready() override {
+            return received<num_ready;
+        }
+
+        ~ordered_receiver() {
+            destroyed = true;
+        }
+
+        std::vector<int> order;
+        int num_ready = 0;
+        int& received;
+        bool& destroyed;
+    };
+
+    std::vector<int> values(const gather_request<int>& r, int dom) {
+        auto v = r.values(dom);
+        return std::vector<int>(v.first, v.second);
+    }
+}
+
+TEST(gather_request, complete) {
+    gather_request<int> r(gathered_vector<int>({1, 2, 2}, {0u, 1u, 1u, 3u}));
+    EXPECT_EQ(3u, r.size());
+
+    EXPECT_EQ(0, r.next());
+    EXPECT_EQ(std::vector<int>{1}, values(r, 0));
+    EXPECT_EQ(1, r.next());
+    EXPECT_TRUE(values(r, 1).empty());
+    EXPECT_EQ(2, r.next());
+    EXPECT_EQ((std::vector<int>{2, 2}), values(r, 2));
+    EXPECT_EQ(-1, r.next());
+
+    const auto& g = r.finish();
+    EXPECT_EQ((std::vector<unsigned>{0u, 1u, 1u, 3u}), g.partition());
+    EXPECT_EQ((std::vector<int>{1, 2, 2}), g.values());
+
+    gather_request<int> empty;
+    EXPECT_EQ(0u, empty.size());
+    EXPECT_EQ(-1, empty.next());
+    EXPECT_EQ(0u, empty.finish().size());
+}
+
+TEST(gather_request, receiver) {
+    // Domain d has d values, all equal to d.
+    int received = 0;
+    bool destroyed = false;
+    {
+        gather_request<int> r(4, std::unique_ptr<ordered_receiver>(
+            new ordered_receiver({2, 0, 3, 1}, received, destroyed)));
+        EXPECT_EQ(4u, r.size());
+        EXPECT_EQ(0, received);
+
+        EXPECT_EQ(2, r.next());
+        EXPECT_EQ((std::vector<int>{2, 2}), values(r, 2));
+        EXPECT_EQ(0, r.next());
+        EXPECT_TRUE(values(r, 0).empty());
+        EXPECT_EQ(2, received);
+
+        // finish() receives the rest, and partitions them by domain.
+        const auto& g = r.finish();
+        EXPECT_EQ(4, received);
+        EXPECT_EQ(-1, r.next());
+        EXPECT_EQ((std::vector<unsigned>{0u, 0u, 1u, 3u, 6u}), g.partition());
+        EXPECT_EQ((std::vector<int>{1, 2, 2, 3, 3, 3}), g.values());
+        EXPECT_EQ((std::vector<int>{3, 3, 3}), values(r, 3));
+
+        // The receiver lives as long as the request.
+        EXPECT_FALSE(destroyed);
+    }
+    EXPECT_TRUE(destroyed);
+}
+
+TEST(gather_request, try_next) {
+    int received = 0;
+    bool destroyed = false;
+    auto recv = new ordered_receiver({1, 0, 2}, received, destroyed);
+    gather_request<int> r(3, std::unique_ptr<ordered_receiver>(recv));
+
+    // Nothing is received until the receiver is ready.
+    EXPECT_EQ(-1, r.try_next());
+    EXPECT_EQ(0, received);
+
+    recv->num_ready = 2;
+    EXPECT_EQ(1, r.try_next());
+    EXPECT_EQ(0, r.try_next());
+    EXPECT_EQ(-1, r.try_next());
+    EXPECT_EQ(2, received);
+
+    EXPECT_EQ(2, r.next());
+    EXPECT_EQ(-1, r.try_next());
+
+    // A complete request has every domain ready.
+    gather_request<int> complete(gathered_vector<int>({1, 2}, {0u, 1u, 2u}));
+    EXPECT_EQ(0, complete.try_next());
+    EXPECT_EQ(1, complete.try_next());
+    EXPECT_EQ(-1, complete.try_next());
+}
@@ -0,0 +1,141 @@
+#include "../gtest.h"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/load_balance.hpp>
+
+#include "graph_partition.hpp"
+#include "util/span.hpp"
+
+using namespace arb;
+using util::make_span;
+
+namespace {
+    using edge_list = std::vector<std::pair<cell_size_type, cell_size_type>>;
+
+    std::vector<double> part_weights(const weighted_graph& g, unsigned k, const std::vector<unsigned>& part) {
+        std::vector<double> w(k, 0.);
+        for (auto v: make_span(g.size())) {
+            w[part[v]] += g.vertex_weight[v];
+        }
+        return w;
+    }
+
+    // n cliques of size m, joined in a ring by one edge between consecutive
+    // cliques. Vertex v is in clique v%n, so that the cliques are not
+    // contiguous ranges of vertices.
+    weighted_graph ring_of_cliques(unsigned n, unsigned m) {
+        edge_list edges;
+        auto vertex = [n](unsigned clique, unsigned i) { return i*n+clique; };
+        for (unsigned c = 0; c<n; ++c) {
+            for (unsigned i = 0; i<m; ++i) {
+                for (unsigned j = 0; j<m; ++j) {
+                    if (i!=j) edges.push_back({vertex(c, i), vertex(c, j)});
+                }
+            }
+            edges.push_back({vertex(c, 0), vertex((c+1)%n, 1)});
+        }
+        return make_weighted_graph(std::vector<double>(n*m, 1.), edges);
+    }
+}
+
+TEST(graph_partition, make_weighted_graph) {
+    // Repeated edges are merged in both directions, and self loops dropped.
+    edge_list edges = {{0, 1}, {1, 0}, {0, 1}, {1, 2}, {2, 2}};
+    auto g = make_weighted_graph({1., 2., 3.}, edges);
+
+    EXPECT_EQ(3u, g.size());
+    EXPECT_EQ((std::vector<double>{1., 2., 3.}), g.vertex_weight);
+    EXPECT_EQ((std::vector<cell_size_type>{0, 1, 3, 4}), g.offsets);
+    EXPECT_EQ((std::vector<cell_size_type>{1, 0, 2, 1}), g.adjacency);
+    EXPECT_EQ((std::vector<double>{3., 3., 1., 1.}), g.edge_weight);
+
+    EXPECT_EQ(0., edge_cut(g, {0, 0, 0}));
+    EXPECT_EQ(3., edge_cut(g, {0, 1, 1}));
+    EXPECT_EQ(4., edge_cut(g, {0, 1, 0}));
+}
+
+TEST(graph_partition, trivial) {
+    auto g = ring_of_cliques(2, 3);
+
+    EXPECT_EQ(std::vector<unsigned>(6, 0u), partition_graph(g, 1));
+    EXPECT_EQ((std::vector<unsigned>{0, 1, 2, 3, 4, 5}), partition_graph(g, 6));
+
+    auto empty = make_weighted_graph({}, {});
+    EXPECT_TRUE(partition_graph(empty, 4).empty());
+}
+
+TEST(graph_partition, cliques) {
+    // The best partition into n parts puts each clique in its own part, and
+    // cuts only the ring.
+    for (unsigned n: {4u, 8u, 32u}) {
+        const unsigned m = 16;
+        auto g = ring_of_cliques(n, m);
+        auto part = partition_graph(g, n);
+
+        EXPECT_EQ(double(n), edge_cut(g, part));
+        for (unsigned v = 0; v<n*m; ++v) {
+            EXPECT_EQ(part[v%n], part[v]);
+        }
+        EXPECT_EQ(std::vector<double>(n, m), part_weights(g, n, part));
+
+        // Pairs of neighbouring cliques in half as many parts.
+        auto half = partition_graph(g, n/2);
+        EXPECT_EQ(double(n/2), edge_cut(g, half));
+    }
+}
+
+TEST(graph_partition, grid) {
+    // A square grid of 64x64 vertices, numbered in a random order: the best
+    // partition into 4 parts is into quadrants, with a cut of 128 edges,
+    // while 4 contiguous ranges of vertex numbers cut most of the edges.
+    const unsigned n = 64;
+    std::vector<cell_size_type> label(n*n);
+    std::iota(label.begin(), label.end(), 0u);
+    std::shuffle(label.begin(), label.end(), std::minstd_rand());
+
+    edge_list edges;
+    for (unsigned i = 0; i<n; ++i) {
+        for (unsigned j = 0; j<n; ++j) {
+            if (i+1<n) edges.push_back({label[i*n+j], label[(i+1)*n+j]});
+            if (j+1<n) edges.push_back({label[i*n+j], label[i*n+j+1]});
+        }
+    }
+    auto g = make_weighted_graph(std::vector<double>(n*n, 1.), edges);
+
+    graph_partition_options opts;
+    auto part = partition_graph(g, 4, opts);
+
+    EXPECT_LE(edge_cut(g, part), 1.6*128);
+    for (auto w: part_weights(g, 4, part)) {
+        EXPECT_LE(w, (1+opts.imbalance)*n*n/4);
+    }
+
+    // The same options give the same partition.
+    EXPECT_EQ(part, partition_graph(g, 4, opts));
+}
+
+TEST(graph_partition, vertex_weights) {
+    // A path of 100 vertices, in which the first 10 have weight 10.
+    // The best partition into 2 parts of equal weight cuts the path once.
+    const unsigned n = 100;
+    std::vector<double> weights(n, 1.);
+    std::fill(weights.begin(), weights.begin()+10, 10.);
+    edge_list edges;
+    for (unsigned i = 0; i+1<n; ++i) {
+        edges.push_back({i, i+1});
+    }
+    auto g = make_weighted_graph(weights, edges);
+
+    auto part = partition_graph(g, 2);
+    auto w = part_weights(g, 2, part);
+
+    EXPECT_EQ(1., edge_cut(g, part));
+    EXPECT_LE(std::max(w[0], w[1]), 100.);
+    EXPECT_EQ(190., w[0]+w[1]);
+}
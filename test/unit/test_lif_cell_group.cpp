@@ -1,5 +1,8 @@
 #include "../gtest.h"
 
+#include <thread>
+
+#include <arbor/context.hpp>
 #include <arbor/domain_decomposition.hpp>
 #include <arbor/lif_cell.hpp>
 #include <arbor/load_balance.hpp>
@@ -182,6 +185,25 @@ TEST(lif_cell_group, spikes) {
     EXPECT_EQ(4u, sim.num_spikes());
 }
 
+TEST(lif_cell_group, spikes_unordered_injection) {
+    // As above, but with the events injected out of order over two calls.
+    path_recipe recipe(2, 1000, 0.1);
+
+    auto context = make_context();
+
+    auto decomp = partition_load_balance(recipe, context);
+    simulation sim(recipe, decomp, context);
+
+    sim.inject_events({{{0, 0}, 50, 1000}, {{0, 0}, 1.1, 1000}});
+    sim.inject_events({{{0, 0}, 1, 1000}});
+
+    time_type tfinal = 100;
+    time_type dt = 0.01;
+    sim.run(tfinal, dt);
+
+    EXPECT_EQ(4u, sim.num_spikes());
+}
+
 TEST(lif_cell_group, ring)
 {
     // Total number of LIF cells.
@@ -225,3 +247,43 @@ TEST(lif_cell_group, ring)
     }
 }
 
+TEST(lif_cell_group, ring_bound_threads)
+{
+    cell_size_type num_lif_cells = 99;
+    double weight = 1000;
+    double delay = 1;
+    time_type simulation_time = 100;
+
+    std::vector<spike> spike_buffer;
+
+    // Threads are bound to processors, and cell groups to threads.
+    // The thread that creates the context is bound too, so run on a
+    // separate thread.
+    std::thread t([&] {
+        proc_allocation resources;
+        resources.num_threads = 4;
+        resources.binding = thread_binding::compact;
+
+        auto context = make_context(resources);
+        auto recipe = ring_recipe(num_lif_cells, weight, delay);
+        auto decomp = partition_load_balance(recipe, context);
+
+        simulation sim(recipe, decomp, context);
+        sim.set_global_spike_callback(
+            [&spike_buffer](const std::vector<spike>& spikes) {
+                spike_buffer.insert(spike_buffer.end(), spikes.begin(), spikes.end());
+            }
+        );
+        sim.run(simulation_time, 0.01);
+    });
+    t.join();
+
+    EXPECT_EQ(num_lif_cells + 1u, spike_buffer.size());
+    for (auto& spike : spike_buffer) {
+        if (spike.source.gid == 0) {
+            EXPECT_EQ(0, spike.time);
+        } else {
+            EXPECT_EQ(spike.source.gid, spike.time);
+        }
+    }
+}
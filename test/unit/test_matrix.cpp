@@ -1,12 +1,16 @@
 #include <numeric>
+#include <random>
+#include <utility>
 #include <vector>
 
 #include "../gtest.h"
 
 #include <arbor/math.hpp>
 
+#include "execution_context.hpp"
 #include "matrix.hpp"
 #include "backends/multicore/fvm.hpp"
+#include "backends/multicore/matrix_state_interleaved.hpp"
 #include "util/rangeutil.hpp"
 #include "util/span.hpp"
 
@@ -14,9 +18,9 @@
 
 using namespace arb;
 
-using matrix_type = matrix<arb::multicore::backend>;
-using index_type = matrix_type::index_type;
-using value_type = matrix_type::value_type;
+using index_type = fvm_index_type;
+using value_type = fvm_value_type;
+using matrix_type = matrix<multicore::backend, multicore::matrix_state<value_type, index_type>>;
 
 using vvec = std::vector<value_type>;
 
@@ -177,3 +181,176 @@ TEST(matrix, zero_diagonal_assembled)
     EXPECT_TRUE(testing::seq_almost_eq<double>(expected, x));
 }
 
+
+namespace {
+    // Branched matrices of different sizes, with random CV data.
+    struct random_matrices {
+        std::vector<index_type> p, c = {0};
+        vvec Cm, g, area;
+        matrix_type::array v, i;
+
+        random_matrices(const std::vector<index_type>& sizes) {
+            std::mt19937 gen(23);
+            std::uniform_real_distribution<value_type> value(0.5, 2.);
+
+            for (auto n: sizes) {
+                auto first = c.back();
+                p.push_back(first);
+                for (auto i: util::make_span(1, n)) {
+                    p.push_back(first + std::uniform_int_distribution<index_type>(0, i-1)(gen));
+                }
+                c.push_back(first+n);
+            }
+
+            for (auto j: util::make_span(p.size())) {
+                (void)j;
+                Cm.push_back(value(gen));
+                g.push_back(value(gen));
+                area.push_back(value(gen));
+                v.push_back(-65*value(gen));
+                i.push_back(value(gen)-1);
+            }
+        }
+
+        template <typename Matrix, typename... Args>
+        Matrix make(Args&&... args) const {
+            return Matrix(p, c, Cm, g, area, std::forward<Args>(args)...);
+        }
+    };
+}
+
+TEST(matrix, interleaved_host)
+{
+    // The interleaved matrix state gives the same solution as the flat
+    // matrix state, for a set of branched matrices of different sizes, that
+    // do not fill the last block, and with a zero dt for some cells.
+
+    using util::assign;
+    using array = matrix_type::array;
+    using interleaved_type =
+        matrix<multicore::backend, multicore::matrix_state_interleaved<value_type, index_type>>;
+
+    std::vector<index_type> sizes = {3, 17, 1, 8, 8, 25, 4, 9, 2, 12, 8};
+    random_matrices r(sizes);
+    auto& c = r.c;
+    auto v = r.v;
+
+    array dt(sizes.size(), 0.025);
+    dt[1] = 0;
+    dt[8] = 0;
+
+    auto flat = r.make<matrix_type>();
+    auto interleaved = r.make<interleaved_type>();
+
+    for (int step = 0; step<2; ++step) {
+        flat.assemble(dt, v, r.i);
+        flat.solve();
+        interleaved.assemble(dt, v, r.i);
+        interleaved.solve();
+
+        vvec expected, x;
+        assign(expected, flat.solution());
+        assign(x, interleaved.solution());
+
+        EXPECT_TRUE(testing::seq_almost_eq<double>(expected, x));
+
+        // Cells with zero dt keep their voltage.
+        for (auto j: util::make_span(c[1], c[2])) {
+            EXPECT_EQ(v[j], x[j]);
+        }
+
+        assign(v, x);
+    }
+}
+
+TEST(matrix, assemble_and_solve_host)
+{
+    // Assembling and solving in one pass, with the factorization reused
+    // while dt is unchanged, gives the same solution as assembling and
+    // solving in turn, as dt changes between steps.
+
+    using util::assign;
+    using array = matrix_type::array;
+    using interleaved_type =
+        matrix<multicore::backend, multicore::matrix_state_interleaved<value_type, index_type>>;
+
+    std::vector<index_type> sizes = {3, 17, 1, 8, 25, 4, 9};
+    random_matrices r(sizes);
+    auto& c = r.c;
+
+    auto reference = r.make<matrix_type>();
+    auto fused = r.make<matrix_type>();
+    auto interleaved = r.make<interleaved_type>();
+
+    array v = r.v, v_fused = r.v, v_interleaved = r.v;
+    array dt(sizes.size(), 0.025);
+
+    for (int step = 0; step<6; ++step) {
+        // Change dt of cell 1 at step 2, and set it to zero at step 4.
+        if (step==2) dt[1] = 0.01;
+        if (step==4) dt[1] = 0;
+
+        reference.assemble(dt, v, r.i);
+        reference.solve();
+        assign(v, reference.solution());
+
+        array v_previous = v_fused;
+        fused.assemble_and_solve(dt, v_fused, r.i);
+        interleaved.assemble_and_solve(dt, v_interleaved, r.i);
+
+        EXPECT_TRUE(testing::seq_almost_eq<double>(v, v_fused));
+        EXPECT_TRUE(testing::seq_almost_eq<double>(v, v_interleaved));
+
+        // Cells with zero dt keep their voltage.
+        if (step>=4) {
+            for (auto j: util::make_span(c[1], c[2])) {
+                EXPECT_EQ(v_previous[j], v_fused[j]);
+            }
+        }
+    }
+}
+
+TEST(matrix, decomposed_host)
+{
+    // Cells that are large enough to be decomposed into subtrees, solved
+    // with several threads, give the same solution as when solved serially.
+
+    using util::assign;
+    using array = matrix_type::array;
+    using state = multicore::matrix_state<value_type, index_type>;
+
+    const index_type n = state::min_parallel_cvs;
+    std::vector<index_type> sizes = {5, 3*n, 17, n};
+    random_matrices r(sizes);
+    auto& c = r.c;
+
+    execution_context context(proc_allocation(4, -1));
+    auto serial = r.make<matrix_type>();
+    auto parallel = r.make<matrix_type>(context);
+
+    array v = r.v, v_parallel = r.v;
+    array dt(sizes.size(), 0.025);
+
+    for (int step = 0; step<4; ++step) {
+        // Change dt of cell 1 at step 1, and set dt of cell 3 to zero at
+        // step 2.
+        if (step==1) dt[1] = 0.01;
+        if (step==2) dt[3] = 0;
+
+        array v_previous = v_parallel;
+        serial.assemble_and_solve(dt, v, r.i);
+        parallel.assemble_and_solve(dt, v_parallel, r.i);
+
+        vvec expected, x;
+        assign(expected, v);
+        assign(x, v_parallel);
+        EXPECT_EQ(expected, x);
+
+        // Cells with zero dt keep their voltage.
+        if (step>=2) {
+            for (auto j: util::make_span(c[3], c[4])) {
+                EXPECT_EQ(v_previous[j], v_parallel[j]);
+            }
+        }
+    }
+}
@@ -0,0 +1,269 @@
+#include "../gtest.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <arbor/context.hpp>
+#include <arbor/lif_cell.hpp>
+#include <arbor/load_balance.hpp>
+#include <arbor/network_file.hpp>
+#include <arbor/recipe.hpp>
+#include <arbor/spike_source_cell.hpp>
+
+#include "communication/communicator.hpp"
+#include "execution_context.hpp"
+
+using namespace arb;
+
+namespace {
+    // A temporary file that is removed when it goes out of scope.
+    struct temp_file {
+        std::string path;
+
+        temp_file() {
+            char name[] = "/tmp/arbor-network-XXXXXX";
+            int fd = ::mkstemp(name);
+            if (fd>=0) ::close(fd);
+            path = name;
+        }
+
+        ~temp_file() {
+            std::remove(path.c_str());
+        }
+    };
+
+    // Spike sources with gids that are multiples of 5, and LIF cells with
+    // two targets that each receive connections from the three cells before.
+    class lif_recipe: public recipe {
+    public:
+        lif_recipe(cell_size_type n): n_(n) {}
+
+        cell_size_type num_cells() const override { return n_; }
+
+        cell_kind get_cell_kind(cell_gid_type gid) const override {
+            return gid%5? cell_kind::lif_neuron: cell_kind::spike_source;
+        }
+
+        util::unique_any get_cell_description(cell_gid_type gid) const override {
+            if (gid%5==0) {
+                return spike_source_cell{explicit_schedule({0.f})};
+            }
+            return lif_cell();
+        }
+
+        std::vector<cell_connection> connections_on(cell_gid_type gid) const override {
+            std::vector<cell_connection> conns;
+            if (get_cell_kind(gid)==cell_kind::spike_source) return conns;
+            for (unsigned i = 1; i<=3; ++i) {
+                cell_gid_type src = (gid+n_-i)%n_;
+                conns.push_back(cell_connection({src, 0}, {gid, i%2}, 0.5f*i, 1.f+0.25f*gid));
+            }
+            return conns;
+        }
+
+        cell_size_type num_sources(cell_gid_type) const override { return 1; }
+        cell_size_type num_targets(cell_gid_type gid) const override {
+            return get_cell_kind(gid)==cell_kind::spike_source? 0: 2;
+        }
+        cell_size_type num_probes(cell_gid_type) const override { return 0; }
+
+    private:
+        cell_size_type n_;
+    };
+
+    // The cell descriptions of lif_recipe, with the network read from file.
+    class lif_file_recipe: public file_recipe {
+    public:
+        lif_file_recipe(const std::string& path): file_recipe(path) {}
+
+        util::unique_any get_cell_description(cell_gid_type gid) const override {
+            return lif_recipe(num_cells()).get_cell_description(gid);
+        }
+    };
+
+    // A file recipe that drops the connections of weight above 1.
+    class light_file_recipe: public lif_file_recipe {
+    public:
+        using lif_file_recipe::lif_file_recipe;
+
+        void append_connections_on(cell_gid_type first, cell_gid_type last, std::vector<cell_connection>& conns) const override {
+            auto n = conns.size();
+            lif_file_recipe::append_connections_on(first, last, conns);
+            conns.erase(std::remove_if(conns.begin()+n, conns.end(),
+                [](const cell_connection& c) { return c.weight>1; }), conns.end());
+        }
+    };
+
+    bool same_connections(const std::vector<cell_connection>& a, const std::vector<cell_connection>& b) {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+            [](const cell_connection& a, const cell_connection& b) {
+                return a.source==b.source && a.dest==b.dest && a.weight==b.weight && a.delay==b.delay;
+            });
+    }
+}
+
+TEST(network_file, round_trip) {
+    const cell_size_type n = 47;
+    lif_recipe rec(n);
+    temp_file f;
+    write_network_file(f.path, rec);
+
+    lif_file_recipe frec(f.path);
+    const auto& net = frec.network();
+
+    EXPECT_EQ(n, frec.num_cells());
+    EXPECT_EQ(n, net.num_cells());
+    EXPECT_EQ(3u*(n-(n+4)/5), net.num_connections());
+
+    for (cell_gid_type gid = 0; gid<n; ++gid) {
+        EXPECT_EQ(rec.get_cell_kind(gid), frec.get_cell_kind(gid));
+        EXPECT_EQ(rec.num_sources(gid), frec.num_sources(gid));
+        EXPECT_EQ(rec.num_targets(gid), frec.num_targets(gid));
+
+        auto expected = rec.connections_on(gid);
+        EXPECT_TRUE(same_connections(expected, frec.connections_on(gid)));
+
+        auto r = net.connections_on(gid);
+        ASSERT_EQ(expected.size(), std::size_t(r.second-r.first));
+        for (auto& c: expected) {
+            EXPECT_EQ(c.source.gid, r.first->source_gid);
+            EXPECT_EQ(c.source.index, r.first->source_index);
+            EXPECT_EQ(c.dest.index, r.first->target);
+            EXPECT_EQ(c.weight, r.first->weight);
+            EXPECT_EQ(c.delay, r.first->delay);
+            ++r.first;
+        }
+    }
+
+    // Copies of a file recipe share the mapping.
+    auto copy = frec;
+    EXPECT_TRUE(same_connections(rec.connections_on(6), copy.connections_on(6)));
+}
+
+TEST(network_file, empty) {
+    lif_recipe rec(0);
+    temp_file f;
+    write_network_file(f.path, rec);
+
+    network_file net(f.path);
+    EXPECT_EQ(0u, net.num_cells());
+    EXPECT_EQ(0u, net.num_connections());
+}
+
+TEST(network_file, communicator) {
+    // The communicator built from the mapped file has the same connections
+    // as one built from the recipe connection lists.
+    lif_recipe rec(100);
+    temp_file f;
+    write_network_file(f.path, rec);
+    lif_file_recipe frec(f.path);
+
+    auto ctx = make_context();
+    auto decomp = partition_load_balance(rec, ctx);
+    communicator expected(rec, decomp, *ctx);
+    communicator comm(frec, decomp, *ctx);
+
+    const auto& a = expected.connections();
+    const auto& b = comm.connections();
+    ASSERT_EQ(a.size(), b.size());
+    EXPECT_EQ(300u-3*20, b.size());
+    for (std::size_t i = 0; i<a.size(); ++i) {
+        EXPECT_EQ(a[i].source(), b[i].source());
+        EXPECT_EQ(a[i].destination(), b[i].destination());
+        EXPECT_EQ(a[i].weight(), b[i].weight());
+        EXPECT_EQ(a[i].delay(), b[i].delay());
+        EXPECT_EQ(a[i].index_on_domain(), b[i].index_on_domain());
+    }
+    EXPECT_EQ(expected.min_delay(), comm.min_delay());
+}
+
+TEST(network_file, derived_recipe) {
+    // The communicator builds the connections of a recipe derived from
+    // file_recipe with the derived class's append_connections_on.
+    lif_recipe rec(100);
+    temp_file f;
+    write_network_file(f.path, rec);
+    light_file_recipe frec(f.path);
+
+    auto ctx = make_context();
+    auto decomp = partition_load_balance(frec, ctx);
+    communicator comm(frec, decomp, *ctx);
+
+    // Of the 3 connections on each lif cell, of weight 0.5, 1 and 1.5, the
+    // last is dropped.
+    const auto& conns = comm.connections();
+    EXPECT_EQ(2u*(100-20), conns.size());
+    for (const auto& c: conns) {
+        EXPECT_LE(c.weight(), 1.f);
+    }
+}
+
+TEST(network_file, errors) {
+    temp_file f;
+
+    // Missing file.
+    std::remove(f.path.c_str());
+    EXPECT_THROW(network_file(f.path), network_file_error);
+
+    // Not a network file.
+    {
+        std::ofstream out(f.path);
+        out << "this is not a network file, but it is long enough for a header";
+    }
+    EXPECT_THROW(network_file(f.path), network_file_error);
+
+    // Truncated network file.
+    write_network_file(f.path, lif_recipe(10));
+    ASSERT_EQ(0, ::truncate(f.path.c_str(), 100));
+    try {
+        network_file net(f.path);
+        FAIL() << "expected network_file_error";
+    }
+    catch (network_file_error& e) {
+        EXPECT_EQ(f.path, e.path);
+    }
+
+    // Invalid cell kind and connection offsets are found when read: with 10
+    // cells, the kinds start at byte 32 and the offsets at byte 152.
+    write_network_file(f.path, lif_recipe(10));
+    {
+        std::fstream io(f.path, std::ios::in|std::ios::out|std::ios::binary);
+        std::uint32_t kind = 99;
+        io.seekp(32+3*sizeof(kind));
+        io.write(reinterpret_cast<const char*>(&kind), sizeof(kind));
+        std::uint64_t offset = -1;
+        io.seekp(152+5*sizeof(offset));
+        io.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+    }
+    network_file net(f.path);
+    EXPECT_EQ(cell_kind::lif_neuron, net.kind(2));
+    EXPECT_THROW(net.kind(3), network_file_error);
+    EXPECT_NO_THROW(net.connections_on(3));
+    EXPECT_THROW(net.connections_on(4), network_file_error);
+    EXPECT_THROW(net.connections_on(5), network_file_error);
+
+    // Out of range gids.
+    EXPECT_THROW(net.kind(10), network_file_error);
+    EXPECT_THROW(net.num_sources(10), network_file_error);
+    EXPECT_THROW(net.num_targets(10), network_file_error);
+    EXPECT_THROW(net.connections_on(10), network_file_error);
+    EXPECT_THROW(net.connections_on(-1), network_file_error);
+
+    // A number of connections whose size in bytes overflows: the count is
+    // at byte 24 of the header.
+    write_network_file(f.path, lif_recipe(10));
+    {
+        std::fstream io(f.path, std::ios::in|std::ios::out|std::ios::binary);
+        std::uint64_t num_connections = std::numeric_limits<std::uint64_t>::max()/4;
+        io.seekp(24);
+        io.write(reinterpret_cast<const char*>(&num_connections), sizeof(num_connections));
+    }
+    EXPECT_THROW(network_file(f.path), network_file_error);
+}
@@ -0,0 +1,112 @@
+#include "../gtest.h"
+
+#include <cmath>
+#include <vector>
+
+#include <arbor/spike.hpp>
+
+#include "communication/gathered_vector.hpp"
+#include "communication/packed_spikes.hpp"
+
+using namespace arb;
+
+namespace {
+    std::vector<spike> unpack(const std::vector<char>& buf) {
+        return unpack_spikes(buf.data(), buf.data()+buf.size());
+    }
+}
+
+TEST(packed_spikes, empty) {
+    std::vector<char> buf;
+    pack_spikes({}, buf);
+
+    EXPECT_EQ(0u, packed_spike_count(buf.data(), buf.data()+buf.size()));
+    EXPECT_TRUE(unpack(buf).empty());
+    EXPECT_TRUE(unpack_spikes(nullptr, nullptr).empty());
+}
+
+TEST(packed_spikes, round_trip) {
+    // Sorted by source, with repeated gids, non-zero indices and large gaps.
+    std::vector<spike> spikes = {
+        {{3, 0}, 10.5},
+        {{3, 0}, 11.25},
+        {{4, 2}, 10.},
+        {{130, 0}, 12.},
+        {{130, 1000}, 12.},
+        {{1u<<30, 7}, 19.75},
+    };
+
+    std::vector<char> buf;
+    pack_spikes(spikes, buf);
+
+    EXPECT_EQ(spikes.size(), packed_spike_count(buf.data(), buf.data()+buf.size()));
+    EXPECT_EQ(spikes, unpack(buf));
+}
+
+TEST(packed_spikes, exact_times) {
+    // Times that are not recovered exactly from single precision offsets
+    // relative to the earliest spike.
+    std::vector<spike> spikes = {
+        {{0, 0}, 406.586456f},
+        {{1, 0}, 147.938004f},
+        {{2, 0}, 1855.01721f},
+    };
+
+    std::vector<char> buf;
+    pack_spikes(spikes, buf);
+
+    EXPECT_EQ(spikes, unpack(buf));
+}
+
+TEST(packed_spikes, size) {
+    // Consecutive single-source cells pack into 5 bytes per spike.
+    std::vector<spike> spikes;
+    for (cell_gid_type gid = 1000; gid<2000; ++gid) {
+        spikes.push_back({{gid, 0}, time_type(100.+gid*0.001)});
+    }
+
+    std::vector<char> buf;
+    pack_spikes(spikes, buf);
+
+    const std::size_t header_max = 3+5;
+    EXPECT_LE(buf.size(), 5*spikes.size()+header_max);
+
+    // Spike times are unchanged.
+    auto unpacked = unpack(buf);
+    ASSERT_EQ(spikes.size(), unpacked.size());
+    for (std::size_t i = 0; i<spikes.size(); ++i) {
+        EXPECT_EQ(spikes[i].source, unpacked[i].source);
+        EXPECT_EQ(spikes[i].time, unpacked[i].time);
+    }
+}
+
+TEST(packed_spikes, shift) {
+    std::vector<spike> spikes = {{{0, 0}, 1.}, {{2, 1}, 2.}, {{5, 0}, 3.}};
+
+    std::vector<char> buf;
+    pack_spikes(spikes, buf);
+
+    std::vector<char> shifted;
+    shift_packed_spikes(buf.data(), buf.data()+buf.size(), 100, shifted);
+
+    std::vector<spike> expected = {{{100, 0}, 1.}, {{102, 1}, 2.}, {{105, 0}, 3.}};
+    EXPECT_EQ(expected, unpack(shifted));
+}
+
+TEST(packed_spikes, gathered) {
+    std::vector<spike> a = {{{0, 0}, 1.}, {{1, 0}, 2.}};
+    std::vector<spike> b = {{{7, 0}, 1.5}};
+
+    std::vector<char> buf;
+    pack_spikes(a, buf);
+    unsigned mid = buf.size();
+    pack_spikes({}, buf);
+    unsigned end_empty = buf.size();
+    pack_spikes(b, buf);
+    unsigned end = buf.size();
+
+    gathered_vector<char> gathered(std::move(buf), {0u, mid, end_empty, end});
+
+    std::vector<spike> expected = {{{0, 0}, 1.}, {{1, 0}, 2.}, {{7, 0}, 1.5}};
+    EXPECT_EQ(expected, unpack_spikes(gathered));
+}
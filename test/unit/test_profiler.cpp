@@ -0,0 +1,44 @@
+#include "../gtest.h"
+
+#include <string>
+
+#include <arbor/context.hpp>
+#include <arbor/domain_decomposition.hpp>
+#include <arbor/load_balance.hpp>
+#include <arbor/profile/profiler.hpp>
+#include <arbor/simulation.hpp>
+
+#include "util/span.hpp"
+
+#include "../common_cells.hpp"
+#include "../simple_recipes.hpp"
+
+using namespace arb;
+
+#ifdef ARB_HAVE_PROFILING
+
+TEST(profiler, simulation) {
+    // The simulation and its cell groups hold copies of the execution
+    // context: regions entered while running the simulation are recorded
+    // until the context made by make_context is destroyed.
+    auto ctx = make_context();
+    profile::profiler_initialize(ctx);
+
+    cable1d_recipe rec(std::vector<mc_cell>(4, make_cell_ball_and_stick()));
+    auto decomp = partition_load_balance(rec, ctx);
+    simulation sim(rec, decomp, ctx);
+    sim.run(10, 0.025);
+
+    auto prof = profile::profiler_summary();
+    ASSERT_EQ(prof.names.size(), prof.counts.size());
+
+    std::size_t integrate_count = 0;
+    for (auto i: util::count_along(prof.names)) {
+        if (prof.names[i].find("advance_integrate")==0) {
+            integrate_count += prof.counts[i];
+        }
+    }
+    EXPECT_LT(0u, integrate_count);
+}
+
+#endif // def ARB_HAVE_PROFILING
@@ -0,0 +1,133 @@
+#include "../gtest.h"
+
+#include <atomic>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/context.hpp>
+#include <arbor/load_balance.hpp>
+#include <arbor/recipe.hpp>
+#include <arbor/spike_source_cell.hpp>
+
+#include "communication/communicator.hpp"
+#include "execution_context.hpp"
+
+using namespace arb;
+
+namespace {
+    // Spike sources, each with connections from the cells with the next two
+    // gids. With bulk set, append_connections_on generates the connections
+    // on a range of cells directly, and counts the calls.
+    class source_recipe: public recipe {
+    public:
+        source_recipe(cell_size_type n, bool bulk = false): n_(n), bulk_(bulk) {}
+
+        cell_size_type num_cells() const override { return n_; }
+
+        cell_kind get_cell_kind(cell_gid_type) const override {
+            return cell_kind::spike_source;
+        }
+
+        util::unique_any get_cell_description(cell_gid_type) const override {
+            return spike_source_cell{explicit_schedule({})};
+        }
+
+        std::vector<cell_connection> connections_on(cell_gid_type gid) const override {
+            std::vector<cell_connection> conns;
+            connections(gid, conns);
+            return conns;
+        }
+
+        void append_connections_on(cell_gid_type first, cell_gid_type last, std::vector<cell_connection>& conns) const override {
+            if (!bulk_) {
+                return recipe::append_connections_on(first, last, conns);
+            }
+            ++bulk_calls;
+            for (auto gid = first; gid<last; ++gid) {
+                connections(gid, conns);
+            }
+        }
+
+        cell_size_type num_sources(cell_gid_type) const override { return 1; }
+        cell_size_type num_targets(cell_gid_type) const override { return 2; }
+
+        mutable std::atomic<unsigned> bulk_calls{0};
+
+    private:
+        cell_size_type n_;
+        bool bulk_;
+
+        void connections(cell_gid_type gid, std::vector<cell_connection>& conns) const {
+            for (unsigned i = 1; i<=2; ++i) {
+                cell_gid_type src = (gid+i)%n_;
+                conns.push_back(cell_connection({src, 0}, {gid, i-1}, float(i), 1.f+0.5f*(gid%4)));
+            }
+        }
+    };
+
+    // Connections with a target on a cell other than the one asked for.
+    class bad_target_recipe: public source_recipe {
+    public:
+        bad_target_recipe(): source_recipe(10) {}
+
+        std::vector<cell_connection> connections_on(cell_gid_type gid) const override {
+            return {cell_connection({gid, 0}, {gid+num_cells(), 0}, 1.f, 1.f)};
+        }
+    };
+}
+
+TEST(recipe, append_connections_on) {
+    source_recipe rec(10);
+
+    std::vector<cell_connection> conns = {cell_connection({9, 0}, {9, 0}, 0.f, 0.f)};
+    rec.append_connections_on(3, 6, conns);
+
+    ASSERT_EQ(7u, conns.size());
+    EXPECT_EQ(cell_member_type({9, 0}), conns[0].dest);
+    for (unsigned i = 0; i<6; ++i) {
+        auto expected = rec.connections_on(3+i/2)[i%2];
+        EXPECT_EQ(expected.source, conns[i+1].source);
+        EXPECT_EQ(expected.dest, conns[i+1].dest);
+        EXPECT_EQ(expected.weight, conns[i+1].weight);
+        EXPECT_EQ(expected.delay, conns[i+1].delay);
+    }
+
+    rec.append_connections_on(4, 4, conns);
+    EXPECT_EQ(7u, conns.size());
+}
+
+TEST(recipe, bulk_connections) {
+    // A communicator built with the bulk interface has the same connections
+    // as one built one cell at a time, with one call per block of cells.
+    const cell_size_type n = 1000;
+    source_recipe rec(n);
+    source_recipe bulk(n, true);
+
+    auto ctx = make_context();
+    auto decomp = partition_load_balance(rec, ctx);
+    communicator expected(rec, decomp, *ctx);
+    communicator comm(bulk, decomp, *ctx);
+
+    const auto& a = expected.connections();
+    const auto& b = comm.connections();
+    ASSERT_EQ(2*n, b.size());
+    ASSERT_EQ(a.size(), b.size());
+    for (std::size_t i = 0; i<a.size(); ++i) {
+        EXPECT_EQ(a[i].source(), b[i].source());
+        EXPECT_EQ(a[i].destination(), b[i].destination());
+        EXPECT_EQ(a[i].weight(), b[i].weight());
+        EXPECT_EQ(a[i].delay(), b[i].delay());
+        EXPECT_EQ(a[i].index_on_domain(), b[i].index_on_domain());
+    }
+
+    EXPECT_LT(0u, bulk.bulk_calls.load());
+    EXPECT_GT(n/100, bulk.bulk_calls.load());
+}
+
+TEST(recipe, bad_connection_target) {
+    bad_target_recipe rec;
+
+    auto ctx = make_context();
+    auto decomp = partition_load_balance(rec, ctx);
+    EXPECT_THROW((communicator(rec, decomp, *ctx)), bad_connection_target);
+}
@@ -0,0 +1,177 @@
+#include "../gtest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <arbor/context.hpp>
+#include <arbor/lif_cell.hpp>
+#include <arbor/load_balance.hpp>
+#include <arbor/recipe.hpp>
+#include <arbor/schedule.hpp>
+#include <arbor/simulation.hpp>
+#include <arbor/spike.hpp>
+#include <arbor/spike_file.hpp>
+#include <arbor/spike_source_cell.hpp>
+
+using namespace arb;
+
+namespace {
+    // A temporary file that is removed when it goes out of scope.
+    struct temp_file {
+        std::string path;
+
+        temp_file() {
+            char name[] = "/tmp/arbor-spikes-XXXXXX";
+            int fd = ::mkstemp(name);
+            if (fd>=0) ::close(fd);
+            path = name;
+        }
+
+        ~temp_file() {
+            std::remove(path.c_str());
+        }
+    };
+
+    std::vector<spike> make_spikes(unsigned n, time_type t0) {
+        std::vector<spike> spikes;
+        for (unsigned i = 0; i<n; ++i) {
+            spikes.push_back({{i%7, i%2}, t0+0.25f*i});
+        }
+        return spikes;
+    }
+
+    // Spike sources with regular schedules.
+    class source_recipe: public recipe {
+    public:
+        source_recipe(cell_size_type n): n_(n) {}
+
+        cell_size_type num_cells() const override { return n_; }
+
+        cell_kind get_cell_kind(cell_gid_type) const override {
+            return cell_kind::spike_source;
+        }
+
+        util::unique_any get_cell_description(cell_gid_type gid) const override {
+            return spike_source_cell{regular_schedule(0.1*gid, 1.+0.1*gid)};
+        }
+
+        cell_size_type num_sources(cell_gid_type) const override { return 1; }
+        cell_size_type num_targets(cell_gid_type) const override { return 0; }
+
+    private:
+        cell_size_type n_;
+    };
+}
+
+TEST(spike_file, round_trip) {
+    temp_file f;
+    std::vector<spike> expected;
+
+    // Several full buffers, and a partial buffer written on close.
+    {
+        spike_recorder rec(f.path, 3, 10);
+        for (unsigned i = 0; i<5; ++i) {
+            auto spikes = make_spikes(7*i+1, 10*i);
+            rec(spikes);
+            expected.insert(expected.end(), spikes.begin(), spikes.end());
+        }
+        EXPECT_EQ(expected.size(), rec.num_spikes());
+        rec.close();
+    }
+
+    spike_file file(f.path);
+    EXPECT_TRUE(file.complete());
+    EXPECT_EQ(3u, file.domain());
+    EXPECT_EQ(expected.size(), file.num_spikes());
+    EXPECT_EQ(8u, file.blocks().size());
+    EXPECT_EQ(expected, file.spikes());
+
+    // Spikes in an interval.
+    std::vector<spike> interval;
+    for (auto& s: expected) {
+        if (s.time>=20 && s.time<31) interval.push_back(s);
+    }
+    ASSERT_FALSE(interval.empty());
+    EXPECT_EQ(interval, file.spikes(20, 31));
+}
+
+TEST(spike_file, flush) {
+    // Spikes written by flush can be read from a file that has not been
+    // closed.
+    temp_file f;
+    spike_recorder rec(f.path);
+
+    auto spikes = make_spikes(20, 1);
+    rec(spikes);
+    rec.flush();
+    rec(make_spikes(5, 100));
+
+    spike_file file(f.path);
+    EXPECT_FALSE(file.complete());
+    EXPECT_EQ(spikes, file.spikes());
+
+    rec.close();
+    EXPECT_EQ(25u, spike_file(f.path).num_spikes());
+    EXPECT_THROW(rec(spikes), spike_file_error);
+}
+
+TEST(spike_file, truncated) {
+    // The complete blocks of a truncated file can be read.
+    temp_file f;
+    {
+        spike_recorder rec(f.path, 0, 4);
+        rec(make_spikes(10, 0));
+    }
+    ASSERT_EQ(0, ::truncate(f.path.c_str(), 24+2*(16+4*12)+20));
+
+    spike_file file(f.path);
+    EXPECT_FALSE(file.complete());
+    EXPECT_EQ(2u, file.blocks().size());
+    auto expected = make_spikes(8, 0);
+    EXPECT_EQ(expected, file.spikes());
+}
+
+TEST(spike_file, simulation) {
+    // Record the spikes of a simulation, and compare with those passed to
+    // the spike callback.
+    temp_file f;
+    source_recipe rec(20);
+    auto ctx = make_context();
+    simulation sim(rec, partition_load_balance(rec, ctx), ctx);
+
+    std::vector<spike> expected;
+    spike_recorder recorder(f.path, 0, 16);
+    auto record = recorder.callback();
+    sim.set_global_spike_callback(
+        [&](const std::vector<spike>& spikes) {
+            expected.insert(expected.end(), spikes.begin(), spikes.end());
+            record(spikes);
+        });
+    sim.run(50, 0.1);
+    recorder.close();
+
+    ASSERT_FALSE(expected.empty());
+    EXPECT_EQ(expected, spike_file(f.path).spikes());
+}
+
+TEST(spike_file, errors) {
+    temp_file f;
+
+    // Missing file.
+    std::remove(f.path.c_str());
+    EXPECT_THROW(spike_file(f.path), spike_file_error);
+
+    // Not a spike file.
+    {
+        std::ofstream out(f.path);
+        out << "this is not a spike file, but it is long enough for a header";
+    }
+    EXPECT_THROW(spike_file(f.path), spike_file_error);
+
+    // Unable to create file.
+    EXPECT_THROW(spike_recorder("/nonexistent/spikes.spk"), spike_file_error);
+}
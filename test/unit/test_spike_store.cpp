@@ -1,9 +1,14 @@
 #include "../gtest.h"
 
+#include <algorithm>
+#include <memory>
+#include <vector>
+
 #include <arbor/spike.hpp>
 
 #include "execution_context.hpp"
 #include "thread_private_spike_store.hpp"
+#include "threading/threading.hpp"
 
 using arb::spike;
 
@@ -89,3 +94,70 @@ TEST(spike_store, gather)
         EXPECT_EQ(spikes[i].time, gathered_spikes[i].time);
     }
 }
+
+TEST(spike_store, gather_runs)
+{
+    using store_type = arb::thread_private_spike_store;
+
+    arb::execution_context context;
+    store_type store(context.thread_pool);
+
+    // Batches inserted in descending order of source are appended to the
+    // buffer, each sorted, and merged by gather().
+    std::vector<spike> expected;
+    for (unsigned i = 0; i<10; ++i) {
+        std::vector<spike> batch = {{{20-2*i, 0}, 1.f}, {{19-2*i, 0}, 2.f}};
+        store.insert(batch);
+        expected.insert(expected.begin(), batch.rbegin(), batch.rend());
+    }
+    EXPECT_EQ(20u, store.get().size());
+    EXPECT_EQ((spike{{19, 0}, 2.f}), store.get().front());
+    EXPECT_EQ((spike{{2, 0}, 1.f}), store.get().back());
+    EXPECT_EQ(expected, store.gather());
+
+    // Sorted spikes added directly follow the runs of insert().
+    store.get().push_back({{0, 0}, 3.f});
+    store.get().push_back({{30, 0}, 3.f});
+    expected.insert(expected.begin(), spike{{0, 0}, 3.f});
+    expected.push_back({{30, 0}, 3.f});
+    EXPECT_EQ(expected, store.gather());
+}
+
+TEST(spike_store, gather_sorted)
+{
+    using store_type = arb::thread_private_spike_store;
+    using namespace arb::threading;
+
+    auto ts = std::make_shared<task_system>(4);
+    store_type store(ts);
+
+    // Insert unsorted batches of spikes from tasks on all threads, with
+    // gids in reverse order and repeated sources with different times.
+    std::vector<spike> expected;
+    task_group g(ts.get());
+    for (unsigned i = 0; i<100; ++i) {
+        std::vector<spike> batch;
+        for (unsigned j = 0; j<10; ++j) {
+            batch.push_back({{(1000-10*i-j)%97, j%2}, float(i%7)});
+        }
+        expected.insert(expected.end(), batch.begin(), batch.end());
+        g.run([&store, batch] { store.insert(batch); });
+    }
+    g.wait();
+
+    auto less = [](const spike& a, const spike& b) {
+        return a.source<b.source || (a.source==b.source && a.time<b.time);
+    };
+    std::sort(expected.begin(), expected.end(), less);
+
+    EXPECT_EQ(expected, store.gather());
+
+    // Gathering into a vector replaces its contents.
+    std::vector<spike> spikes = {{{1, 1}, 1.f}};
+    store.gather(spikes);
+    EXPECT_EQ(expected, spikes);
+
+    store.clear();
+    store.gather(spikes);
+    EXPECT_TRUE(spikes.empty());
+}
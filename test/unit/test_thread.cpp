@@ -2,12 +2,21 @@
 #include "common.hpp"
 
 #include <iostream>
+#include <memory>
 #include <ostream>
+#include <set>
+#include <stdexcept>
+#include <thread>
 // (Pending abstraction of threading interface)
 #include <arbor/version.hpp>
 
+#include <arbor/arbexcept.hpp>
+#include <arbor/context.hpp>
+
+#include "hardware/affinity.hpp"
 #include "threading/threading.hpp"
 #include "threading/enumerable_thread_specific.hpp"
+#include "threading/thread_info.hpp"
 
 using namespace arb::threading::impl;
 using namespace arb::threading;
@@ -22,11 +31,12 @@ void reset() {
     ncopy = 0;
 }
 
+// Nothrow movable functor: stored inline in a task.
 struct ftor {
 
     ftor() {}
 
-    ftor(ftor&& other) {
+    ftor(ftor&& other) noexcept {
         ++nmove;
     }
 
@@ -68,7 +78,7 @@ TEST(task_system, test_copy) {
     ftor f;
     ts.async(f);
 
-    // Copy into new ftor and move ftor into a task (std::function<void()>)
+    // Copy into a task and move into the queued task
     EXPECT_EQ(1, nmove);
     EXPECT_EQ(1, ncopy);
     reset();
@@ -80,7 +90,7 @@ TEST(task_system, test_move) {
     ftor f;
     ts.async(std::move(f));
 
-    // Move into new ftor and move ftor into a task (std::function<void()>)
+    // Move into a task and move into the queued task
     EXPECT_LE(nmove, 2);
     EXPECT_LE(ncopy, 1);
     reset();
@@ -92,7 +102,7 @@ TEST(notification_queue, test_copy) {
     ftor f;
     q.push(f);
 
-    // Copy into new ftor and move ftor into a task (std::function<void()>)
+    // Copy into a task and move the task into the queue
     EXPECT_EQ(1, nmove);
     EXPECT_EQ(1, ncopy);
     reset();
@@ -103,7 +113,7 @@ TEST(notification_queue, test_move) {
 
     ftor f;
 
-    // Move into new ftor and move ftor into a task (std::function<void()>)
+    // Move into a task and move the task into the queue
     q.push(std::move(f));
     EXPECT_LE(nmove, 2);
     EXPECT_LE(ncopy, 1);
@@ -118,7 +128,7 @@ TEST(task_group, test_copy) {
     g.run(f);
     g.wait();
 
-    // Copy into "wrap" and move wrap into a task (std::function<void()>)
+    // Copy into "wrap" constructed in place in a task, and move into the queued task
     EXPECT_EQ(1, nmove);
     EXPECT_EQ(1, ncopy);
     reset();
@@ -132,12 +142,86 @@ TEST(task_group, test_move) {
     g.run(std::move(f));
     g.wait();
 
-    // Move into wrap and move wrap into a task (std::function<void()>)
+    // Move into "wrap" constructed in place in a task, and move into the queued task
     EXPECT_LE(nmove, 2);
     EXPECT_LE(ncopy, 1);
     reset();
 }
 
+TEST(task, storage) {
+    // Small nothrow movable callables are stored inline, and the moved-from
+    // task is left empty.
+    {
+        ftor f;
+        task t(f);
+        EXPECT_TRUE(t);
+        task u(std::move(t));
+        EXPECT_FALSE(t);
+        EXPECT_TRUE(u);
+        u();
+        EXPECT_EQ(1, ncopy);
+        EXPECT_EQ(1, nmove);
+        reset();
+    }
+
+    // Large callables are stored on the heap, and are not moved with the task.
+    {
+        struct big_ftor {
+            ftor f;
+            char payload[2*task::inline_size];
+            void operator()() {}
+        };
+        big_ftor b;
+        task t(b);
+        task u(std::move(t));
+        task v;
+        v = std::move(u);
+        EXPECT_FALSE(u);
+        EXPECT_TRUE(v);
+        v();
+        EXPECT_EQ(1, ncopy);
+        EXPECT_EQ(0, nmove);
+        reset();
+    }
+
+    // Move-only callables are supported.
+    {
+        int value = 0;
+        std::unique_ptr<int> p(new int(3));
+        task t([&value, p = std::move(p)] { value = *p; });
+        t();
+        EXPECT_EQ(3, value);
+    }
+}
+
+TEST(task, pool) {
+    // Blocks freed by any thread are reused.
+    std::vector<task*> tasks;
+    for (int i = 0; i < 1000; ++i) {
+        tasks.push_back(new task([]{}));
+    }
+
+    std::set<task*> unique(tasks.begin(), tasks.end());
+    EXPECT_EQ(tasks.size(), unique.size());
+
+    std::thread t([&] { for (auto p: tasks) delete p; });
+    t.join();
+
+    // The blocks freed by t are the last returned to the shared depot, so a
+    // thread with no cached blocks of its own allocates from them first.
+    std::thread u([&] {
+        for (auto& p: tasks) {
+            p = new task([]{});
+        }
+    });
+    u.join();
+
+    for (auto p: tasks) {
+        EXPECT_TRUE(unique.count(p));
+        delete p;
+    }
+}
+
 TEST(task_group, individual_tasks) {
     // Simple check for deadlock
     task_system ts;
@@ -194,6 +278,290 @@ TEST(task_group, nested_parallel_for) {
     }
 }
 
+TEST(task_group, parallel_for_scheduler_kinds) {
+    for (auto kind: {scheduler_kind::notification_queues, scheduler_kind::work_stealing}) {
+        for (int nthreads: {1, 2, 4, 7}) {
+            task_system ts(nthreads, kind);
+            EXPECT_EQ(kind, ts.kind());
+
+            for (int n = 0; n < 10000; n=!n?1:2*n) {
+                std::vector<int> v(n, -1);
+                parallel_for::apply(0, n, &ts, [&](int i) {v[i] = i;});
+                for (int i = 0; i< n; i++) {
+                    EXPECT_EQ(i, v[i]);
+                }
+            }
+
+            std::vector<std::vector<int>> w(64, std::vector<int>(64, -1));
+            parallel_for::apply(0, 64, &ts, [&](int i) {
+                parallel_for::apply(0, 64, &ts, [&](int j) { w[i][j] = i + j; });
+            });
+            for (int i = 0; i < 64; i++) {
+                for (int j = 0; j < 64; j++) {
+                    EXPECT_EQ(i + j, w[i][j]);
+                }
+            }
+        }
+    }
+}
+
+TEST(task_group, chunked_parallel_for) {
+    auto schedules = {loop_schedule::static_chunks, loop_schedule::dynamic, loop_schedule::guided};
+
+    for (int nthreads: {1, 3, 4}) {
+        task_system ts(nthreads);
+        for (auto sched: schedules) {
+            for (int grain: {0, 1, 7, 100}) {
+                for (int n: {0, 1, 2, 5, 99, 1000}) {
+                    std::vector<int> v(n+2, 0);
+                    parallel_for::apply(1, n+1, &ts, sched, grain, [&](int i) {++v[i];});
+
+                    // Every index in the range is visited exactly once.
+                    EXPECT_EQ(0, v[0]);
+                    EXPECT_EQ(0, v[n+1]);
+                    for (int i = 1; i <= n; i++) {
+                        EXPECT_EQ(1, v[i]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(task_group, chunked_parallel_for_nested) {
+    task_system ts;
+    const int n = 100, m = 50;
+    std::vector<std::vector<int>> v(n, std::vector<int>(m, -1));
+
+    parallel_for::apply(0, n, &ts, loop_schedule::guided, 1, [&](int i) {
+        auto& w = v[i];
+        parallel_for::apply(0, m, &ts, loop_schedule::dynamic, 4, [&](int j) { w[j] = i + j; });
+    });
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < m; j++) {
+            EXPECT_EQ(i + j, v[i][j]);
+        }
+    }
+}
+
+TEST(task_group, chunked_parallel_for_throw) {
+    for (auto sched: {loop_schedule::static_chunks, loop_schedule::dynamic, loop_schedule::guided}) {
+        task_system ts(4);
+        EXPECT_THROW(
+            parallel_for::apply(0, 1000, &ts, sched, 1, [](int i) { if (i==500) throw std::runtime_error("500"); }),
+            std::runtime_error);
+    }
+}
+
+TEST(task_group, run_from_foreign_thread) {
+    // Tasks submitted from a thread that is not part of the task_system
+    // are still executed.
+    task_system ts(3, scheduler_kind::work_stealing);
+    std::atomic<int> count{0};
+
+    std::thread t([&] {
+        task_group g(&ts);
+        for (int i = 0; i < 1000; i++) {
+            g.run([&] { ++count; });
+        }
+        g.wait();
+    });
+    t.join();
+
+    EXPECT_EQ(1000, count);
+}
+
+TEST(task_system, thread_index) {
+    for (auto kind: {scheduler_kind::notification_queues, scheduler_kind::work_stealing}) {
+        task_system ts(4, kind);
+        auto ids = ts.get_thread_ids();
+        EXPECT_EQ(0, ts.thread_index());
+
+        // Every task sees the index of the thread that runs it.
+        std::vector<std::pair<std::thread::id, int>> ran_on(400);
+        task_group g(&ts);
+        for (int i = 0; i < 400; i++) {
+            g.run([&ts, &ran_on, i] {
+                ran_on[i] = {std::this_thread::get_id(), ts.thread_index()};
+            });
+        }
+        g.wait();
+
+        for (auto& r: ran_on) {
+            EXPECT_EQ(int(ids.at(r.first)), r.second);
+        }
+
+        // Threads outside the task system have no index, including the
+        // workers of another task system.
+        task_system other(2, kind);
+        int index = 0;
+        std::thread t([&] { index = ts.thread_index(); });
+        t.join();
+        EXPECT_EQ(-1, index);
+
+        // The master thread of both is this thread, so only tasks that run
+        // on the worker of other are checked.
+        task_group h(&other);
+        std::vector<int> other_index(10, -1);
+        for (int i = 0; i < 10; i++) {
+            h.run([&, i] { if (other.thread_index()==1) other_index[i] = ts.thread_index(); });
+        }
+        h.wait();
+        EXPECT_EQ(std::vector<int>(10, -1), other_index);
+    }
+}
+
+TEST(task_group, run_on) {
+    for (auto kind: {scheduler_kind::notification_queues, scheduler_kind::work_stealing}) {
+        task_system ts(4, kind);
+        auto ids = ts.get_thread_ids();
+
+        std::vector<std::thread::id> ran_on(400);
+        task_group g(&ts);
+        for (int i = 0; i < 400; i++) {
+            g.run_on(i, [&ran_on, i] {
+                std::this_thread::sleep_for(std::chrono::microseconds(10));
+                ran_on[i] = std::this_thread::get_id();
+            });
+        }
+        g.wait();
+
+        // With work stealing, tasks addressed to workers run on that worker.
+        if (kind==scheduler_kind::work_stealing) {
+            for (int i = 0; i < 400; i++) {
+                if (i%4) {
+                    EXPECT_EQ(std::size_t(i%4), ids.at(ran_on[i]));
+                }
+            }
+        }
+    }
+}
+
+TEST(task_system, bind_cpus) {
+    auto avail = arb::hw::get_affinity();
+    if (avail.empty()) return;
+
+    // The thread that creates the task system is bound too, so create it
+    // on a separate thread.
+    std::vector<int> cpus(3, avail.front());
+    std::vector<std::vector<int>> affinity(3);
+
+    std::vector<int> restored;
+
+    std::thread master([&] {
+        {
+            task_system ts(3, scheduler_kind::work_stealing, cpus);
+            EXPECT_EQ(cpus, ts.bind_cpus());
+
+            task_group g(&ts);
+            for (int i = 0; i < 3; i++) {
+                g.run_on(i, [&affinity, i] { affinity[i] = arb::hw::get_affinity(); });
+            }
+            g.wait();
+        }
+        // The calling thread is unbound when the task system is destroyed.
+        restored = arb::hw::get_affinity();
+    });
+    master.join();
+
+    for (auto& a: affinity) {
+        EXPECT_EQ(std::vector<int>{avail.front()}, a);
+    }
+    EXPECT_EQ(avail, restored);
+}
+
+TEST(thread_binding, cpus) {
+    // Eight processors over two NUMA nodes.
+    std::vector<int> avail = {0, 1, 2, 3, 4, 5, 6, 7};
+    std::vector<int> nodes = {0, 0, 0, 0, 1, 1, 1, 1};
+
+    EXPECT_TRUE(thread_binding_cpus(thread_binding::none, 4, avail, nodes, {}).empty());
+
+    EXPECT_EQ((std::vector<int>{0, 1, 2, 3}),
+              thread_binding_cpus(thread_binding::compact, 4, avail, nodes, {}));
+    EXPECT_EQ((std::vector<int>{0, 4, 1, 5}),
+              thread_binding_cpus(thread_binding::scatter, 4, avail, nodes, {}));
+
+    // More threads than processors: wrap around.
+    EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 0, 1}),
+              thread_binding_cpus(thread_binding::compact, 10, avail, nodes, {}));
+    EXPECT_EQ((std::vector<int>{0, 4, 1, 5, 2, 6, 3, 7, 0, 4}),
+              thread_binding_cpus(thread_binding::scatter, 10, avail, nodes, {}));
+
+    // Unknown available processors: no binding.
+    EXPECT_TRUE(thread_binding_cpus(thread_binding::compact, 4, {}, {}, {}).empty());
+
+    EXPECT_EQ((std::vector<int>{6, 2}),
+              thread_binding_cpus(thread_binding::list, 2, avail, nodes, {6, 2, 1}));
+    EXPECT_THROW(thread_binding_cpus(thread_binding::list, 4, avail, nodes, {6, 2, 1}), arb::arbor_exception);
+    EXPECT_THROW(thread_binding_cpus(thread_binding::list, 2, avail, nodes, {6, 12}), arb::arbor_exception);
+}
+
+TEST(work_stealing_deque, push_pop_steal) {
+    work_stealing_deque q(4);
+    std::vector<int> order;
+
+    EXPECT_TRUE(q.empty());
+    EXPECT_EQ(nullptr, q.pop());
+    EXPECT_EQ(nullptr, q.steal());
+
+    // Push enough tasks to force the deque to grow.
+    for (int i = 0; i < 10; ++i) {
+        q.push(new task([&order, i] { order.push_back(i); }));
+    }
+    EXPECT_FALSE(q.empty());
+
+    // Owner pops in LIFO order; thieves steal in FIFO order.
+    auto run = [](task* t) { (*t)(); delete t; };
+    run(q.pop());
+    run(q.steal());
+    run(q.pop());
+    run(q.steal());
+    EXPECT_EQ((std::vector<int>{9, 0, 8, 1}), order);
+
+    // Remaining tasks are released by the destructor.
+}
+
+TEST(work_stealing_deque, concurrent_steal) {
+    // Each task is taken exactly once, whether by the owner or a thief.
+    const int n = 100000;
+    const int nthieves = 3;
+    work_stealing_deque q;
+    std::vector<std::atomic<int>> taken(n);
+    for (auto& t: taken) t = 0;
+
+    std::atomic<bool> done{false};
+    std::atomic<int> total{0};
+
+    auto run = [&](task* t) { (*t)(); delete t; ++total; };
+
+    std::vector<std::thread> thieves;
+    for (int k = 0; k < nthieves; ++k) {
+        thieves.emplace_back([&] {
+            while (!done) {
+                if (task* t = q.steal()) run(t);
+            }
+        });
+    }
+
+    for (int i = 0; i < n; ++i) {
+        q.push(new task([&taken, i] { ++taken[i]; }));
+        if (i%3==0) {
+            if (task* t = q.pop()) run(t);
+        }
+    }
+    while (total<n) {
+        if (task* t = q.pop()) run(t);
+    }
+    done = true;
+    for (auto& t: thieves) t.join();
+
+    EXPECT_EQ(n, total);
+    for (auto& t: taken) {
+        EXPECT_EQ(1, t);
+    }
+}
+
 TEST(enumerable_thread_specific, test) {
     task_system_handle ts = task_system_handle(new task_system);
     enumerable_thread_specific<int> buffers(ts);
@@ -214,3 +582,31 @@ TEST(enumerable_thread_specific, test) {
 
     EXPECT_EQ(100000, sum);
 }
+
+TEST(enumerable_thread_specific, thread_index) {
+    task_system_handle ts = task_system_handle(new task_system(3));
+    enumerable_thread_specific<int> values(-1, ts);
+    task_group g(ts.get());
+
+    // Each thread writes its own index to its value.
+    for (int i = 0; i < 1000; i++) {
+        g.run([&] { values.local() = ts->thread_index(); });
+    }
+    g.wait();
+    values.local() = 0;
+
+    int i = 0;
+    for (auto v: values) {
+        EXPECT_TRUE(v==i || v==-1);
+        ++i;
+    }
+
+    // Threads that are not in the task system have no value.
+    bool thrown = false;
+    std::thread t([&] {
+        try { values.local(); }
+        catch (std::out_of_range&) { thrown = true; }
+    });
+    t.join();
+    EXPECT_TRUE(thrown);
+}
@@ -0,0 +1,250 @@
+#include "../gtest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/context.hpp>
+#include <arbor/lif_cell.hpp>
+#include <arbor/load_balance.hpp>
+#include <arbor/recipe.hpp>
+#include <arbor/schedule.hpp>
+#include <arbor/simulation.hpp>
+#include <arbor/spike.hpp>
+#include <arbor/spike_source_cell.hpp>
+
+#include "communication/packed_spikes.hpp"
+#include "distributed_context.hpp"
+#include "execution_context.hpp"
+#include "util/rangeutil.hpp"
+
+using namespace arb;
+
+namespace {
+    // Run f(rank) for each of n in-process ranks, each in its own thread.
+    template <typename F>
+    void run_ranks(unsigned n, F&& f) {
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i<n; ++i) {
+            threads.emplace_back([&f, i] { f(i); });
+        }
+        for (auto& t: threads) {
+            t.join();
+        }
+    }
+
+    // Ring of LIF cells, started by a spike source with gid 0 that spikes
+    // once at time 0. The connections to cells with gids that are multiples
+    // of 10 have delay long_delay, and the others delay 1.
+    class lif_ring_recipe: public recipe {
+    public:
+        lif_ring_recipe(cell_size_type n, float long_delay = 1):
+            n_(n), long_delay_(long_delay)
+        {}
+
+        cell_size_type num_cells() const override { return n_+1; }
+
+        cell_kind get_cell_kind(cell_gid_type gid) const override {
+            return gid? cell_kind::lif_neuron: cell_kind::spike_source;
+        }
+
+        util::unique_any get_cell_description(cell_gid_type gid) const override {
+            if (!gid) {
+                return spike_source_cell{explicit_schedule({0.f})};
+            }
+            return lif_cell();
+        }
+
+        std::vector<cell_connection> connections_on(cell_gid_type gid) const override {
+            if (!gid) return {};
+            return {cell_connection({gid-1, 0}, {gid, 0}, 1000.f, gid%10? 1.f: long_delay_)};
+        }
+
+        cell_size_type num_sources(cell_gid_type) const override { return 1; }
+        cell_size_type num_targets(cell_gid_type) const override { return 1; }
+        cell_size_type num_probes(cell_gid_type) const override { return 0; }
+
+    private:
+        cell_size_type n_;
+        float long_delay_;
+    };
+
+    template <typename Setup>
+    std::vector<spike> run_ring(unsigned num_ranks, Setup&& setup, float long_delay = 1) {
+        const cell_size_type n = 29;
+        auto ranks = make_thread_ranks(num_ranks);
+
+        std::mutex mutex;
+        std::vector<spike> spikes;
+        run_ranks(num_ranks, [&](unsigned rank) {
+            auto ctx = make_context(proc_allocation(1, -1), thread_rank_info(ranks, rank));
+            lif_ring_recipe rec(n, long_delay);
+            auto decomp = partition_load_balance(rec, ctx);
+
+            simulation sim(rec, decomp, ctx);
+            setup(sim);
+            sim.set_local_spike_callback(
+                [&](const std::vector<spike>& local) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    spikes.insert(spikes.end(), local.begin(), local.end());
+                });
+            sim.run(n+2+3*(long_delay-1), 0.01);
+        });
+
+        util::sort_by(spikes, [](const spike& s) { return s.source; });
+        return spikes;
+    }
+}
+
+TEST(thread_context, make) {
+    EXPECT_THROW(make_thread_ranks(0), arbor_exception);
+
+    auto ranks = make_thread_ranks(3);
+    EXPECT_THROW(make_thread_context(ranks, 3), arbor_exception);
+
+    auto ctx = make_thread_context(ranks, 2);
+    EXPECT_EQ(2, ctx->id());
+    EXPECT_EQ(3, ctx->size());
+    EXPECT_EQ("threads", ctx->name());
+}
+
+TEST(thread_context, collectives) {
+    const unsigned n = 4;
+    auto ranks = make_thread_ranks(n);
+
+    struct result {
+        int min, max, sum;
+        double dsum;
+        std::vector<int> gathered;
+        std::vector<double> all_gathered;
+        std::vector<spike> spikes;
+        std::vector<unsigned> spike_partition;
+        std::vector<spike> received;
+        std::vector<unsigned> received_partition;
+        std::vector<spike> unpacked;
+    };
+    std::vector<result> results(n);
+
+    run_ranks(n, [&](unsigned rank) {
+        auto ctx = make_thread_context(ranks, rank);
+        auto& r = results[rank];
+        int i = rank;
+
+        r.min = ctx->min(i);
+        r.max = ctx->max(i);
+        r.sum = ctx->sum(i);
+        r.dsum = ctx->sum(0.5*i);
+        r.gathered = ctx->gather(10*i, 1);
+        r.all_gathered = ctx->all_gather(std::vector<double>(i, 0.5*i));
+        ctx->barrier();
+
+        // Rank i generates i spikes from gid 10*i.
+        std::vector<spike> local;
+        for (int j = 0; j<i; ++j) {
+            local.push_back({{cell_gid_type(10*i+j), 0}, time_type(i)});
+        }
+        auto g = ctx->gather_spikes(local);
+        r.spikes = g.values();
+        r.spike_partition = g.partition();
+
+        // Rank i sends its spike j to rank j.
+        std::vector<unsigned> part(n+1);
+        for (unsigned j = 0; j<=n; ++j) part[j] = std::min<unsigned>(j, i);
+        auto a = ctx->all_to_all_spikes(local, part);
+        r.received = a.values();
+        r.received_partition = a.partition();
+
+        std::vector<char> packed;
+        pack_spikes(local, packed);
+        r.unpacked = unpack_spikes(ctx->gather_packed_spikes(packed));
+    });
+
+    std::vector<spike> all_spikes;
+    for (int i = 0; i<int(n); ++i) {
+        for (int j = 0; j<i; ++j) {
+            all_spikes.push_back({{cell_gid_type(10*i+j), 0}, time_type(i)});
+        }
+    }
+
+    for (unsigned rank = 0; rank<n; ++rank) {
+        const auto& r = results[rank];
+        EXPECT_EQ(0, r.min);
+        EXPECT_EQ(3, r.max);
+        EXPECT_EQ(6, r.sum);
+        EXPECT_EQ(3., r.dsum);
+        if (rank==1) {
+            EXPECT_EQ((std::vector<int>{0, 10, 20, 30}), r.gathered);
+        }
+        else {
+            EXPECT_TRUE(r.gathered.empty());
+        }
+        EXPECT_EQ((std::vector<double>{0.5, 1, 1, 1.5, 1.5, 1.5}), r.all_gathered);
+
+        EXPECT_EQ(all_spikes, r.spikes);
+        EXPECT_EQ((std::vector<unsigned>{0, 0, 1, 3, 6}), r.spike_partition);
+        EXPECT_EQ(all_spikes, r.unpacked);
+
+        // Rank r receives spike r from each rank i>r.
+        std::vector<spike> expected;
+        std::vector<unsigned> expected_partition = {0};
+        for (unsigned i = 0; i<n; ++i) {
+            if (rank<i) {
+                expected.push_back({{cell_gid_type(10*i+rank), 0}, time_type(i)});
+            }
+            expected_partition.push_back(expected.size());
+        }
+        EXPECT_EQ(expected, r.received);
+        EXPECT_EQ(expected_partition, r.received_partition);
+    }
+}
+
+TEST(thread_context, simulation) {
+    // Reference: one rank.
+    auto expected = run_ring(1, [](simulation&) {});
+    ASSERT_EQ(30u, expected.size());
+    for (auto& s: expected) {
+        EXPECT_EQ(time_type(s.source.gid), s.time);
+    }
+
+    // The same model distributed over three ranks, with each exchange method.
+    EXPECT_EQ(expected, run_ring(3, [](simulation&) {}));
+    EXPECT_EQ(expected, run_ring(3, [](simulation& sim) {
+        sim.set_spike_exchange_policy(spike_exchange_policy::point_to_point);
+    }));
+    EXPECT_EQ(expected, run_ring(3, [](simulation& sim) {
+        sim.set_spike_compression(true);
+    }));
+}
+
+TEST(thread_context, batched_exchange) {
+    // With three ranks, the connections between ranks have delay 5 and the
+    // others delay 1, so spikes need to be sent to other ranks only every 9
+    // epochs of length 0.5, while they are delivered within ranks every epoch.
+    const float long_delay = 5;
+
+    auto expected = run_ring(1, [](simulation&) {}, long_delay);
+    ASSERT_EQ(30u, expected.size());
+    for (auto& s: expected) {
+        EXPECT_EQ(time_type(s.source.gid + (long_delay-1)*(s.source.gid/10)), s.time);
+    }
+
+    std::atomic<unsigned> num_exchanges(0);
+    auto count_exchanges = [&num_exchanges](simulation& sim) {
+        sim.set_global_spike_callback([&num_exchanges](const std::vector<spike>&) { ++num_exchanges; });
+    };
+
+    EXPECT_EQ(expected, run_ring(3, count_exchanges, long_delay));
+    // The run is 43 time units long, or 86 epochs.
+    EXPECT_LE(num_exchanges.load(), 3u*(86/9+1));
+    EXPECT_GT(num_exchanges.load(), 3u);
+
+    EXPECT_EQ(expected, run_ring(3, [](simulation& sim) {
+        sim.set_spike_exchange_policy(spike_exchange_policy::point_to_point);
+    }, long_delay));
+    EXPECT_EQ(expected, run_ring(3, [](simulation& sim) {
+        sim.set_spike_compression(true);
+    }, long_delay));
+}